@@ -0,0 +1,201 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include "bitmap_heap_scan.h"
+#include "pax_page.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+#include "exceptions/badgerdb_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Orders RecordIds by page, then by slot.
+ */
+bool ridLess(const RecordId& a, const RecordId& b)
+{
+  if (a.page_number != b.page_number)
+    return a.page_number < b.page_number;
+  return a.slot_number < b.slot_number;
+}
+
+}
+
+const std::size_t BitmapHeapScan::BATCH_RIDS;
+const PageId BitmapHeapScan::READ_AHEAD_PAGES;
+
+BitmapHeapScan::BitmapHeapScan(const std::string &name, BTreeIndex *index,
+                               BufMgr *bufMgr, const std::size_t batchRids)
+{
+  file = new PageFile(name, false);	//dont create new file
+  this->bufMgr = bufMgr;
+  this->index = index;
+  this->batchRids = batchRids > 0 ? batchRids : 1;
+  nextRid = 0;
+  indexDone = false;
+  curPage = NULL;
+  readAheadEnd = Page::INVALID_NUMBER;
+  readAheadPages = READ_AHEAD_PAGES;
+  rids.reserve(this->batchRids);
+}
+
+BitmapHeapScan::BitmapHeapScan(const std::string &name, const RidBitmap &bitmap,
+                               BufMgr *bufMgr)
+{
+  file = new PageFile(name, false);	//dont create new file
+  this->bufMgr = bufMgr;
+  index = NULL;
+  batchRids = bitmap.cardinality();
+  nextRid = 0;
+  indexDone = true;
+  curPage = NULL;
+  readAheadEnd = Page::INVALID_NUMBER;
+  readAheadPages = READ_AHEAD_PAGES;
+  bitmap.toRids(rids);
+}
+
+BitmapHeapScan::~BitmapHeapScan()
+{
+  // a destructor must not throw, so errors of the final flush are dropped
+  try
+  {
+    if (curPage != NULL)
+    {
+      bufMgr->unPinPage(file, curPage->page_number(), false);
+      curPage = NULL;
+    }
+    bufMgr->flushFile(file);
+  }
+  catch(const BadgerDbException& e)
+  {
+  }
+  delete file;
+}
+
+void BitmapHeapScan::scanNext(RecordId& outRid)
+{
+  if (nextRid == rids.size())
+  {
+    if (curPage != NULL)
+    {
+      bufMgr->unPinPage(file, curPage->page_number(), false);
+      curPage = NULL;
+    }
+    if (!fillBatch())
+      throw EndOfFileException();
+  }
+
+  const RecordId& rid = rids[nextRid];
+  if (curPage != NULL && curPage->page_number() != rid.page_number)
+  {
+    bufMgr->unPinPage(file, curPage->page_number(), false);
+    curPage = NULL;
+  }
+  if (curPage == NULL)
+    readCurrentPage();
+  outRid = rid;
+  nextRid++;
+}
+
+std::string BitmapHeapScan::getRecord()
+{
+  const RecordId& rid = rids[nextRid - 1];
+  if (PaxPage::isPax(*curPage))
+    return PaxPage(curPage).getRecord(rid);
+  return curPage->getRecord(rid);
+}
+
+RecordView BitmapHeapScan::getRecordView()
+{
+  const RecordId& rid = rids[nextRid - 1];
+  if (PaxPage::isPax(*curPage))
+  {
+    PaxPage paxPage(curPage);
+    rowBuffer.resize(paxPage.tupleSize());
+    paxPage.copyRecord(rid, &rowBuffer[0]);
+    const RecordView record = {rowBuffer.data(),
+                               static_cast<std::uint16_t>(rowBuffer.size())};
+    return record;
+  }
+  return curPage->getRecordView(rid);
+}
+
+bool BitmapHeapScan::fillBatch()
+{
+  rids.clear();
+  nextRid = 0;
+  while (!indexDone && rids.size() < batchRids)
+  {
+    RecordId rid;
+    try
+    {
+      index->scanNext(rid);
+    }
+    catch(const IndexScanCompletedException& e)
+    {
+      indexDone = true;
+      break;
+    }
+    rids.push_back(rid);
+  }
+
+  std::sort(rids.begin(), rids.end(), ridLess);
+  rids.erase(std::unique(rids.begin(), rids.end()), rids.end());
+  return !rids.empty();
+}
+
+void BitmapHeapScan::readCurrentPage()
+{
+  const PageId pageNo = rids[nextRid].page_number;
+  if (pageNo >= readAheadEnd || pageNo + READ_AHEAD_PAGES < readAheadEnd)
+  {
+    // Count how many of the batch's next pages follow this one without a gap.
+    PageId count = 1;
+    for (std::size_t i = nextRid + 1; i < rids.size() && count < readAheadPages; i++)
+    {
+      if (rids[i].page_number == pageNo + count - 1)
+        continue;
+      if (rids[i].page_number != pageNo + count)
+        break;
+      count++;
+    }
+
+    if (count > 1)
+    {
+      Page* pages[READ_AHEAD_PAGES];
+      try
+      {
+        bufMgr->readPageRange(file, pageNo, count, pages);
+        for (PageId i = 1; i < count; i++)
+          bufMgr->unPinPage(file, pageNo + i, false);
+        curPage = pages[0];
+        readAheadEnd = pageNo + count;
+        if (readAheadPages < READ_AHEAD_PAGES)
+          readAheadPages *= 2;
+        return;
+      }
+      catch(const BadgerDbException& e)
+      {
+        // a crowded buffer pool; read this page alone and try a window half
+        // the size at the next run of pages
+        readAheadPages = count / 2;
+        readAheadEnd = pageNo + 1;
+      }
+    }
+    else if (readAheadPages == 1)
+    {
+      // a window shrunk to one page grows back from here
+      readAheadPages = 2;
+    }
+  }
+  bufMgr->readPage(file, pageNo, curPage);
+}
+
+}
@@ -0,0 +1,162 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.h"
+#include "page.h"
+#include "buffer.h"
+#include "btree.h"
+#include "rid_bitmap.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Fetches the records an index scan finds from the relation's heap
+ *        in page order.
+ *
+ * A secondary index returns RecordIds in key order, so fetching each record
+ * as it comes reads heap pages in random order and pins the same page again
+ * for every record on it.  This scan instead drains the index scan in
+ * batches of RecordIds, sorts each batch by page and slot, dropping
+ * duplicates, and visits every heap page of the batch once, in physical
+ * order.  Runs of consecutive pages are read with one request.
+ *
+ * Records are returned in page order within a batch, not in key order.  The
+ * caller starts the index scan before the first call to scanNext() and ends
+ * it afterwards.  A scan over a RidBitmap fetches the whole set as one
+ * batch.
+ */
+class BitmapHeapScan
+{
+ public:
+  /**
+   * Default number of RecordIds collected from the index per batch.
+   */
+  static const std::size_t BATCH_RIDS = 4096;
+
+  /**
+   * Number of consecutive heap pages read in one request.
+   */
+  static const PageId READ_AHEAD_PAGES = 8;
+
+  /**
+   * Opens the heap of a relation for fetching.
+   *
+   * @param name        Name of the relation's file.
+   * @param index       Index with a started scan over the relation.
+   * @param bufMgr      Buffer manager to read heap pages through.
+   * @param batchRids   Number of RecordIds to collect per batch.
+   */
+  BitmapHeapScan(const std::string &name, BTreeIndex *index, BufMgr *bufMgr,
+                 const std::size_t batchRids = BATCH_RIDS);
+
+  /**
+   * Opens the heap of a relation for fetching a set of its records, for
+   * instance the intersection of several index range scans.
+   *
+   * @param name        Name of the relation's file.
+   * @param bitmap      RecordIds of the records to fetch.
+   * @param bufMgr      Buffer manager to read heap pages through.
+   */
+  BitmapHeapScan(const std::string &name, const RidBitmap &bitmap,
+                 BufMgr *bufMgr);
+
+  ~BitmapHeapScan();
+
+  /**
+   * Moves to the next record found by the index scan.
+   *
+   * @param outRid  RecordId of the record returned in this.
+   * @throws  EndOfFileException  If the index scan has no more records.
+   */
+  void scanNext(RecordId& outRid);
+
+  /**
+   * Returns a copy of the current record.
+   */
+  std::string getRecord();
+
+  /**
+   * Returns a view of the current record, valid until the next call to
+   * scanNext().  Rows of PAX pages are gathered into a buffer of the scan.
+   */
+  RecordView getRecordView();
+
+ private:
+  /**
+   * Collects the next batch of RecordIds from the index, sorted by page and
+   * slot.
+   *
+   * @return  False if the index scan had no more.
+   */
+  bool fillBatch();
+
+  /**
+   * Pins the heap page of rids[nextRid] as curPage, reading it together
+   * with the following heap pages of the batch if they are consecutive.
+   */
+  void readCurrentPage();
+
+  /**
+   * Heap file of the relation.
+   */
+  PageFile      *file;
+
+  /**
+   * Buffer Manager instance used to read heap pages.
+   */
+  BufMgr        *bufMgr;
+
+  /**
+   * Index whose scan supplies the RecordIds, or NULL if they came from a
+   * RidBitmap.
+   */
+  BTreeIndex    *index;
+
+  /**
+   * Number of RecordIds to collect per batch.
+   */
+  std::size_t   batchRids;
+
+  /**
+   * Current batch, sorted by page and slot, and position of the record
+   * following the current one in it.
+   */
+  std::vector<RecordId> rids;
+  std::size_t   nextRid;
+
+  /**
+   * True once the index scan has returned all RecordIds.
+   */
+  bool          indexDone;
+
+  /**
+   * Pinned heap page holding the current record, or NULL.
+   */
+  Page*         curPage;
+
+  /**
+   * Page number following the last page brought in by read-ahead.
+   */
+  PageId        readAheadEnd;
+
+  /**
+   * Pages the next read-ahead window may span: halved whenever a window
+   * cannot be read, doubled back up to READ_AHEAD_PAGES whenever one can.
+   */
+  PageId        readAheadPages;
+
+  /**
+   * Current row gathered from a PAX page by getRecordView().
+   */
+  std::string   rowBuffer;
+};
+
+}
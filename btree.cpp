@@ -5,8 +5,15 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include "btree.h"
 #include "filescan.h"
+#include "filter_kernels.h"
+#include "prefix_key_node.h"
+#include "posting_leaf.h"
+#include "packed_int_leaf.h"
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
@@ -21,54 +28,729 @@
 namespace badgerdb
 {
 
+namespace
+{
+
+/**
+ * Returns the INTEGER or DOUBLE key <key> points to.
+ */
+template<class T>
+T keyAt(const void* key)
+{
+	T value;
+	memcpy(&value, key, sizeof(T));
+	return value;
+}
+
+/**
+ * Compares two keys the way their normalized encodings (see KeyCodec) compare: one integer compare, or
+ * one memcmp for STRING and composite keys, shorter first on a tie.
+ * @return negative, zero or positive as <a> sorts before, with or after <b>
+ */
+int compareKeys(const int a, const int b)
+{
+	return (a > b) - (a < b);
+}
+
+int compareKeys(const double a, const double b)
+{
+	const std::uint64_t x = KeyCodec::normalizeDouble(a);
+	const std::uint64_t y = KeyCodec::normalizeDouble(b);
+	return (x > y) - (x < y);
+}
+
+int compareKeys(const std::string& a, const std::string& b)
+{
+	const int cmp = memcmp(a.data(), b.data(), std::min(a.length(), b.length()));
+	if(cmp != 0){
+		return cmp;
+	}
+	return (a.length() > b.length()) - (a.length() < b.length());
+}
+
+/**
+ * Return the bytes of a key, as kept in rightmostHighKey, and the key back from them.
+ */
+template<class K>
+std::string keyBytes(const K& key)
+{
+	return std::string((const char*)&key, sizeof(K));
+}
+
+std::string keyBytes(const std::string& key)
+{
+	return key;
+}
+
+template<class K>
+K bytesKey(const std::string& bytes)
+{
+	return keyAt<K>(bytes.data());
+}
+
+template<>
+std::string bytesKey<std::string>(const std::string& bytes)
+{
+	return bytes;
+}
+
+/**
+ * Read and write a key as stored in the arrays of the node structs.
+ */
+int storedKey(const int& stored)
+{
+	return stored;
+}
+
+double storedKey(const double& stored)
+{
+	return stored;
+}
+
+void storeKey(int& stored, const int key)
+{
+	stored = key;
+}
+
+void storeKey(double& stored, const double key)
+{
+	stored = key;
+}
+
+/**
+ * What node accessors need besides their page: the entries a node of the key type holds, the bytes of
+ * included attributes stored with every leaf entry, and where PostingLeafs keep their overflow pages.
+ */
+struct NodeContext
+{
+	int leafOccupancy;
+	int nodeOccupancy;
+	int payloadWidth;
+	File* file;
+	BufMgr* bufMgr;
+};
+
+/**
+ * Accessor giving a leaf struct (LeafNodeInt etc.) the interface insertInto() and the scans use.  Entries
+ * are kept sorted by key, equal keys in insertion order, and the included attributes of entry i are at
+ * payload(i), in the tail of ridArray past leafOccupancy.
+ */
+template<class K, class leaf>
+class FixedLeaf
+{
+public:
+	FixedLeaf(Page* page, const NodeContext& context)
+		: node((leaf*) page), occupancy(context.leafOccupancy), payloadWidth(context.payloadWidth)
+	{
+	}
+
+	void initialize(const PageId rightSibling)
+	{
+		node->level = 0;
+		node->slot = 0;
+		node->rightSibPageNo = rightSibling;
+	}
+
+	int count() const { return node->slot; }
+	K key(const int i) const { return storedKey(node->keyArray[i]); }
+	RecordId rid(const int i) const { return node->ridArray[i]; }
+	PageId rightSibling() const { return node->rightSibPageNo; }
+
+	char* payload(const int i) const
+	{
+		return (char*)(node->ridArray + occupancy) + i * payloadWidth;
+	}
+
+	/**
+	 * Return the first entry whose key is not below, or is above, <key>; count() if there is none.
+	 */
+	int lowerBound(const K& key) const
+	{
+		int low = 0;
+		int high = node->slot;
+		while(low < high){
+			const int mid = low + (high - low) / 2;
+			if(compareKeys(this->key(mid), key) < 0){
+				low = mid + 1;
+			}else{
+				high = mid;
+			}
+		}
+		return low;
+	}
+
+	int upperBound(const K& key) const
+	{
+		int low = 0;
+		int high = node->slot;
+		while(low < high){
+			const int mid = low + (high - low) / 2;
+			if(compareKeys(this->key(mid), key) <= 0){
+				low = mid + 1;
+			}else{
+				high = mid;
+			}
+		}
+		return low;
+	}
+
+	/**
+	 * Inserts an entry after any equal keys.  Returns false if the leaf is full.
+	 */
+	bool insert(const K& key, const RecordId& rid, const char* payload)
+	{
+		if(node->slot >= occupancy){
+			return false;
+		}
+		insertAt(upperBound(key), key, rid, payload);
+		return true;
+	}
+
+	/**
+	 * Splits the full leaf with the entry, moving the upper half to <right>, an empty page numbered
+	 * rightNum, which becomes the right sibling.  An append to the rightmost leaf moves nothing: the new
+	 * leaf starts with just the entry.  Returns the first key of the new leaf.
+	 */
+	K split(FixedLeaf& right, const PageId rightNum, const K& key, const RecordId& rid, const char* payload)
+	{
+		right.initialize(node->rightSibPageNo);
+		node->rightSibPageNo = rightNum;
+		if(right.rightSibling() == Page::INVALID_NUMBER && compareKeys(key, this->key(node->slot - 1)) >= 0){
+			right.insertAt(0, key, rid, payload);
+			return key;
+		}
+
+		const int middle = node->slot / 2;
+		const int moved = node->slot - middle;
+		memcpy(right.node->keyArray, node->keyArray + middle, moved * sizeof(node->keyArray[0]));
+		memcpy(right.node->ridArray, node->ridArray + middle, moved * sizeof(RecordId));
+		memcpy(right.payload(0), this->payload(middle), moved * payloadWidth);
+		right.node->slot = moved;
+		node->slot = middle;
+
+		if(compareKeys(key, right.key(0)) < 0){
+			insertAt(upperBound(key), key, rid, payload);
+		}else{
+			right.insertAt(right.upperBound(key), key, rid, payload);
+		}
+		return right.key(0);
+	}
+
+private:
+	void insertAt(const int position, const K& key, const RecordId& rid, const char* payload)
+	{
+		const int after = node->slot - position;
+		memmove(node->keyArray + position + 1, node->keyArray + position, after * sizeof(node->keyArray[0]));
+		memmove(node->ridArray + position + 1, node->ridArray + position, after * sizeof(RecordId));
+		storeKey(node->keyArray[position], key);
+		node->ridArray[position] = rid;
+		if(payloadWidth > 0){
+			memmove(this->payload(position + 1), this->payload(position), after * payloadWidth);
+			if(payload != NULL){
+				memcpy(this->payload(position), payload, payloadWidth);
+			}else{
+				memset(this->payload(position), 0, payloadWidth);
+			}
+		}
+		node->slot++;
+	}
+
+	leaf* node;
+	int occupancy;
+	int payloadWidth;
+};
+
+/**
+ * Accessor giving a non-leaf struct (NonLeafNodeInt etc.) the interface insertInto() and the scans use.
+ * child(i) holds the keys between key(i - 1) and key(i); a separator may equal keys on both sides of it.
+ */
+template<class K, class node>
+class FixedInterior
+{
+public:
+	FixedInterior(Page* page, const NodeContext& context)
+		: n((node*) page), occupancy(context.nodeOccupancy)
+	{
+	}
+
+	void initialize(const int level, const PageId leftmost)
+	{
+		n->level = level;
+		n->slot = 0;
+		n->pageNoArray[0] = leftmost;
+	}
+
+	int level() const { return n->level; }
+	int numKeys() const { return n->slot; }
+	K key(const int i) const { return storedKey(n->keyArray[i]); }
+	PageId child(const int i) const { return n->pageNoArray[i]; }
+
+	int lowerBound(const K& key) const
+	{
+		int low = 0;
+		int high = n->slot;
+		while(low < high){
+			const int mid = low + (high - low) / 2;
+			if(compareKeys(this->key(mid), key) < 0){
+				low = mid + 1;
+			}else{
+				high = mid;
+			}
+		}
+		return low;
+	}
+
+	int upperBound(const K& key) const
+	{
+		int low = 0;
+		int high = n->slot;
+		while(low < high){
+			const int mid = low + (high - low) / 2;
+			if(compareKeys(this->key(mid), key) <= 0){
+				low = mid + 1;
+			}else{
+				high = mid;
+			}
+		}
+		return low;
+	}
+
+	/**
+	 * Inserts <key> as key <position>, with <child> right of it: the page split off child(position).
+	 * Returns false if the node is full.
+	 */
+	bool insert(const int position, const K& key, const PageId child)
+	{
+		if(n->slot >= occupancy){
+			return false;
+		}
+		const int after = n->slot - position;
+		memmove(n->keyArray + position + 1, n->keyArray + position, after * sizeof(n->keyArray[0]));
+		memmove(n->pageNoArray + position + 2, n->pageNoArray + position + 1, after * sizeof(PageId));
+		storeKey(n->keyArray[position], key);
+		n->pageNoArray[position + 1] = child;
+		n->slot++;
+		return true;
+	}
+
+	/**
+	 * Splits the full node with the entry insert() did not take, moving the keys after the middle one
+	 * to <right>, an empty page, and returns the middle key, which moves up.  For an append on the right
+	 * edge the new key itself moves up and the new node starts with just its child.
+	 */
+	K split(FixedInterior& right, const PageId /* rightNum */, const int position, const K& key, const PageId child,
+		const bool append)
+	{
+		std::vector<K> keys;
+		std::vector<PageId> children(n->pageNoArray, n->pageNoArray + n->slot + 1);
+		for(int i = 0; i < n->slot; i++){
+			keys.push_back(this->key(i));
+		}
+		keys.insert(keys.begin() + position, key);
+		children.insert(children.begin() + position + 1, child);
+
+		const int middle = append ? (int)keys.size() - 1 : (int)keys.size() / 2;
+		right.initialize(n->level, children[middle + 1]);
+		for(int i = middle + 1; i < (int)keys.size(); i++){
+			right.insert(right.numKeys(), keys[i], children[i + 1]);
+		}
+		n->slot = 0;
+		for(int i = 0; i < middle; i++){
+			storeKey(n->keyArray[i], keys[i]);
+			n->pageNoArray[i + 1] = children[i + 1];
+		}
+		n->slot = middle;
+		return keys[middle];
+	}
+
+private:
+	node* n;
+	int occupancy;
+};
+
+/**
+ * Accessor giving a PrefixKeyNode leaf the interface of FixedLeaf, for keys that are byte strings of any
+ * length.  The node packs entries by space, so it has no fixed occupancy.
+ */
+class PrefixLeaf
+{
+public:
+	PrefixLeaf(Page* page, const NodeContext& context)
+		: node(page), payloadWidth(context.payloadWidth)
+	{
+	}
+
+	void initialize(const PageId rightSibling)
+	{
+		node.initialize(0, rightSibling, payloadWidth);
+	}
+
+	int count() const { return node.numKeys(); }
+	std::string key(const int i) const { return node.key(i); }
+	RecordId rid(const int i) const { return node.rid(i); }
+	char* payload(const int i) const { return node.payload(i); }
+	PageId rightSibling() const { return node.rightSibling(); }
+	int lowerBound(const std::string& key) const { return node.lowerBound(key); }
+	int upperBound(const std::string& key) const { return node.upperBound(key); }
+
+	bool insert(const std::string& key, const RecordId& rid, const char* payload)
+	{
+		return node.insert(key, rid, payload);
+	}
+
+	/**
+	 * As FixedLeaf::split, but the key passed up is the shortest separator of the two leaves.
+	 */
+	std::string split(PrefixLeaf& right, const PageId rightNum, const std::string& key, const RecordId& rid,
+		const char* payload)
+	{
+		const std::string last = node.key(node.numKeys() - 1);
+		if(node.rightSibling() == Page::INVALID_NUMBER && compareKeys(key, last) >= 0){
+			right.initialize(Page::INVALID_NUMBER);
+			node.setRightSibling(rightNum);
+			right.node.insert(key, rid, payload);
+			return compareKeys(key, last) > 0 ? PrefixKeyNode::separator(last, key) : key;
+		}
+
+		return node.split(right.node, rightNum, key, rid, payload);
+	}
+
+private:
+	PrefixKeyNode node;
+	int payloadWidth;
+};
+
+/**
+ * Accessor giving a PrefixKeyNode interior node the interface of FixedInterior.
+ */
+class PrefixInterior
+{
+public:
+	PrefixInterior(Page* page, const NodeContext& /* context */)
+		: node(page)
+	{
+	}
+
+	void initialize(const int level, const PageId leftmost)
+	{
+		node.initialize(level, leftmost);
+	}
+
+	int level() const { return node.level(); }
+	int numKeys() const { return node.numKeys(); }
+	std::string key(const int i) const { return node.key(i); }
+	PageId child(const int i) const { return node.child(i); }
+	int lowerBound(const std::string& key) const { return node.lowerBound(key); }
+	int upperBound(const std::string& key) const { return node.upperBound(key); }
+
+	bool insert(const int position, const std::string& key, const PageId child)
+	{
+		return node.insert(position, key, child);
+	}
+
+	/**
+	 * As FixedInterior::split: the node splits first, then the entry goes to whichever half its
+	 * position falls in.
+	 */
+	std::string split(PrefixInterior& right, const PageId rightNum, const int position, const std::string& key,
+		const PageId child, const bool append)
+	{
+		const std::string up = node.split(right.node, rightNum, append);
+		const int middle = node.numKeys();
+		if(position <= middle){
+			node.insert(position, key, child);
+		}else{
+			right.node.insert(position - middle - 1, key, child);
+		}
+		return up;
+	}
+
+private:
+	PrefixKeyNode node;
+};
+
+/**
+ * Accessor giving a PostingLeaf the interface of FixedLeaf.  Equal keys share one entry, whose posting list
+ * holds their rids in rid order rather than insertion order; there are no payloads.
+ */
+class PostingListLeaf
+{
+public:
+	PostingListLeaf(Page* page, const NodeContext& context)
+		: node(page, context.file, context.bufMgr)
+	{
+	}
+
+	void initialize(const PageId rightSibling)
+	{
+		node.initialize(rightSibling);
+	}
+
+	int count() const { return node.numKeys(); }
+	std::string key(const int i) const { return node.key(i); }
+	PageId rightSibling() const { return node.rightSibling(); }
+	int lowerBound(const std::string& key) const { return node.lowerBound(key); }
+
+	int upperBound(const std::string& key) const
+	{
+		const int i = node.lowerBound(key);
+		return i < node.numKeys() && node.key(i) == key ? i + 1 : i;
+	}
+
+	/**
+	 * Appends the rids of key i to <rids>, reading its overflow pages if it spilled.
+	 */
+	void rids(const int i, std::vector<RecordId>& rids) const
+	{
+		node.rids(i, rids);
+	}
+
+	bool insert(const std::string& key, const RecordId& rid, const char* /* payload */)
+	{
+		return node.insert(key, rid);
+	}
+
+	/**
+	 * As PrefixLeaf::split.  Each key stays whole on one side, so only a key greater than all others
+	 * starts a new rightmost leaf on its own.
+	 */
+	std::string split(PostingListLeaf& right, const PageId rightNum, const std::string& key, const RecordId& rid,
+		const char* /* payload */)
+	{
+		const std::string last = node.key(node.numKeys() - 1);
+		if(node.rightSibling() == Page::INVALID_NUMBER && compareKeys(key, last) > 0){
+			right.initialize(Page::INVALID_NUMBER);
+			node.setRightSibling(rightNum);
+			right.node.insert(key, rid);
+			return PrefixKeyNode::separator(last, key);
+		}
+
+		const std::string first = node.split(right.node, rightNum, key, rid);
+		return PrefixKeyNode::separator(node.key(node.numKeys() - 1), first);
+	}
+
+private:
+	PostingLeaf node;
+};
+
+/**
+ * Accessor giving a PackedIntLeaf the interface of FixedLeaf.  Every insert repacks the leaf, which holds as
+ * many entries as their packed differences leave room for; there are no payloads.
+ */
+class PackedLeaf
+{
+public:
+	PackedLeaf(Page* page, const NodeContext& /* context */)
+		: node(page)
+	{
+	}
+
+	void initialize(const PageId rightSibling)
+	{
+		node.pack(NULL, NULL, 0, rightSibling);
+	}
+
+	int count() const { return node.count(); }
+	int key(const int i) const { return node.key(i); }
+	RecordId rid(const int i) const { return node.rid(i); }
+	PageId rightSibling() const { return node.rightSibling(); }
+	int lowerBound(const int key) const { return node.lowerBound(key); }
+	int upperBound(const int key) const { return node.upperBound(key); }
+
+	bool insert(const int& key, const RecordId& rid, const char* /* payload */)
+	{
+		return node.insert(key, rid);
+	}
+
+	/**
+	 * As FixedLeaf::split, unpacking the leaf and packing each half.
+	 */
+	int split(PackedLeaf& right, const PageId rightNum, const int& key, const RecordId& rid,
+		const char* /* payload */)
+	{
+		std::vector<std::int32_t> keys(node.count());
+		std::vector<RecordId> rids(node.count());
+		node.unpackKeys(keys.data());
+		node.unpackRids(rids.data());
+		if(node.rightSibling() == Page::INVALID_NUMBER && compareKeys(key, keys.back()) >= 0){
+			right.node.pack(&key, &rid, 1, Page::INVALID_NUMBER);
+			node.setRightSibling(rightNum);
+			return key;
+		}
+
+		const int position = node.upperBound(key);
+		keys.insert(keys.begin() + position, key);
+		rids.insert(rids.begin() + position, rid);
+
+		//a half packs wider as it gains entries, so split as near the middle as both halves allow
+		const std::size_t total = keys.size();
+		std::size_t low = 1;
+		std::size_t high = total - 1;
+		while(low < high){
+			const std::size_t point = (low + high) / 2;
+			if(PackedIntLeaf::packedSize(keys.data() + point, rids.data() + point, total - point) <= Page::SIZE){
+				high = point;
+			}else{
+				low = point + 1;
+			}
+		}
+		const std::size_t leftMost = low;
+		high = total - 1;
+		while(low < high){
+			const std::size_t point = (low + high + 1) / 2;
+			if(PackedIntLeaf::packedSize(keys.data(), rids.data(), point) <= Page::SIZE){
+				low = point;
+			}else{
+				high = point - 1;
+			}
+		}
+		const std::size_t rightMost = low;
+		const std::size_t middle = std::min(std::max(total / 2, leftMost), rightMost);
+
+		const std::size_t packedRight = right.node.pack(keys.data() + middle, rids.data() + middle, total - middle,
+			node.rightSibling());
+		const std::size_t packedLeft = node.pack(keys.data(), rids.data(), middle, rightNum);
+		assert(packedLeft == middle && packedRight == total - middle);
+		(void)packedLeft;
+		(void)packedRight;
+		return keys[middle];
+	}
+
+private:
+	PackedIntLeaf node;
+};
+
+/**
+ * Finds the entries of a leaf within a range: those from the first not below, or above, <low> to the last
+ * not above, or below, <high>.  Sets pastRange if the leaf holds keys after the range.
+ */
+template<class Leaf>
+void selectKeyRange(const Leaf& leaf, const std::string& low, const Operator lowOp, const std::string& high,
+	const Operator highOp, std::vector<std::uint32_t>& matches, bool& pastRange)
+{
+	const int first = lowOp == GT ? leaf.upperBound(low) : leaf.lowerBound(low);
+	const int last = highOp == LT ? leaf.lowerBound(high) : leaf.upperBound(high);
+	for(int i = first; i < last; i++){
+		matches.push_back(i);
+	}
+	pastRange = last < leaf.count();
+}
+
+typedef FixedLeaf<int, LeafNodeInt> IntLeaf;
+typedef FixedInterior<int, NonLeafNodeInt> IntInterior;
+typedef FixedLeaf<double, LeafNodeDouble> DoubleLeaf;
+typedef FixedInterior<double, NonLeafNodeDouble> DoubleInterior;
+
+}
+
 // -----------------------------------------------------------------------------
 // BTreeIndex::BTreeIndex -- Constructor
 // -----------------------------------------------------------------------------
 
+	BTreeIndex::BTreeIndex(const std::string & relationName,
+		std::string & outIndexName,
+		BufMgr *bufMgrIn,
+		const Schema & schema,
+		const std::string & attrName,
+		const IndexOptions & options)
+		: BTreeIndex(relationName, outIndexName, bufMgrIn,
+			schema.field(attrName).offset, schema.field(attrName).type, options)
+	{
+	}
+
+	BTreeIndex::BTreeIndex(const std::string & relationName,
+		std::string & outIndexName,
+		BufMgr *bufMgrIn,
+		const int attrByteOffset,
+		const Datatype attrType,
+		const IndexOptions & options)
+		: BTreeIndex(relationName, outIndexName, bufMgrIn,
+			attrByteOffset, attrType, std::vector<IndexAttribute>(), options)
+	{
+	}
+
+	BTreeIndex::BTreeIndex(const std::string & relationName,
+		std::string & outIndexName,
+		BufMgr *bufMgrIn,
+		const int attrByteOffset,
+		const Datatype attrType,
+		const std::vector<IndexAttribute> & includedAttrs,
+		const IndexOptions & options)
+		: BTreeIndex(relationName, outIndexName, bufMgrIn,
+			attrByteOffset, attrType, std::vector<IndexAttribute>(), includedAttrs, options)
+	{
+	}
+
+	BTreeIndex::BTreeIndex(const std::string & relationName,
+		std::string & outIndexName,
+		BufMgr *bufMgrIn,
+		const std::vector<IndexAttribute> & keyAttrs,
+		const std::vector<IndexAttribute> & includedAttrs,
+		const IndexOptions & options)
+		: BTreeIndex(relationName, outIndexName, bufMgrIn,
+			keyAttrs.empty() ? 0 : keyAttrs[0].offset, STRING, keyAttrs, includedAttrs, options)
+	{
+	}
+
 	BTreeIndex::BTreeIndex(const std::string & relationName,
 		std::string & outIndexName,
 		BufMgr *bufMgrIn,
 		const int attrByteOffset,
-		const Datatype attrType)
+		const Datatype attrType,
+		const std::vector<IndexAttribute> & keyAttrs,
+		const std::vector<IndexAttribute> & includedAttrs,
+		const IndexOptions & options)
 	{
 
-		//create index name 
+		//create index name, with every offset of a composite key
 		std::ostringstream	idxStr;
 		idxStr	<<	relationName	<<	'.'	<<	attrByteOffset;
+		for(std::size_t i = 1; i < keyAttrs.size(); i++){
+			idxStr	<<	'_'	<<	keyAttrs[i].offset;
+		}
 		std::string	indexName	=	idxStr.str();
 		
 		//fields && meta data
 		bufMgr= bufMgrIn;
 		this->attrByteOffset= attrByteOffset;
 		attributeType= attrType;
+		rightmostLeafNum = Page::INVALID_NUMBER;
+		rightmostEmpty = true;
 		outIndexName = indexName;
 		FileScan scanner(relationName, bufMgrIn);
 		Page * headerPagePtr;
 		Page * rootPagePtr;
 		headerPageNum = 1;
-		bool scanExecuting = false;
+		scanExecuting = false;
+		currentPageNum = Page::INVALID_NUMBER;
 
 		
 		if(!File::exists(relationName)){
 			throw FileNotFoundException("relation file doesnt exist");
 		}
 
-		//Occupancy initialization
-		switch(attributeType){
+		if((int)includedAttrs.size() > MAXINCLUDEDATTRS){
+			throw BadIndexInfoException("too many included attributes");
+		}
+		included = includedAttrs;
 
-			case INTEGER: 
-			leafOccupancy = INTARRAYLEAFSIZE;
-			nodeOccupancy = INTARRAYNONLEAFSIZE;
-			break;
-			case DOUBLE: 
-			leafOccupancy = DOUBLEARRAYLEAFSIZE;
-			nodeOccupancy = DOUBLEARRAYNONLEAFSIZE;
-			break;
-			case STRING: 
-			leafOccupancy = STRINGARRAYLEAFSIZE;
-			nodeOccupancy = STRINGARRAYNONLEAFSIZE;
-			break;		
+		if((int)keyAttrs.size() > MAXKEYCOMPONENTS){
+			throw BadIndexInfoException("too many key attributes");
+		}
+		keyCodec = KeyCodec(keyAttrs);
+
+		if(options.postingLists && !includedAttrs.empty()){
+			throw BadIndexInfoException("posting lists cannot include attributes");
 		}
+		postingLists = options.postingLists;
+
+		if(options.packedLeaves && (attrType != INTEGER || !includedAttrs.empty() || options.postingLists)){
+			throw BadIndexInfoException("packed leaves hold INTEGER keys and their rids only");
+		}
+		packedLeaves = options.packedLeaves;
+
+		//Occupancy initialization
+		setOccupancy();
 
 
 		// --------- INDEX FILE CREATE/OPEN -------------
@@ -97,13 +779,21 @@ namespace badgerdb
 
 			///Checks that the file name given and the other param match
 			rootPageNum = ((IndexMetaInfo*)headerPagePtr)->rootPageNo;
+
+			//leaves are laid out for the attributes the index was built with
+			included.assign(metaPtr->included, metaPtr->included + metaPtr->numIncluded);
+			keyCodec = KeyCodec(std::vector<IndexAttribute>(metaPtr->keyComponents,
+				metaPtr->keyComponents + metaPtr->numKeyComponents));
+			postingLists = metaPtr->postingLists;
+			packedLeaves = metaPtr->packedLeaves;
+			setOccupancy();
 			bufMgr->unPinPage(file, headerPageNum, false);
 
 
 		//If Index does not already exist
-		}catch(FileNotFoundException e){
+		}catch(const FileNotFoundException& e){
 
-			file = new BlobFile(outIndexName, true);
+			file = new BlobFile(outIndexName, true, false, options.compressed);
 
 
 			//create meta page
@@ -115,72 +805,106 @@ namespace badgerdb
 
 			//fill meta info 
 			struct IndexMetaInfo metaInfo;
-			strncpy((char*)&(metaInfo.relationName),(const char*)&relationName, STRINGSIZE);
+			memset(&metaInfo, 0, sizeof(IndexMetaInfo));
+			strncpy(metaInfo.relationName, relationName.c_str(), sizeof(metaInfo.relationName) - 1);
 			metaInfo.attrByteOffset = attrByteOffset;
 			metaInfo.attrType = attrType;
 			metaInfo.rootPageNo = rootPageNum;
 			metaInfo.rootLeaf = true;
-			memcpy(headerPagePtr, &metaInfo, sizeof(IndexMetaInfo));
+			metaInfo.numIncluded = included.size();
+			for(std::size_t i = 0; i < included.size(); i++){
+				metaInfo.included[i] = included[i];
+			}
+			metaInfo.numKeyComponents = keyCodec.components().size();
+			for(std::size_t i = 0; i < keyCodec.components().size(); i++){
+				metaInfo.keyComponents[i] = keyCodec.components()[i];
+			}
+			metaInfo.postingLists = postingLists;
+			metaInfo.packedLeaves = packedLeaves;
+			memcpy((char*)headerPagePtr, &metaInfo, sizeof(IndexMetaInfo));
 
-			//probably a better way to do this but initialize root node
-			switch(attributeType){
+			//the root starts as an empty leaf
+			const NodeContext context = {leafOccupancy, nodeOccupancy, payloadWidth, file, bufMgr};
+			switch(postingLists ? STRING : attributeType){
 
 				case INTEGER: 
-				((LeafNodeInt*)(rootPagePtr))->slot = 0;
+				if(packedLeaves){
+					PackedLeaf(rootPagePtr, context).initialize(Page::INVALID_NUMBER);
+				}else{
+					IntLeaf(rootPagePtr, context).initialize(Page::INVALID_NUMBER);
+				}
 				break;
 
 				case DOUBLE: 	
-				((LeafNodeDouble*)(rootPagePtr))->slot = 0;
+				DoubleLeaf(rootPagePtr, context).initialize(Page::INVALID_NUMBER);
 				break;
 
 				case STRING: 
-				((LeafNodeString*)(rootPagePtr))->slot = 0;
+				if(postingLists){
+					PostingListLeaf(rootPagePtr, context).initialize(Page::INVALID_NUMBER);
+				}else{
+					PrefixLeaf(rootPagePtr, context).initialize(Page::INVALID_NUMBER);
+				}
 				break;		
 			}
 
+			//inserts read the pages through the buffer pool, and may move the root
+			bufMgr->unPinPage(file, headerPageNum, true);
+			bufMgr->unPinPage(file, rootPageNum, true);
+
 			//fill index file
 			try{
 
 				RecordId scanRid;
+				std::string payload(payloadWidth, '\0');
 
 				while(1)
 				{
 					scanner.scanNext(scanRid);
-					std::string recordStr = scanner.getRecord();
-					const char *record = recordStr.c_str();
+					const RecordView recordView = scanner.getRecordView();
+					const char *record = recordView.data;
+
+				//included attributes, zeros past the end of a short record
+					int position = 0;
+					for(std::size_t i = 0; i < included.size(); i++){
+						const int width = KeyCodec::width(included[i].type);
+						int available = recordView.len - included[i].offset;
+						available = std::max(0, std::min(available, width));
+						memcpy(&payload[position], record + included[i].offset, available);
+						memset(&payload[position + available], 0, width - available);
+						position += width;
+					}
 
 				//keys
 					int intkey;
 					double doublekey;
-					const char * charkey;
-					std::string stringkey;
 
 					switch(attributeType){
 
 						case INTEGER: 
-						intkey = *((int *)(record + attrByteOffset));
-						insertEntry(&intkey, scanRid);
+						intkey = FieldAccessor<int>(attrByteOffset).get(record);
+						insertEntry(&intkey, scanRid, payload.data());
 						break;
 
 						case DOUBLE: 
-						doublekey = *((double *)(record + attrByteOffset));
-						insertEntry(&doublekey, scanRid);
+						doublekey = FieldAccessor<double>(attrByteOffset).get(record);
+						insertEntry(&doublekey, scanRid, payload.data());
 						break;
 
 						case STRING: 
-						stringkey  = recordStr.substr(attrByteOffset, STRINGSIZE);	
-						charkey = stringkey.c_str();
-						insertEntry(&charkey, scanRid);
+						if(postingLists){
+							insertKey<std::string, PostingListLeaf, PrefixInterior>(recordStringKey(recordView), scanRid,
+								payload.data());
+						}else{
+							insertKey<std::string, PrefixLeaf, PrefixInterior>(recordStringKey(recordView), scanRid,
+								payload.data());
+						}
 						break;		
 					}
 
 				}
 			}
-			catch(EndOfFileException e){
-
-				//can we unpin before try???
-				bufMgr->unPinPage(file, headerPageNum, true);
-				bufMgr->unPinPage(file, rootPageNum, true);
+			catch(const EndOfFileException& e){
 			}
 
 		}
@@ -195,8 +919,17 @@ namespace badgerdb
 
 	BTreeIndex::~BTreeIndex()
 	{
-
-		bufMgr->flushFile(file);
+		// a destructor must not throw, so errors of the final flush are dropped
+		try
+		{
+			if(scanExecuting){
+				endScan();
+			}
+			bufMgr->flushFile(file);
+		}
+		catch(const BadgerDbException& e)
+		{
+		}
 	///Deletes the file ptr to invoke blobsfile's destructor
 		delete file;
 
@@ -204,511 +937,290 @@ namespace badgerdb
 	}
 
 // -----------------------------------------------------------------------------
-// BTreeIndex::insertEntry
+// BTreeIndex::setOccupancy
 // -----------------------------------------------------------------------------
 
-
-	const void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
+	void BTreeIndex::setOccupancy()
 	{
-
-		Page* headerPagePtr;
-		bufMgr->readPage(file, headerPageNum, headerPagePtr);
-		IndexMetaInfo * metaPtr = (IndexMetaInfo*) headerPagePtr;
-		bool rootLeaf = metaPtr->rootLeaf;
-		bufMgr->unPinPage(file, headerPageNum, false);
-
-		//root is leaf
-		if(rootLeaf){
-
-			switch(attributeType){
-				case INTEGER:	insertLeaf<int, struct LeafNodeInt, struct NonLeafNodeInt>(rootPageNum,  (void*)key, rid);
-				break;
-				break;
-				case DOUBLE:	insertLeaf<double, struct LeafNodeDouble, struct NonLeafNodeDouble>(rootPageNum,  (void*)key, rid);
-				break;
-				case STRING:	insertLeaf<std::string, struct LeafNodeString, struct NonLeafNodeString>(rootPageNum,  (void*)key, rid);
-
-			}
-
-
-		}else{
-
-			switch(attributeType){
-				case INTEGER:	{
-
-					RIDKeyPair<int>* intpair = new RIDKeyPair<int>();
-					intpair->set(rid, *((int*)key));
-					PageId leafNum = traversal<int, struct LeafNodeInt, struct NonLeafNodeInt>(rootPageNum, (RIDKeyPair<int>*) intpair);
-					insertLeaf<int, struct LeafNodeInt, struct NonLeafNodeInt>(leafNum, (void*)key, rid);
-
-				}
-				break;
-				case DOUBLE:	{
-
-					RIDKeyPair<double>* doublepair = new RIDKeyPair<double>();
-					doublepair->set(rid, *((double*)key));
-					PageId leafNum = traversal<double, struct LeafNodeDouble, struct NonLeafNodeDouble>(rootPageNum, (RIDKeyPair<double>*) doublepair);
-					insertLeaf<double, struct LeafNodeDouble, struct NonLeafNodeDouble>(leafNum, (void*)key, rid);
-
-				}
-
-
-				break;
-				case STRING:	
-				{
-
-					RIDKeyPair<std::string>* stringpair = new RIDKeyPair<std::string>();
-					stringpair->set(rid, *((std::string*)key));
-					PageId leafNum = traversal<std::string, struct LeafNodeString, struct NonLeafNodeString>(rootPageNum, (RIDKeyPair<std::string>*) stringpair);
-					insertLeaf<std::string, struct LeafNodeString, struct NonLeafNodeString>(leafNum, (void*)key, rid);
-					break;
-				}
-
-			}
-
-		}
-	}
-
-
-
-
-	template<class T, class leaf, class node>
-	const PageId BTreeIndex::traversal(PageId &root, RIDKeyPair<T>* rid_pair){
-
-			//get root info
-		Page* rootPagePtr;
-		bufMgr->readPage(file, rootPageNum, rootPagePtr);
-		node* rootptr = (node*) rootPagePtr;
-		int level = rootptr->level;
-		T key = rid_pair->key;
-
-
-		while(level >= 1){
-
-			PageId childPageNum;
-			Page* childPage;
-			bool found = false;
-			RecordId childRid;
-			for(int i = 0; i <= rootptr->slot; i++){
-				if(rid_pair->key < rootptr->keyArray[i]){
-					childPageNum = rootptr->pageNoArray[i];
-					found = true;
-					i = rootptr->slot +1;
-				}
-
-			}
-
-			if(!found){
-				childPageNum = childPageNum = rootptr->pageNoArray[rootptr->slot];
-			}
-
-
-			bufMgr->unPinPage(file, root, false);
-			bufMgr->readPage(file, childPageNum, childPage);
-
-			if(level ==1){
-				node* childnode = reinterpret_cast<node*> (childPage);
-				for(int i =0; i<childnode->slot; i++){
-					if(rid_pair->key < childnode->keyArray[i]){
-						return childnode->pageNoArray[i];
-					}
-				}
-
-			}else{
-
-				return traversal<T, leaf, node>(childPageNum, rid_pair);
-			}
-
-
-		}
-
-		//error
-		const PageId error = -1;
-		return error;
-
-	}
-
-
-	const void BTreeIndex::insertLeafData(Page* current, void* key, const RecordId &rid){
-
-
+		int leafSize = 0;
 		switch(attributeType){
-			case INTEGER:	{
-
-				LeafNodeInt* curr = (LeafNodeInt*) current;
-				curr->keyArray[curr->slot] = *((int*) key);
-				curr->ridArray[curr->slot] = rid;
 
-			}
-			break;
-			case DOUBLE:	{
-
-				LeafNodeDouble* curr = (LeafNodeDouble*) current;
-				curr->keyArray[curr->slot] = *((double*) key);
-				curr->ridArray[curr->slot] = rid;
-
-			}
+			case INTEGER: 
+			leafSize = INTARRAYLEAFSIZE;
+			nodeOccupancy = INTARRAYNONLEAFSIZE;
 			break;
-			case STRING:	
-			{
-				LeafNodeString* curr = (LeafNodeString*) current;
-				strncpy(curr->keyArray[curr->slot], (char*)key, 10);
-				curr->ridArray[curr->slot] = rid;
-			}
+			case DOUBLE: 
+			leafSize = DOUBLEARRAYLEAFSIZE;
+			nodeOccupancy = DOUBLEARRAYNONLEAFSIZE;
 			break;
+			case STRING: 
+			//PrefixKeyNodes hold as many entries as fit, however long their keys
+			nodeOccupancy = 0;
+			break;		
+		}
 
+		payloadWidth = 0;
+		for(std::size_t i = 0; i < included.size(); i++){
+			payloadWidth += KeyCodec::width(included[i].type);
 		}
 
+		//entries past leafOccupancy give their rid slots to the payloads:
+		//leafOccupancy * payloadWidth <= (leafSize - leafOccupancy) * sizeof(RecordId)
+		leafOccupancy = leafSize * sizeof(RecordId) / (sizeof(RecordId) + payloadWidth);
 	}
 
-	const void BTreeIndex::insertNodeData(Page* current, void* key, const PageId &pagenum){
-
+	std::string BTreeIndex::stringKey(const void* key) const
+	{
+		if(keyCodec.width() > 0){
+			return std::string((const char*)key, keyCodec.width());
+		}
+		return std::string((const char*)key, strnlen((const char*)key, maxKeyLength()));
+	}
 
+	std::string BTreeIndex::postingKey(const void* key) const
+	{
+		std::string bytes;
 		switch(attributeType){
-			case INTEGER:	{
-
-				NonLeafNodeInt* curr = (NonLeafNodeInt*) current;
-				curr->keyArray[curr->slot] = *((int*) key);
-				curr->pageNoArray[curr->slot] = pagenum;
-
-			}
+			case INTEGER:	KeyCodec::appendInt(bytes, keyAt<int>(key));
 			break;
-			case DOUBLE:	{
-
-				NonLeafNodeDouble* curr = (NonLeafNodeDouble*) current;
-				curr->keyArray[curr->slot] = *((double*) key);
-				curr->pageNoArray[curr->slot] = pagenum;
-
-			}
+			case DOUBLE:	KeyCodec::appendDouble(bytes, keyAt<double>(key));
 			break;
-			case STRING:	
-			{
-				NonLeafNodeString* curr = (NonLeafNodeString*) current;
-				strncpy(curr->keyArray[curr->slot], (char*)key, 10);
-				curr->pageNoArray[curr->slot] = pagenum;
-			}
+			case STRING:	bytes = stringKey(key);
 			break;
-
 		}
-
+		return bytes;
 	}
 
-
-
-
-
-	template<class T, class leaf, class node>
-	const void BTreeIndex::insertLeaf(PageId &target, void *key, const RecordId &rid){
-		Page* curr;
-		bufMgr->readPage(file, target, curr);
-		leaf* targetNode =  reinterpret_cast<leaf*> (curr);
-
-		//there is room
-		if(targetNode->slot < leafOccupancy){
-			insertLeafData(curr, key, rid);
-			targetNode->slot = targetNode->slot+1;
-			bufMgr->unPinPage(file, target, true);
-
-			//no room
-		}else{
-
-			bufMgr->unPinPage(file, target, false);
-			splitLeaf<T, leaf, node>( target, key, rid);
-
-
-		}
+	std::size_t BTreeIndex::maxKeyLength() const
+	{
+		return postingLists ? PostingLeaf::MAX_KEY_LENGTH : PrefixKeyNode::MAX_KEY_LENGTH;
 	}
 
-	template<class T, class leaf, class node>
-	const void BTreeIndex::splitNon(PageId &firstID, PageId &newAlloc_pageId){
-
-		//read and allocate pages needed to splitt
-		Page* first_page;
-		bufMgr->readPage(file, firstID, first_page);
-		node* firstNode = reinterpret_cast<node*>(first_page);
-
-		Page* parentptr;
-		PageId parentID;
-		bufMgr->allocPage(file, parentID, parentptr);
-		node* parentNode = reinterpret_cast<node*>(parentptr);
-
-
-		Page* secondptr;
-		PageId secondID;
-		bufMgr->allocPage(file, secondID, secondptr);
-		node* secondNode = reinterpret_cast<node*>(secondptr);
-
-
-		int start = nodeOccupancy/2;
-		secondNode->slot = 0;
-
-		//mcopy data into second node
-		for(int i = start; i < firstNode->slot; i++){
-			insertNodeData(secondptr, (void*)&(firstNode->keyArray[i]), (firstNode->pageNoArray[i]));
-			secondNode->slot = secondNode->slot + 1;
-		}
-
-		firstNode->slot = start;
-
-
-		//put first and second into parent
-		parentNode->slot = 0;
-		parentNode->pageNoArray[0] = firstID;
-		insertNodeData(parentptr, (void*)&(secondNode->keyArray[0]), secondNode->pageNoArray[0]);
-
-		//update level and unpin
-		parentNode->level = firstNode->level +1;
-		bufMgr->unPinPage(file, parentID, true);
-
-		//figure out whhich node to insert target to
-		Page* entry_page;
-		bufMgr->readPage(file, newAlloc_pageId, entry_page);
-		node* entry_nonleafPage = reinterpret_cast<node*> (entry_page);
-		node* target;
-
-		if(entry_nonleafPage->keyArray[0] >= secondNode->keyArray[0] ){
-			target = secondNode;
-		}
-		else{
-			target = firstNode;
-		}
-
-		target->slot = target->slot +1;
-		int inserter = 0;
-		T newKeyArray[sizeof(nodeOccupancy)];
-		PageId newPageNoArray[nodeOccupancy];
-
-		for(int i = 0; inserter <target->slot; inserter++){
-		//insert pageid to the right side and insert key
-
-			if(inserter == 0){
-				if(entry_nonleafPage->keyArray[0] <= target->keyArray[0]){
-					newPageNoArray[0] = newAlloc_pageId;
-				}else{
-					newPageNoArray[0] = target->pageNoArray[0];
-				}
-			}
-
-			if(entry_nonleafPage->keyArray[0] > target->keyArray[inserter]){
-				newKeyArray[inserter+i] = target->keyArray[inserter];
-				newPageNoArray[inserter+1+i] = target->pageNoArray[inserter + 1];
-			}
-			else{
-				newKeyArray[inserter+i] = entry_nonleafPage->keyArray[0];
-				newPageNoArray[inserter+1+i] = newAlloc_pageId;
-				i++;
-			}
-
+	std::string BTreeIndex::recordStringKey(const RecordView& record) const
+	{
+		if(keyCodec.width() > 0){
+			std::string key(keyCodec.width(), '\0');
+			keyCodec.encodeRecord(record, &key[0]);
+			return key;
 		}
-
-		memcpy(target->keyArray, newKeyArray, target->slot);
-		memcpy(target->pageNoArray, newPageNoArray, target->slot);
-		bufMgr->unPinPage(file, firstID, true);
-		bufMgr->unPinPage(file, secondID, true);
-		bufMgr->unPinPage(file, newAlloc_pageId, true);
-
-		//find the non leaf of that level and insert it
-		insertNonLeaf<T, leaf, node>(parentID, parentNode->level);
+		const int available = std::max(0, (int)record.len - attrByteOffset);
+		const char* attribute = record.data + attrByteOffset;
+		return std::string(attribute, strnlen(attribute, std::min<int>(available, maxKeyLength())));
 	}
 
+// -----------------------------------------------------------------------------
+// BTreeIndex::insertEntry
+// -----------------------------------------------------------------------------
 
-	template<class T, class leaf, class node>
-	const void BTreeIndex::insertNonLeaf(PageId &nodeID, int &level){
-
-		Page* rootptr;
-		bufMgr->readPage(file, rootPageNum, rootptr);
-		node* root = reinterpret_cast<node*> (rootptr);
-
-		//if we just split the root in method call uodate info, and were good
-		if(level >= root->level){
 
-			Page* metaPage;
-			bufMgr->readPage(file, headerPageNum, metaPage);
-			IndexMetaInfo* metaPtr = (IndexMetaInfo*)metaPage;
-			metaPtr->rootPageNo = nodeID;
-			rootPageNum = nodeID;
-			bufMgr->unPinPage(file, headerPageNum, true);
-			bufMgr->unPinPage(file, rootPageNum, false);
+	const void BTreeIndex::insertEntry(const void *key, const RecordId rid, const char* payload) 
+	{
+		if(postingLists){
+			insertKey<std::string, PostingListLeaf, PrefixInterior>(postingKey(key), rid, payload);
 			return;
-
 		}
-
-		Page* current_page;
-		bufMgr->readPage(file, nodeID, current_page);
-		node* curr = reinterpret_cast<node*> (current_page);
-		void* key = reinterpret_cast<void*> (&curr->keyArray[0]);
-
-		PageId parentID = parentSearch<T, leaf, node>(rootPageNum, key, level);
-		Page* parentPtr;
-		bufMgr->readPage(file, parentID, parentPtr);
-		node* target = reinterpret_cast<node*> (parentPtr);
-
-		int i = target->slot;
-		if(i < nodeOccupancy){
-
-			//need to copy pageid and key
-			target->pageNoArray[i] = curr->pageNoArray[0];
-
-			for(int j=0; j< curr->slot; j++){
-				insertNodeData(current_page,
-					(void*)&(curr->keyArray[j]), curr->pageNoArray[j+1] );
-				curr->slot = curr->slot +1;
+		switch(attributeType){
+			case INTEGER:
+			if(packedLeaves){
+				insertKey<int, PackedLeaf, IntInterior>(keyAt<int>(key), rid, payload);
+			}else{
+				insertKey<int, IntLeaf, IntInterior>(keyAt<int>(key), rid, payload);
 			}
-
-			bufMgr->unPinPage(file, nodeID, false);
-			bufMgr->unPinPage(file, parentID, true);
-
-			//since we over wrote page have to delete
-			file->deletePage(nodeID);
-
-
-		}
-		//we have to split
-		else{
-
-			bufMgr->unPinPage(file, nodeID, false);
-			bufMgr->unPinPage(file, parentID, false);
-			splitNon<T, leaf, node>(parentID, nodeID);
+			break;
+			case DOUBLE:	insertKey<double, DoubleLeaf, DoubleInterior>(keyAt<double>(key), rid, payload);
+			break;
+			case STRING:	insertKey<std::string, PrefixLeaf, PrefixInterior>(stringKey(key), rid, payload);
+			break;
 		}
 	}
 
-
-
-
-
-	template<class T, class leaf, class node>
-	const PageId BTreeIndex::parentSearch(PageId &root_id, void* key, int &target_level){
-
-		Page* meta_page;
-		bufMgr->readPage(file, headerPageNum, meta_page);
-		IndexMetaInfo* metapage = (IndexMetaInfo*) meta_page;
-		if(metapage->rootLeaf){
-			bufMgr->unPinPage(file, headerPageNum, false);
-			return rootPageNum;
+	template<class K, class Leaf, class Interior>
+	void BTreeIndex::insertKey(const K& key, const RecordId& rid, const char* payload)
+	{
+		//appends skip the descent
+		if(appendRightmost<K, Leaf, Interior>(key, rid, payload)){
+			return;
 		}
 
-		Page* root_page;
-		bufMgr->readPage(file, root_id, root_page);
-		node* root = reinterpret_cast<node*> (root_page);
+		Page* metaPage;
+		bufMgr->readPage(file, headerPageNum, metaPage);
+		const bool rootLeaf = ((IndexMetaInfo*) metaPage)->rootLeaf;
+		bufMgr->unPinPage(file, headerPageNum, false);
 
-		T obj_key = *((T*)key);
-		int level = root->level;
+		K upKey;
+		PageId upPage;
+		if(!insertInto<K, Leaf, Interior>(rootPageNum, rootLeaf, true, key, rid, payload, upKey, upPage)){
+			return;
+		}
 
-		while(level >= target_level){
+		//the root split: a new root goes over its two halves
+		const NodeContext context = {leafOccupancy, nodeOccupancy, payloadWidth, file, bufMgr};
+		Page* page;
+		int level = 1;
+		if(!rootLeaf){
+			bufMgr->readPage(file, rootPageNum, page);
+			level = Interior(page, context).level() + 1;
+			bufMgr->unPinPage(file, rootPageNum, false);
+		}
+		PageId newRootNum;
+		bufMgr->allocPage(file, newRootNum, page);
+		Interior root(page, context);
+		root.initialize(level, rootPageNum);
+		root.insert(0, upKey, upPage);
+		bufMgr->unPinPage(file, newRootNum, true);
+
+		bufMgr->readPage(file, headerPageNum, metaPage);
+		((IndexMetaInfo*) metaPage)->rootLeaf = false;
+		((IndexMetaInfo*) metaPage)->rootPageNo = newRootNum;
+		bufMgr->unPinPage(file, headerPageNum, true);
+		rootPageNum = newRootNum;
+	}
 
-			int i;
-			while(i <target_level ){
-				if(obj_key >= root->keyArray[i]){
-					i++;
-				}
-				else{
-					break;
+	template<class K, class Leaf, class Interior>
+	bool BTreeIndex::insertInto(const PageId pageNum, const bool isLeaf, const bool rightEdge, const K& key,
+		const RecordId& rid, const char* payload, K& upKey, PageId& upPage)
+	{
+		const NodeContext context = {leafOccupancy, nodeOccupancy, payloadWidth, file, bufMgr};
+		Page* page;
+		Page* rightPage;
+		bufMgr->readPage(file, pageNum, page);
+
+		if(isLeaf){
+			Leaf leaf(page, context);
+			if(leaf.insert(key, rid, payload)){
+				if(rightEdge){
+					cacheRightmostLeaf<K>(pageNum, leaf);
 				}
-
+				bufMgr->unPinPage(file, pageNum, true);
+				return false;
 			}
 
-			PageId childNum = root->pageNoArray[i];
-			bufMgr->unPinPage(file, root_id, false);
-
-			if(level == target_level){
-				return childNum;
-			}else{
-
-				return parentSearch<T, leaf, node>(childNum, key, target_level);
-
+			bufMgr->allocPage(file, upPage, rightPage);
+			Leaf right(rightPage, context);
+			upKey = leaf.split(right, upPage, key, rid, payload);
+			if(rightEdge){
+				cacheRightmostLeaf<K>(upPage, right);
 			}
+			bufMgr->unPinPage(file, upPage, true);
+			bufMgr->unPinPage(file, pageNum, true);
+			return true;
 		}
 
-		PageId error = -1;
-		return error;
-
-	}
-
-
-
-
-	template<class T, class leaf, class node>
-	const void BTreeIndex::splitLeaf(PageId &leafNum, void *key, const RecordId rid){
+		//descend past any equal keys, so duplicates go right of the ones already in
+		Interior node(page, context);
+		const int position = node.upperBound(key);
+		const PageId childNum = node.child(position);
+		const bool childLeaf = node.level() == 1;
+		const bool childRightEdge = rightEdge && position == node.numKeys();
+		bufMgr->unPinPage(file, pageNum, false);
+
+		K childKey;
+		PageId childPage;
+		if(!insertInto<K, Leaf, Interior>(childNum, childLeaf, childRightEdge, key, rid, payload, childKey, childPage)){
+			return false;
+		}
 
-		Page* curr;
-		bufMgr->readPage(file, leafNum, curr);
-		leaf* orgLeaf = reinterpret_cast<leaf*> (curr);
+		//the new page goes right of the child it split from
+		bufMgr->readPage(file, pageNum, page);
+		Interior parent(page, context);
+		if(parent.insert(position, childKey, childPage)){
+			bufMgr->unPinPage(file, pageNum, true);
+			return false;
+		}
 
-		//make new page for split
-		Page* newLeaf;
-		PageId newLeafPageNum;
-		bufMgr->allocPage(file, newLeafPageNum, newLeaf);
-		leaf* newLeafNode = reinterpret_cast<leaf*> (newLeaf);
-		newLeafNode->slot =0;
+		bufMgr->allocPage(file, upPage, rightPage);
+		Interior right(rightPage, context);
+		upKey = parent.split(right, upPage, position, childKey, childPage, childRightEdge);
+		bufMgr->unPinPage(file, upPage, true);
+		bufMgr->unPinPage(file, pageNum, true);
+		return true;
+	}
 
+	template<class K, class Leaf>
+	void BTreeIndex::cacheRightmostLeaf(const PageId leafNum, const Leaf& leaf)
+	{
+		rightmostLeafNum = leafNum;
+		rightmostEmpty = leaf.count() == 0;
+		if(!rightmostEmpty){
+			rightmostHighKey = keyBytes(leaf.key(leaf.count() - 1));
+		}
+	}
 
-		//where to start copying from
-		int startCopy =  leafOccupancy/2;
+	template<class K, class Leaf, class Interior>
+	void BTreeIndex::findRightmostLeaf()
+	{
+		const NodeContext context = {leafOccupancy, nodeOccupancy, payloadWidth, file, bufMgr};
+		Page* page;
+		bufMgr->readPage(file, headerPageNum, page);
+		bool isLeaf = ((IndexMetaInfo*) page)->rootLeaf;
+		bufMgr->unPinPage(file, headerPageNum, false);
 
-		//memcopy
-		for(int i = startCopy; i < orgLeaf->slot; i++){
-			insertLeafData(newLeaf, (void*)&(orgLeaf->keyArray[i]), (orgLeaf->ridArray[i]));
-			newLeafNode->slot = newLeafNode->slot + 1;
+		//the last child of every level down to the leaves
+		PageId pageNum = rootPageNum;
+		while(!isLeaf){
+			bufMgr->readPage(file, pageNum, page);
+			Interior node(page, context);
+			const PageId childNum = node.child(node.numKeys());
+			isLeaf = node.level() == 1;
+			bufMgr->unPinPage(file, pageNum, false);
+			pageNum = childNum;
 		}
 
-		orgLeaf->slot = startCopy;
+		bufMgr->readPage(file, pageNum, page);
+		cacheRightmostLeaf<K>(pageNum, Leaf(page, context));
+		bufMgr->unPinPage(file, pageNum, false);
+	}
 
-		//whcih node to insert upon?
-		if(*((T*)key) < newLeafNode->keyArray[0]){
-			insertLeafData(curr, key, rid);
-			orgLeaf->slot++;
+	template<class K, class Leaf, class Interior>
+	bool BTreeIndex::appendRightmost(const K& key, const RecordId& rid, const char* payload)
+	{
+		if(rightmostLeafNum == Page::INVALID_NUMBER){
+			findRightmostLeaf<K, Leaf, Interior>();
 		}
-		else{
-			insertLeafData(newLeaf, key, rid);	
-			newLeafNode->slot++;
 
+		//the high key check needs no page
+		if(!rightmostEmpty && compareKeys(key, bytesKey<K>(rightmostHighKey)) < 0){
+			return false;
 		}
 
-		//connect pointers
-		newLeafNode->rightSibPageNo = orgLeaf->rightSibPageNo;
-		orgLeaf->rightSibPageNo = newLeafPageNum;
-
-		//create new non leaf node to  point to new leaf node
-		PageId nonleaf_pageid;
-		Page* nonleaf_page;
-		bufMgr->allocPage(file, nonleaf_pageid, nonleaf_page);
-		node* first_nonleafPage = reinterpret_cast<node*> (nonleaf_page);
-		first_nonleafPage->level = 1;
-		first_nonleafPage->slot = 0;
-
-		insertNodeData(nonleaf_page, (void*)&(newLeafNode->keyArray[0]), newLeafPageNum );
-		first_nonleafPage->slot = first_nonleafPage->slot + 1;
-
-		//unpin leafs
-		bufMgr->unPinPage(file, newLeafPageNum, true);
-		bufMgr->unPinPage(file, leafNum, true);
-
-		//meta
-		Page* metapage;
-		bufMgr->readPage(file, headerPageNum, metapage);
-		IndexMetaInfo* metaPtr = (IndexMetaInfo*) metapage;
-
-		//check if root was a leaf 
-		if(metaPtr->rootLeaf){
-			metaPtr->rootLeaf = false;
-			rootPageNum = nonleaf_pageid;
-			metaPtr->rootPageNo = nonleaf_pageid;
-			bufMgr->unPinPage(file, headerPageNum, true);
-			first_nonleafPage->pageNoArray[0] = leafNum;
-			bufMgr->unPinPage(file, nonleaf_pageid, true);
-
+		//a full leaf is split by the descent, which finds its parent
+		const NodeContext context = {leafOccupancy, nodeOccupancy, payloadWidth, file, bufMgr};
+		Page* page;
+		bufMgr->readPage(file, rightmostLeafNum, page);
+		Leaf leaf(page, context);
+		if(!leaf.insert(key, rid, payload)){
+			bufMgr->unPinPage(file, rightmostLeafNum, false);
+			return false;
+		}
+		rightmostHighKey = keyBytes(key);
+		rightmostEmpty = false;
+		bufMgr->unPinPage(file, rightmostLeafNum, true);
+		return true;
+	}
 
-		}else{
-			bufMgr->unPinPage(file, headerPageNum, false);
-			bufMgr->unPinPage(file, nonleaf_pageid, true);
+	template<class K, class Interior>
+	PageId BTreeIndex::findLeaf(const K& key)
+	{
+		const NodeContext context = {leafOccupancy, nodeOccupancy, payloadWidth, file, bufMgr};
+		Page* page;
+		bufMgr->readPage(file, headerPageNum, page);
+		bool isLeaf = ((IndexMetaInfo*) page)->rootLeaf;
+		bufMgr->unPinPage(file, headerPageNum, false);
 
-			insertNonLeaf<T, leaf, node>(nonleaf_pageid, first_nonleafPage->level);
+		//the leftmost child that can hold the key, at every level
+		PageId pageNum = rootPageNum;
+		while(!isLeaf){
+			bufMgr->readPage(file, pageNum, page);
+			Interior node(page, context);
+			const PageId childNum = node.child(node.lowerBound(key));
+			isLeaf = node.level() == 1;
+			bufMgr->unPinPage(file, pageNum, false);
+			pageNum = childNum;
 		}
-
+		return pageNum;
 	}
 
 
-
 // -----------------------------------------------------------------------------
 // BTreeIndex::startScan
 // -----------------------------------------------------------------------------
@@ -718,171 +1230,73 @@ namespace badgerdb
 		const void* highValParm,
 		const Operator highOpParm)
 	{
+		if((lowOpParm != GT && lowOpParm != GTE) || (highOpParm != LT && highOpParm != LTE)){
+			throw BadOpcodesException();
+		}
 
-					scanExecuting = true;
-			lowOp = lowOpParm;
-			highOp = highOpParm;
-
-		
-		if((lowOp!=LT && lowOp!=LTE && lowOp!=GTE && lowOp!=GT) ||(highOp!=LT && highOp!=LTE && highOp!=GTE && highOp!=GT)){
-	
-			throw BadOpcodesException();	
-		}	
-
-		Page* meta_page;
-		bufMgr->readPage(file, headerPageNum, meta_page);
-		IndexMetaInfo* metaptr = (IndexMetaInfo*) meta_page;
-
-
-		currentPageNum = headerPageNum;
-		bufMgr->readPage(file, currentPageNum, currentPageData);
-
+		//NaN keys sort after infinity, but match no range, so nothing is bounded by one
+		if(attributeType == DOUBLE &&
+			(std::isnan(keyAt<double>(lowValParm)) || std::isnan(keyAt<double>(highValParm)))){
+			throw BadScanrangeException();
+		}
 
-		switch(attributeType){
+		PageId leafNum = Page::INVALID_NUMBER;
+		switch(postingLists ? STRING : attributeType){
 
 			case INTEGER:{
-
-			//cast 
-				lowValInt = *((int*)lowValParm);
-				highValInt = *((int*) highValParm);
-				NonLeafNodeInt *itr = (NonLeafNodeInt *)currentPageData;
-				
-				while(itr->level != 1){
-
-					int i = 0;
-
-					while(itr->keyArray[i] < lowValInt && i<nodeOccupancy && itr->pageNoArray[i+1] !=0){
-						i++;
-					}
-
-					PageId nextNum = itr->pageNoArray[i];
-
-				//update itr
-					bufMgr->readPage(file, nextNum, currentPageData);
-					bufMgr->unPinPage(file, currentPageNum, false);
-					currentPageNum = nextNum;
-
-					itr = (NonLeafNodeInt*) currentPageData;
-
-
-				}
-
-			//pointint to leafs
-				int j = 0;
-				while(itr->keyArray[j] > lowValInt && itr->pageNoArray[j + 1] != 0 && j < nodeOccupancy){
-					j++;
+				const int low = keyAt<int>(lowValParm);
+				const int high = keyAt<int>(highValParm);
+				if(low > high){
+					throw BadScanrangeException();
 				}
-
-				PageId nextNum = itr->pageNoArray[j];
-
-			//update itr
-				bufMgr->readPage(file, nextNum, currentPageData);
-				bufMgr->unPinPage(file, currentPageNum, false);
-				currentPageNum = nextNum;
-
-				itr = (NonLeafNodeInt*) currentPageData;
-
-			//set up scan
-				nextEntry = 0;
-
+				lowValInt = low;
+				highValInt = high;
+				leafNum = findLeaf<int, IntInterior>(lowValInt);
 			}
 			break;
 			case DOUBLE:{
-
-			//cast 
-				lowValDouble = *((double*)lowValParm);
-				highValDouble = *((double*) highValParm);
-				NonLeafNodeDouble *itr = (NonLeafNodeDouble *)currentPageData;
-				
-
-				while(itr->level != 1){
-
-					int i = 0;
-
-					while(itr->keyArray[i] < lowValDouble && i<nodeOccupancy && itr->pageNoArray[i+1] !=0){
-						i++;
-					}
-
-					PageId nextNum = itr->pageNoArray[i];
-
-				//update itr
-					bufMgr->readPage(file, nextNum, currentPageData);
-					bufMgr->unPinPage(file, currentPageNum, false);
-					currentPageNum = nextNum;
-
-					itr = (NonLeafNodeDouble*) currentPageData;
-
-
-				}
-
-			//pointint to leafs
-				int j = 0;
-				while(itr->keyArray[j] > lowValDouble && itr->pageNoArray[j + 1] != 0 && j < nodeOccupancy){
-					j++;
+				const double low = keyAt<double>(lowValParm);
+				const double high = keyAt<double>(highValParm);
+				if(compareKeys(low, high) > 0){
+					throw BadScanrangeException();
 				}
-
-				PageId nextNum = itr->pageNoArray[j];
-
-			//update itr
-				bufMgr->readPage(file, nextNum, currentPageData);
-				bufMgr->unPinPage(file, currentPageNum, false);
-				currentPageNum = nextNum;
-
-				itr = (NonLeafNodeDouble*) currentPageData;
-
-			//set up scan
-				nextEntry = 0;
-
+				lowValDouble = low;
+				highValDouble = high;
+				leafNum = findLeaf<double, DoubleInterior>(lowValDouble);
 			}
 			break;
 			case STRING:{
-			//cast 
-				lowValString =  std::string((char *)lowValParm).substr(0,STRINGSIZE);;
-				highValString = std::string((char *) highValParm).substr(0,STRINGSIZE);;
-				NonLeafNodeString *itr = (NonLeafNodeString*)currentPageData;
-				
-				while(itr->level != 1){
-
-					int i = 0;
-
-					while(itr->keyArray[i] < lowValString && i<nodeOccupancy && itr->pageNoArray[i+1] !=0){
-						i++;
-					}
-
-					PageId nextNum = itr->pageNoArray[i];
-
-				//update itr
-					bufMgr->readPage(file, nextNum, currentPageData);
-					bufMgr->unPinPage(file, currentPageNum, false);
-					currentPageNum = nextNum;
-
-					itr = (NonLeafNodeString*) currentPageData;
-
-
-				}
-
-			//pointint to leafs
-				int j = 0;
-				while(itr->keyArray[j] > lowValString && itr->pageNoArray[j + 1] != 0 && j < nodeOccupancy){
-					j++;
+				const std::string low = postingLists ? postingKey(lowValParm) : stringKey(lowValParm);
+				const std::string high = postingLists ? postingKey(highValParm) : stringKey(highValParm);
+				if(compareKeys(low, high) > 0){
+					throw BadScanrangeException();
 				}
-
-				PageId nextNum = itr->pageNoArray[j];
-
-			//update itr
-				bufMgr->readPage(file, nextNum, currentPageData);
-				bufMgr->unPinPage(file, currentPageNum, false);
-				currentPageNum = nextNum;
-
-				itr = (NonLeafNodeString*) currentPageData;
-
-			//set up scan
-				nextEntry = 0;
-
+				lowValString = low;
+				highValString = high;
+				leafNum = findLeaf<std::string, PrefixInterior>(lowValString);
 			}
-			break;		
+			break;
 		}
 
+		//a scan already executing ends here
+		if(scanExecuting){
+			endScan();
+		}
+		lowOp = lowOpParm;
+		highOp = highOpParm;
+		currentPageNum = leafNum;
+		bufMgr->readPage(file, currentPageNum, currentPageData);
+		scanExecuting = true;
+		nextEntry = 0;
+		filterLeaf();
+
+		//the leaf holding the first match
+		while(leafMatches.empty()){
+			if(!nextLeaf()){
+				endScan();
+				throw NoSuchKeyFoundException();
+			}
+		}
 	}
 
 // -----------------------------------------------------------------------------
@@ -891,218 +1305,222 @@ namespace badgerdb
 
 	const void BTreeIndex::scanNext(RecordId& outRid) 
 	{
-
 		if(scanExecuting == false){
 			throw ScanNotInitializedException();
 		}
-		bufMgr->readPage(file, currentPageNum, currentPageData);
 
+		//leaf done: move right unless its keys already passed the range
+		while(nextEntry >= (int)leafMatches.size()){
+			if(!nextLeaf()){
+				throw IndexScanCompletedException();
+			}
+		}
 
+		const NodeContext context = {leafOccupancy, nodeOccupancy, payloadWidth, file, bufMgr};
+		scannedEntry = leafMatches[nextEntry];
+		nextEntry++;
+		if(postingLists || packedLeaves){
+			outRid = leafRids[scannedEntry];
+			return;
+		}
 		switch(attributeType){
-			case INTEGER:	{
-
-				bool done = false;
-
-				while(!done){
-
-					LeafNodeInt *curr = (LeafNodeInt *)currentPageData;
-
-					//new page
-					if( (nextEntry >= nodeOccupancy) || (curr->ridArray[nextEntry].page_number == 0) ){
-
-						//update curr
-						PageId nextNum = curr->rightSibPageNo;
-
-						//scan complete
-						if(nextNum ==0){
-							throw IndexScanCompletedException();
-						}else{
-							currentPageNum = nextNum;
-
-						}
+			case INTEGER:	outRid = IntLeaf(currentPageData, context).rid(scannedEntry);
+			break;
+			case DOUBLE:	outRid = DoubleLeaf(currentPageData, context).rid(scannedEntry);
+			break;
+			case STRING:	outRid = PrefixLeaf(currentPageData, context).rid(scannedEntry);
+			break;
+		}
+	}
 
-						bufMgr->unPinPage(file, currentPageNum, false);
-						bufMgr->readPage(file, currentPageNum, currentPageData);
+	const void BTreeIndex::scanNext(RecordId& outRid, int& outKey)
+	{
+		if(attributeType != INTEGER){
+			throw BadIndexInfoException("index key is not an INTEGER");
+		}
+		scanNext(outRid);
+		if(postingLists){
+			const NodeContext context = {leafOccupancy, nodeOccupancy, payloadWidth, file, bufMgr};
+			outKey = KeyCodec::decodeInt(PostingListLeaf(currentPageData, context).key(leafRidKeys[scannedEntry]).data());
+			return;
+		}
+		if(packedLeaves){
+			outKey = leafKeys[scannedEntry];
+			return;
+		}
+		outKey = ((LeafNodeInt *)currentPageData)->keyArray[scannedEntry];
+	}
 
-						//new page
-						nextEntry = 0;
+	const void BTreeIndex::scanNext(RecordId& outRid, double& outKey)
+	{
+		if(attributeType != DOUBLE){
+			throw BadIndexInfoException("index key is not a DOUBLE");
+		}
+		scanNext(outRid);
+		if(postingLists){
+			const NodeContext context = {leafOccupancy, nodeOccupancy, payloadWidth, file, bufMgr};
+			outKey = KeyCodec::decodeDouble(PostingListLeaf(currentPageData, context).key(leafRidKeys[scannedEntry]).data());
+			return;
+		}
+		outKey = ((LeafNodeDouble *)currentPageData)->keyArray[scannedEntry];
+	}
 
-					}
+	const void BTreeIndex::scanNext(RecordId& outRid, RecordView& outKey)
+	{
+		if(attributeType != STRING){
+			throw BadIndexInfoException("index key is not a STRING");
+		}
+		scanNext(outRid);
+		const NodeContext context = {leafOccupancy, nodeOccupancy, payloadWidth, file, bufMgr};
+		if(postingLists){
+			scannedKey = PostingListLeaf(currentPageData, context).key(leafRidKeys[scannedEntry]);
+		}else{
+			scannedKey = PrefixLeaf(currentPageData, context).key(scannedEntry);
+		}
+		outKey.data = scannedKey.data();
+		outKey.len = scannedKey.length();
+	}
 
-					else if(lowOp == GT || lowOp == GTE){
-						if(lowOp == GT){
-							if(curr->keyArray[nextEntry] > lowValInt){
-								nextEntry++;
-							}
+	RecordView BTreeIndex::scanPayload()
+	{
+		if(scanExecuting == false){
+			throw ScanNotInitializedException();
+		}
+		const NodeContext context = {leafOccupancy, nodeOccupancy, payloadWidth, file, bufMgr};
+		RecordView payload;
+		payload.len = payloadWidth;
+		payload.data = NULL;
+		if(postingLists || packedLeaves){
+			return payload;
+		}
+		switch(attributeType){
+			case INTEGER:	payload.data = IntLeaf(currentPageData, context).payload(scannedEntry);
+			break;
+			case DOUBLE:	payload.data = DoubleLeaf(currentPageData, context).payload(scannedEntry);
+			break;
+			case STRING:	payload.data = PrefixLeaf(currentPageData, context).payload(scannedEntry);
+			break;
+		}
+		return payload;
+	}
 
-						}else{
-							if(curr->keyArray[nextEntry] <= lowValInt){
-								nextEntry++;
-							}
-						}
-					}
+// -----------------------------------------------------------------------------
+// BTreeIndex::filterLeaf
+// -----------------------------------------------------------------------------
 
-					else if(highOp == LT || highOp == LTE){
-						if(highOp == LT){
-							if(curr->keyArray[nextEntry] < highValInt){
-								throw IndexScanCompletedException();
-							}
-						}else{
-							if(curr->keyArray[nextEntry] <= highValInt){
-								throw IndexScanCompletedException();
-							}
-						}
-					}
+	void BTreeIndex::filterLeaf()
+	{
+		leafMatches.clear();
+		leafPastRange = false;
+		bool complement;
+
+		if(postingLists){
+			//the rids of every key within the range, in key order
+			const NodeContext context = {leafOccupancy, nodeOccupancy, payloadWidth, file, bufMgr};
+			const PostingListLeaf leaf(currentPageData, context);
+			std::vector<std::uint32_t> keys;
+			selectKeyRange(leaf, lowValString, lowOp, highValString, highOp, keys, leafPastRange);
+			leafRids.clear();
+			leafRidKeys.clear();
+			for(std::size_t i = 0; i < keys.size(); i++){
+				leaf.rids(keys[i], leafRids);
+				leafRidKeys.resize(leafRids.size(), keys[i]);
+			}
+			for(std::size_t i = 0; i < leafRids.size(); i++){
+				leafMatches.push_back(i);
+			}
+			return;
+		}
 
-					else{
+		switch(attributeType){
 
-						outRid = curr->ridArray[nextEntry];
-						nextEntry++;
-						done = true;
-					}
+			case INTEGER:{
+				const std::int32_t* keys;
+				int used;
+				if(packedLeaves){
+					//the kernels compare the keys unpacked, and the scan returns the rids unpacked with them
+					const PackedIntLeaf leaf(currentPageData);
+					used = leaf.count();
+					leafKeys.resize(used);
+					leafRids.resize(used);
+					leaf.unpackKeys(leafKeys.data());
+					leaf.unpackRids(leafRids.data());
+					keys = leafKeys.data();
+				}else{
+					LeafNodeInt *leaf = (LeafNodeInt *)currentPageData;
+					used = leaf->slot;
+					keys = leaf->keyArray;
+				}
 
+				//each operator bounds one end of the range
+				std::int32_t low, high, unbounded;
+				if(!FilterKernels::rangeFor(lowOp, lowValInt, low, unbounded, complement) ||
+					!FilterKernels::rangeFor(highOp, highValInt, unbounded, high, complement)){
+					leafPastRange = true;
+					return;
 				}
+				leafMatches.resize(used);
+				leafMatches.resize(FilterKernels::selectIntRange(keys, used, low, high,
+					false, leafMatches.data()));
+				leafPastRange = used > 0 && keys[used - 1] > high;
 			}
 			break;
-			case DOUBLE:	{
-
-				bool done = false;
-
-				while(!done){
-
-					LeafNodeDouble *curr = (LeafNodeDouble *)currentPageData;
-
-					//new page
-					if( (nextEntry >= nodeOccupancy) || (curr->ridArray[nextEntry].page_number == 0) ){
-
-						//update curr
-						PageId nextNum = curr->rightSibPageNo;
-
-						//scan complete
-						if(nextNum ==0){
-							throw IndexScanCompletedException();
-						}else{
-							currentPageNum = nextNum;
-
-						}
-
-						bufMgr->unPinPage(file, currentPageNum, false);
-						bufMgr->readPage(file, currentPageNum, currentPageData);
-
-						//new page
-						nextEntry = 0;
-
-					}
-
-					else if(lowOp == GT || lowOp == GTE){
-						if(lowOp == GT){
-							if(curr->keyArray[nextEntry] > lowValDouble){
-								nextEntry++;
-							}
-
-						}else{
-							if(curr->keyArray[nextEntry] <= lowValDouble){
-								nextEntry++;
-							}
-						}
-					}
-
-					else if(highOp == LT || highOp == LTE){
-						if(highOp == LT){
-							if(curr->keyArray[nextEntry] < highValDouble){
-								throw IndexScanCompletedException();
-							}
-						}else{
-							if(curr->keyArray[nextEntry] <= highValDouble){
-								throw IndexScanCompletedException();
-							}
-						}
-					}
-
-					else{
-
-						outRid = curr->ridArray[nextEntry];
-						nextEntry++;
-						done = true;
-					}
-
+			case DOUBLE:{
+				LeafNodeDouble *leaf = (LeafNodeDouble *)currentPageData;
+				const int used = leaf->slot;
+
+				double low, high, unbounded;
+				if(!FilterKernels::rangeFor(lowOp, lowValDouble, low, unbounded, complement) ||
+					!FilterKernels::rangeFor(highOp, highValDouble, unbounded, high, complement)){
+					leafPastRange = true;
+					return;
 				}
-
-				
-
+				leafMatches.resize(used);
+				leafMatches.resize(FilterKernels::selectDoubleRange(leaf->keyArray, used, low, high,
+					false, leafMatches.data()));
+				leafPastRange = used > 0 && compareKeys(leaf->keyArray[used - 1], high) > 0;
 			}
 			break;
-			case STRING:	
-			{
-
-				bool done = false;
-
-				while(!done){
-
-					LeafNodeString *curr = (LeafNodeString *)currentPageData;
-
-					//new page
-					if( (nextEntry >= nodeOccupancy) || (curr->ridArray[nextEntry].page_number == 0) ){
-
-						//update curr
-						PageId nextNum = curr->rightSibPageNo;
-
-						//scan complete
-						if(nextNum ==0){
-							throw IndexScanCompletedException();
-						}else{
-							currentPageNum = nextNum;
-
-						}
-
-						bufMgr->unPinPage(file, currentPageNum, false);
-						bufMgr->readPage(file, currentPageNum, currentPageData);
-
-						//new page
-						nextEntry = 0;
-
-					}
-
-					else if(lowOp == GT || lowOp == GTE){
-						if(lowOp == GT){
-							if(curr->keyArray[nextEntry] > lowValString){
-								nextEntry++;
-							}
-
-						}else{
-							if(curr->keyArray[nextEntry] <= lowValString){
-								nextEntry++;
-							}
-						}
-					}
-
-					else if(highOp == LT || highOp == LTE){
-						if(highOp == LT){
-							if(curr->keyArray[nextEntry] < highValString){
-								throw IndexScanCompletedException();
-							}
-						}else{
-							if(curr->keyArray[nextEntry] <= highValString){
-								throw IndexScanCompletedException();
-							}
-						}
-					}
-
-					else{
-
-						outRid = curr->ridArray[nextEntry];
-						nextEntry++;
-						done = true;
-					}
-
-				}
-
-				
+			case STRING:{
+				//the entries are sorted: skip those below the range, stop at the first above it
+				const NodeContext context = {leafOccupancy, nodeOccupancy, payloadWidth, file, bufMgr};
+				selectKeyRange(PrefixLeaf(currentPageData, context), lowValString, lowOp, highValString, highOp,
+					leafMatches, leafPastRange);
 			}
 			break;
 		}
+	}
 
+	PageId BTreeIndex::leafRightSibling()
+	{
+		const NodeContext context = {leafOccupancy, nodeOccupancy, payloadWidth, file, bufMgr};
+		if(postingLists){
+			return PostingListLeaf(currentPageData, context).rightSibling();
+		}
+		switch(attributeType){
+			case INTEGER:
+			if(packedLeaves){
+				return PackedLeaf(currentPageData, context).rightSibling();
+			}
+			return IntLeaf(currentPageData, context).rightSibling();
+			case DOUBLE:	return DoubleLeaf(currentPageData, context).rightSibling();
+			case STRING:	return PrefixLeaf(currentPageData, context).rightSibling();
+		}
+		return Page::INVALID_NUMBER;
+	}
 
+	bool BTreeIndex::nextLeaf()
+	{
+		const PageId nextNum = leafPastRange ? Page::INVALID_NUMBER : leafRightSibling();
+		if(nextNum == Page::INVALID_NUMBER){
+			return false;
+		}
+		bufMgr->unPinPage(file, currentPageNum, false);
+		currentPageNum = nextNum;
+		bufMgr->readPage(file, currentPageNum, currentPageData);
+		nextEntry = 0;
+		filterLeaf();
+		return true;
 	}
 
 // -----------------------------------------------------------------------------
@@ -1115,10 +1533,7 @@ namespace badgerdb
 			throw ScanNotInitializedException();
 		}
 		scanExecuting = false;
-		if(currentPageNum != 0){
-			bufMgr->unPinPage(file, currentPageNum, false);
-		}
-
+		bufMgr->unPinPage(file, currentPageNum, false);
 	}
 
 }
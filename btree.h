@@ -11,45 +11,22 @@
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <vector>
 #include "types.h"
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
+#include "tuple_layout.h"
+#include "key_codec.h"
 
 namespace badgerdb
 {
 
-/**
- * @brief Datatype enumeration type.
- */
-  enum Datatype
-  {
-   INTEGER = 0,
-   DOUBLE = 1,
-   STRING = 2
- };
-
-/**
- * @brief Scan operations enumeration. Passed to BTreeIndex::startScan() method.
- */
- enum Operator
- { 
-  LT,   /* Less Than */
-  LTE,  /* Less Than or Equal to */
-  GTE,  /* Greater Than or Equal to */
-  GT    /* Greater Than */
- };
-
-/**
- * @brief Size of String key.
- */
- const  int STRINGSIZE = 10;
-
 /**
  * @brief Number of key slots in B+Tree leaf for INTEGER key.
  */
-//                                                  sibling ptr             key               rid
- const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
+//                                                  level, slot             sibling ptr             key               rid
+ const  int INTARRAYLEAFSIZE = ( Page::SIZE - 2 * sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( RecordId ) );
 
 /**
  * @brief Number of key slots in B+Tree leaf for DOUBLE key.
@@ -57,17 +34,11 @@ namespace badgerdb
 //                                                     sibling ptr               key               rid
  const  int DOUBLEARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( sizeof( double ) + sizeof( RecordId ) );
 
-/**
- * @brief Number of key slots in B+Tree leaf for STRING key.
- */
-//                                                    sibling ptr           key                      rid
- const  int STRINGARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) ) / ( 10 * sizeof(char) + sizeof( RecordId ) );
-
 /**
  * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
  */
-//                                                     level     extra pageNo                  key       pageNo
- const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
+//                                                     level, slot     extra pageNo                  key       pageNo
+ const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - 2 * sizeof( int ) - sizeof( PageId ) ) / ( sizeof( int ) + sizeof( PageId ) );
 
 /**
  * @brief Number of key slots in B+Tree leaf for DOUBLE key.
@@ -76,10 +47,14 @@ namespace badgerdb
  const  int DOUBLEARRAYNONLEAFSIZE = (( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( sizeof( double ) + sizeof( PageId ) )) - 1;
 
 /**
- * @brief Number of key slots in B+Tree leaf for STRING key.
+ * @brief Largest number of attributes a covering index can include in its leaves.
  */
-//                                                        level        extra pageNo             key                   pageNo
- const  int STRINGARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) ) / ( 10 * sizeof(char) + sizeof( PageId ) );
+ const  int MAXINCLUDEDATTRS = 4;
+
+/**
+ * @brief Largest number of attributes in a composite key.
+ */
+ const  int MAXKEYCOMPONENTS = 4;
 
 /**
  * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that 
@@ -127,6 +102,37 @@ bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
     return r1.rid.page_number < r2.rid.page_number;
 }
 
+/**
+ * @brief Options for building a new index.  An index opened from an existing file keeps the options it was
+ * built with.
+*/
+struct IndexOptions{
+
+  /**
+   * Store the pages of the index file compressed (see BlobFile::createCompressed), trading CPU on every
+   * read and write for a smaller file.
+   */
+  bool compressed;
+
+  /**
+   * Store each distinct key of a leaf once, with the list of the RecordIds having it (see PostingLeaf), so an
+   * index over an attribute with few distinct values takes a fraction of the pages.  Keys of any type are
+   * kept as their KeyCodec bytes, STRING ones at most PostingLeaf::MAX_KEY_LENGTH long.  Posting lists have
+   * no room for included attributes.
+   */
+  bool postingLists;
+
+  /**
+   * Store the leaves of an INTEGER index packed by frame of reference (see PackedIntLeaf), fitting two to
+   * three times the entries of a LeafNodeInt when neighboring keys and their records' pages are close.
+   * Every insert repacks its leaf, so this suits bulk-loaded, read-mostly indexes.  Packed leaves have no
+   * room for included attributes.
+   */
+  bool packedLeaves;
+
+  IndexOptions() : compressed(false), postingLists(false), packedLeaves(false) {}
+};
+
 /**
  * @brief The meta page, which holds metadata for Index file, is always first page of the btree index file and is cast
  * to the following structure to store or retrieve information from it.
@@ -157,6 +163,36 @@ struct IndexMetaInfo{
    * Page number of root page of the B+ Tree inside the file index file.
    */
   PageId rootPageNo;
+
+  /**
+   * Number of attributes included in the leaves of a covering index.
+   */
+  int numIncluded;
+
+  /**
+   * Attributes included in the leaves, in the order their bytes are stored.
+   */
+  IndexAttribute included[ MAXINCLUDEDATTRS ];
+
+  /**
+   * Number of attributes of a composite key, or 0 if the key is the single attribute above.
+   */
+  int numKeyComponents;
+
+  /**
+   * Attributes of a composite key, most significant first.
+   */
+  IndexAttribute keyComponents[ MAXKEYCOMPONENTS ];
+
+  /**
+   * True if the leaves are PostingLeafs (see IndexOptions::postingLists).
+   */
+  bool postingLists;
+
+  /**
+   * True if the leaves are PackedIntLeafs (see IndexOptions::packedLeaves).
+   */
+  bool packedLeaves;
 };
 
 /*
@@ -164,6 +200,7 @@ Each node is a page, so once we read the page in we just cast the pointer to the
 These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
 node they are. The level memeber of each non leaf structure seen below is set to 1 if the nodes 
 at this level are just above the leaf nodes. Otherwise set to 0.
+STRING and composite keys, whose length varies, are kept in PrefixKeyNodes (see prefix_key_node.h) instead.
 */
 
 /**
@@ -210,29 +247,6 @@ struct NonLeafNodeDouble{
   PageId pageNoArray[ DOUBLEARRAYNONLEAFSIZE + 1 ];
 };
 
-/**
- * @brief Structure for all non-leaf nodes when the key is of STRING type.
-*/
-struct NonLeafNodeString{
-  /**
-   * Level of the node in the tree.
-   */
-  int level;
-
-  int slot;
-
-
-  /**
-   * Stores keys.
-   */
-  char keyArray[ STRINGARRAYNONLEAFSIZE ][ STRINGSIZE ];
-
-  /**
-   * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
-   */
-  PageId pageNoArray[ STRINGARRAYNONLEAFSIZE + 1 ];
-};
-
 /**
  * @brief Structure for all leaf nodes when the key is of INTEGER type.
 */
@@ -284,29 +298,9 @@ struct LeafNodeDouble{
   PageId rightSibPageNo;
 };
 
-/**
- * @brief Structure for all leaf nodes when the key is of STRING type.
-*/
-struct LeafNodeString{
-  int level;
-
-  int slot;
-  /**
-   * Stores keys.
-   */
-  char keyArray[ STRINGARRAYLEAFSIZE ][ STRINGSIZE ];
-
-  /**
-   * Stores RecordIds.
-   */
-  RecordId ridArray[ STRINGARRAYLEAFSIZE ];
-
-  /**
-   * Page number of the leaf on the right side.
-   * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
-   */
-  PageId rightSibPageNo;
-};
+static_assert(sizeof(LeafNodeInt) <= Page::SIZE && sizeof(NonLeafNodeInt) <= Page::SIZE &&
+              sizeof(LeafNodeDouble) <= Page::SIZE && sizeof(NonLeafNodeDouble) <= Page::SIZE,
+              "B+Tree nodes must fit in a page, or writing their last fields corrupts the next frame.");
 
 /**
  * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
@@ -354,10 +348,133 @@ private:
   int   leafOccupancy;
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
+   * Number of keys in non-leaf node, depending upon the type of key.  Both are 0 for STRING keys, whose
+   * PrefixKeyNodes hold as many entries as fit.
    */
   int   nodeOccupancy;
 
+  /**
+   * Attributes of the base relation stored with every entry of a leaf, and their total width in bytes.
+   * Their bytes go into the tail of the leaf's ridArray, which leafOccupancy is lowered to leave free.
+   */
+  std::vector<IndexAttribute> included;
+  int   payloadWidth;
+
+  /**
+   * Encoding of a composite key; without components for a single-attribute index.
+   * Composite keys are kept as their keyCodec.width() encoded bytes in PrefixKeyNodes, like STRING keys,
+   * which store the leading components the keys of a node share only once.
+   */
+  KeyCodec keyCodec;
+
+  /**
+   * True if the leaves are PostingLeafs.  Their keys are byte strings for every key type, so the interior
+   * nodes are PrefixKeyNodes as for STRING keys.
+   */
+  bool  postingLists;
+
+  /**
+   * True if the leaves of an INTEGER index are PackedIntLeafs, under NonLeafNodeInts.
+   */
+  bool  packedLeaves;
+
+  /**
+   * Page number of the rightmost leaf, or Page::INVALID_NUMBER until it is looked up.
+   * Inserts of keys not below rightmostHighKey, such as increasing ids or timestamps, go
+   * straight to this leaf without descending from the root.
+   */
+  PageId  rightmostLeafNum;
+
+  /**
+   * Largest key in the rightmost leaf, as the bytes of the key; meaningless while rightmostEmpty.
+   */
+  std::string rightmostHighKey;
+
+  /**
+   * True if the rightmost leaf holds no entries, so any key may be appended to it.
+   */
+  bool  rightmostEmpty;
+
+  /**
+   * Sets leafOccupancy and nodeOccupancy for the key type and the included attributes.
+   */
+  void setOccupancy();
+
+  /**
+   * Returns a STRING key given by the caller as stored in nodes: the keyCodec.width() bytes of a composite
+   * key, or a char string up to its terminating zero, at most maxKeyLength() bytes of it.
+   */
+  std::string stringKey(const void* key) const;
+
+  /**
+   * Returns a key given by the caller as stored in PostingLeafs: the KeyCodec bytes of an INTEGER or DOUBLE
+   * key, or the stringKey() of a STRING one.
+   */
+  std::string postingKey(const void* key) const;
+
+  /**
+   * Returns the length of the longest STRING key the leaves hold; longer keys are cut to it.
+   */
+  std::size_t maxKeyLength() const;
+
+  /**
+   * Returns the STRING key of a record, as stringKey() does for the attribute.  The record may end before
+   * the zero terminating the attribute.
+   */
+  std::string recordStringKey(const RecordView& record) const;
+
+  /**
+   * Inserts an entry into a tree whose keys are handled as K and whose nodes are accessed through the
+   * Leaf and Interior classes of btree.cpp, trying appendRightmost() first.  A split of the root puts
+   * a new root over it.
+   */
+  template<class K, class Leaf, class Interior>
+  void insertKey(const K& key, const RecordId& rid, const char* payload);
+
+  /**
+   * Inserts an entry into the subtree under page pageNum, which is a leaf if isLeaf and the last page
+   * of its level if rightEdge.  Leaves are split in half, but for an append to the rightmost leaf,
+   * which stays full while a new leaf starts with just the entry; likewise for interior nodes.
+   * Returns true if the page was split, with the key and the new page to add to its parent in upKey
+   * and upPage.
+   */
+  template<class K, class Leaf, class Interior>
+  bool insertInto(const PageId pageNum, const bool isLeaf, const bool rightEdge, const K& key,
+    const RecordId& rid, const char* payload, K& upKey, PageId& upPage);
+
+  /**
+   * Inserts an entry into the rightmost leaf without a descent if its key is not below the leaf's
+   * largest key and the leaf has room.  Returns false, changing nothing, otherwise.
+   */
+  template<class K, class Leaf, class Interior>
+  bool appendRightmost(const K& key, const RecordId& rid, const char* payload);
+
+  /**
+   * Caches a leaf as the rightmost one, with the largest key it holds.
+   */
+  template<class K, class Leaf>
+  void cacheRightmostLeaf(const PageId leafNum, const Leaf& leaf);
+
+  /**
+   * Looks up the rightmost leaf by following the last child of every level, and caches it.
+   */
+  template<class K, class Leaf, class Interior>
+  void findRightmostLeaf();
+
+  /**
+   * Returns the leftmost leaf that can hold <key>, so a scan from there meets every key not below it.
+   */
+  template<class K, class Interior>
+  PageId findLeaf(const K& key);
+
+  /**
+   * Constructor the public ones delegate to.  A composite index passes its keyAttrs, with attrType STRING.
+   */
+  BTreeIndex(const std::string & relationName, std::string & outIndexName,
+    BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType,
+    const std::vector<IndexAttribute> & keyAttrs,
+    const std::vector<IndexAttribute> & includedAttrs, const IndexOptions & options);
+
 
   // MEMBERS SPECIFIC TO SCANNING
 
@@ -421,6 +538,56 @@ private:
    */
   Operator  highOp;
 
+  /**
+   * Position in the current leaf of the entry scanNext() returned last.
+   */
+  int   scannedEntry;
+
+  /**
+   * Copy of the key of that entry, as PrefixKeyNodes do not keep keys whole.
+   */
+  std::string scannedKey;
+
+  /**
+   * Positions in the current leaf of the entries within the scan range, found
+   * by filterLeaf().  nextEntry indexes into this.
+   */
+  std::vector<std::uint32_t> leafMatches;
+
+  /**
+   * For PostingLeafs, the RecordIds of the keys of the current leaf within the scan range, and the position
+   * of the key of each.  leafMatches then indexes into these.  For PackedIntLeafs, leafRids and leafKeys
+   * hold all the entries of the current leaf, unpacked.
+   */
+  std::vector<RecordId> leafRids;
+  std::vector<std::uint32_t> leafRidKeys;
+  std::vector<std::int32_t> leafKeys;
+
+  /**
+   * True if the current leaf holds keys past the high end of the scan range,
+   * so no later leaf can hold a match.
+   */
+  bool    leafPastRange;
+
+  /**
+   * Finds the entries of the current leaf within the scan range, filling
+   * leafMatches.  INTEGER and DOUBLE keys are compared with the FilterKernels,
+   * after a PackedIntLeaf is unpacked; the posting lists of matching
+   * PostingLeaf keys are read into leafRids.
+   */
+  void filterLeaf();
+
+  /**
+   * Moves the scan to the right sibling of the current leaf and filters it, unless the current leaf
+   * already passed the high end of the range.  Returns false, keeping the current leaf, at the end.
+   */
+  bool nextLeaf();
+
+  /**
+   * Returns the right sibling of the current leaf.
+   */
+  PageId leafRightSibling();
+
 
 public:
 
@@ -434,10 +601,70 @@ public:
    * @param bufMgrIn            Buffer Manager Instance
    * @param attrByteOffset      Offset of attribute, over which index is to be built, in the record
    * @param attrType            Datatype of attribute over which index is built
+   * @param options             How to build the index if it does not exist yet
    * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+   *                                    Also if options ask for packed leaves of a key that is not INTEGER.
    */
   BTreeIndex(const std::string & relationName, std::string & outIndexName,
-    BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType);
+    BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType,
+    const IndexOptions & options = IndexOptions());
+
+  /**
+   * BTreeIndex Constructor taking the attribute from the relation's schema.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn            Buffer Manager Instance
+   * @param schema              Layout of the relation's records
+   * @param attrName            Name of attribute over which index is to be built
+   * @param options             How to build the index if it does not exist yet
+   * @throws  BadSchemaException        If the schema has no such attribute.
+   * @throws  BadIndexInfoException     As for the other constructor.
+   */
+  BTreeIndex(const std::string & relationName, std::string & outIndexName,
+    BufMgr *bufMgrIn, const Schema & schema, const std::string & attrName,
+    const IndexOptions & options = IndexOptions());
+
+  /**
+   * BTreeIndex Constructor for a covering index.
+   * Leaves also store the bytes of the included attributes of every record, so scans can return them with
+   * scanPayload() instead of reading the base relation.  Each leaf holds fewer entries in exchange.
+   * If the index file already exists, the attributes it was built with are used.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn            Buffer Manager Instance
+   * @param attrByteOffset      Offset of attribute, over which index is to be built, in the record
+   * @param attrType            Datatype of attribute over which index is built
+   * @param includedAttrs       Attributes to store in the leaves, at most MAXINCLUDEDATTRS
+   * @param options             How to build the index if it does not exist yet
+   * @throws  BadIndexInfoException     If there are too many included attributes, or options ask for posting lists or
+   *                                    packed leaves, or as for the other constructors.
+   */
+  BTreeIndex(const std::string & relationName, std::string & outIndexName,
+    BufMgr *bufMgrIn, const int attrByteOffset, const Datatype attrType,
+    const std::vector<IndexAttribute> & includedAttrs,
+    const IndexOptions & options = IndexOptions());
+
+  /**
+   * BTreeIndex Constructor for a composite key.
+   * Keys are the attributes encoded with a KeyCodec, so one scan can serve equality on the leading attributes
+   * together with a range on the next one: startScan takes bounds of keyCodec width bytes, built with
+   * KeyCodec::lowBound() and highBound().  The index file is named after the relation and all the offsets.
+   *
+   * @param relationName        Name of file.
+   * @param outIndexName        Return the name of index file.
+   * @param bufMgrIn            Buffer Manager Instance
+   * @param keyAttrs            Attributes of the key, most significant first, at most MAXKEYCOMPONENTS
+   * @param includedAttrs       Attributes to store in the leaves, as for a covering index
+   * @param options             How to build the index if it does not exist yet
+   * @throws  BadIndexInfoException     If there are too many attributes, or included attributes with posting lists, or as for
+   *                                    the other constructors.
+   */
+  BTreeIndex(const std::string & relationName, std::string & outIndexName,
+    BufMgr *bufMgrIn, const std::vector<IndexAttribute> & keyAttrs,
+    const std::vector<IndexAttribute> & includedAttrs = std::vector<IndexAttribute>(),
+    const IndexOptions & options = IndexOptions());
 
 
   /**
@@ -462,52 +689,10 @@ public:
    * Make sure to unpin pages as soon as you can.
    * @param key     Key to insert, pointer to integer/double/char string
    * @param rid     Record ID of a record whose entry is getting inserted into the index.
+   * @param payload Bytes of the included attributes of the record, or NULL for zeros.
   **/
-  const void insertEntry(const void* key, const RecordId rid);
-
-  /* traverse the level and compare the key
-  * */
-  template<class T, class leaf, class node>
-  const PageId traversal(PageId &root_id, RIDKeyPair<T>* rid_pair);
-  
-  //insert data for leaf
-  const void insertLeafData(Page* currentPage, void *key, const RecordId &rid);
+  const void insertEntry(const void* key, const RecordId rid, const char* payload = NULL);
 
-
-  //insert data for node
-  const void insertNodeData(Page* currentPage, void *key, const PageId &pid);
-
-  /* insert leaf pages
-  *
-  * */
-   template<class T, class leaf, class node>
-  const void insertLeaf(PageId &firstLeaf_pageId, void *key, const RecordId &rid);
-  
-  /* insert leaf pages if full
-  *
-  * */
-  template<class T, class leaf, class node>
-  const void splitLeaf(PageId &firstLeaf_pageId, void *key, const RecordId rid);
-
-  /* Insert non leaf
-  *
-  * */
-  template<class T, class leaf, class node>
-  const void insertNonLeaf(PageId &first_nonleafId, int &level);
-
-  /* Look for target non leaf
-  *
-  * */
-   template<class T, class leaf, class node>
-  const PageId parentSearch(PageId &root_id, void* key, int &target_level);
-
-  /* Insert non leaf if full
-  *
-  * */
-  template<class T, class leaf, class node>
-  const void splitNon(PageId &first_nonleafId, PageId &newAlloc_pageId);
-
- 
   /**
    * Begin a filtered scan of the index.  For instance, if the method is called 
    * using ("a",GT,"d",LTE) then we should seek all entries with a value 
@@ -534,6 +719,35 @@ public:
   **/
   const void scanNext(RecordId& outRid);  // returned record id
 
+  /**
+   * Fetch the record id and the key of the next index entry that matches the scan, for an index-only scan.
+   * The key is read from the leaf, so queries needing nothing but the indexed attribute never read the base relation.
+   * @param outRid  RecordId of next record found that satisfies the scan criteria returned in this
+   * @param outKey  Key of that entry returned in this
+   * @throws BadIndexInfoException If the index is not over an INTEGER attribute.
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+  **/
+  const void scanNext(RecordId& outRid, int& outKey);
+
+  /**
+   * As above, for an index over a DOUBLE attribute.
+  **/
+  const void scanNext(RecordId& outRid, double& outKey);
+
+  /**
+   * As above, for an index over a STRING attribute or a composite key.  outKey views the bytes of the key,
+   * not null-terminated, and is valid until the next call to scanNext() or endScan().
+  **/
+  const void scanNext(RecordId& outRid, RecordView& outKey);
+
+  /**
+   * Returns the included attributes of the entry scanNext() returned last, one after the other in the order
+   * they were given, each as wide as its type (STRINGSIZE for STRING).  Valid until the next call to scanNext() or endScan().
+   * @throws ScanNotInitializedException If no scan has been initialized.
+  **/
+  RecordView scanPayload();
+
 
   /**
    * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
@@ -17,9 +17,10 @@ namespace badgerdb {
 
 int BufHashTbl::hash(const File* file, const PageId pageNo)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
+  // spread file ids apart so that the low page numbers of different files
+  // don't all land in the same buckets
+  std::uint64_t tmp = (std::uint64_t) file->id() * 2654435761u;
+  int value = (int) ((tmp + pageNo) % HTSIZE);
   return value;
 }
 
@@ -51,8 +52,8 @@ void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId fra
 
   hashBucket* tmpBuc = ht[index];
   while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
+    if (tmpBuc->fileId == file->id() && tmpBuc->pageNo == pageNo)
+  		throw HashAlreadyPresentException(file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
     tmpBuc = tmpBuc->next;
   }
 
@@ -61,6 +62,7 @@ void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId fra
   	throw HashTableException();
 
   tmpBuc->file = (File*) file;
+  tmpBuc->fileId = file->id();
   tmpBuc->pageNo = pageNo;
   tmpBuc->frameNo = frameNo;
   tmpBuc->next = ht[index];
@@ -72,7 +74,7 @@ void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo)
   int index = hash(file, pageNo);
   hashBucket* tmpBuc = ht[index];
   while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+    if (tmpBuc->fileId == file->id() && tmpBuc->pageNo == pageNo)
     {
       frameNo = tmpBuc->frameNo; // return frameNo by reference
       return;
@@ -91,7 +93,7 @@ void BufHashTbl::remove(const File* file, const PageId pageNo) {
 
   while (tmpBuc)
 	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+    if (tmpBuc->fileId == file->id() && tmpBuc->pageNo == pageNo)
 		{
       if(prevBuc) 
 				prevBuc->next = tmpBuc->next;
@@ -20,6 +20,11 @@ struct hashBucket {
 	 */
 	File *file;
 
+	/**
+	 * id of the file, used to match entries; File objects for the same file share it
+	 */
+	FileId fileId;
+
 	/**
 	 * page number within a file
 	 */
@@ -55,7 +60,7 @@ class BufHashTbl
   hashBucket**  ht;
 
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * returns hash value between 0 and HTSIZE-1 computed using file id and pageNo
 	 *
 	 * @param file   	File object
 	 * @param pageNo  Page number in the file
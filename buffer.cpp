@@ -4,7 +4,11 @@
  * @section LICENSE
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
+#include <sys/mman.h>
+#include <algorithm>
 #include <memory>
+#include <new>
+#include <vector>
 #include <iostream>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
@@ -21,7 +25,7 @@ namespace badgerdb {
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
+BufMgr::BufMgr(std::uint32_t bufs, const bool useHugePages)
 	: numBufs(bufs) {
 	bufDescTable = new BufDesc[bufs];
 
@@ -31,7 +35,19 @@ BufMgr::BufMgr(std::uint32_t bufs)
   	bufDescTable[i].valid = false;
   }
 
-  bufPool = new Page[bufs];
+  // mmap hands back page-aligned memory, which is what direct I/O needs and
+  // what operator new does not promise for over-aligned types.
+  void* poolMem = mmap(NULL, (std::size_t) bufs * Page::SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (poolMem == MAP_FAILED)
+    throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+  if (useHugePages)
+    madvise(poolMem, (std::size_t) bufs * Page::SIZE, MADV_HUGEPAGE);
+#endif
+  bufPool = static_cast<Page*>(poolMem);
+  for (FrameId i = 0; i < bufs; i++)
+    new (&bufPool[i]) Page();
 
   int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
   hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
@@ -52,14 +68,13 @@ BufMgr::~BufMgr() {
   }
 
   delete [] bufDescTable;
-  delete [] bufPool;
+  munmap(bufPool, (std::size_t) numBufs * Page::SIZE);
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+void BufMgr::allocBuf(FrameId & frame, std::unique_lock<std::recursive_mutex> & lock) 
 {
   // perform first part of clock algorithm to search for 
   // open buffer frame
-  // Assumes non-concurrent access to buffer manager
   std::uint32_t numScanned = 0;
   bool found = 0;
 
@@ -69,9 +84,16 @@ void BufMgr::allocBuf(FrameId & frame)
     advanceClock();
     numScanned++;
 
+    // frames reserved for I/O belong to another thread
+    if (bufDescTable[clockHand].ioPending)
+    {
+      continue;
+    }
+
     // if invalid, use frame
     if (! bufDescTable[clockHand].valid)
     {
+      found = true;
       break;
     }
 
@@ -82,8 +104,6 @@ void BufMgr::allocBuf(FrameId & frame)
       if (bufDescTable[clockHand].pinCnt == 0)
       {
         // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
         found = true;
         break;
       }
@@ -97,57 +117,223 @@ void BufMgr::allocBuf(FrameId & frame)
   }
   
   // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+  if (!found)
   {
     throw BufferExceededException();
   }
-  
-  // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+
+  const FrameId victim = clockHand;
+  BufDesc* tmpbuf = &bufDescTable[victim];
+  tmpbuf->ioPending = true;
+
+  // flush any existing changes to disk if necessary; the page stays in the
+  // hash table meanwhile, so that readers wait instead of reading it stale
+  if (tmpbuf->valid && tmpbuf->dirty)
   {
     bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    lock.unlock();
+    try
+    {
+      tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[victim]);
+    }
+    catch(...)
+    {
+      lock.lock();
+      tmpbuf->ioPending = false;
+      ioDone.notify_all();
+      throw;
+    }
+    lock.lock();
+  }
+
+  // remove previous entry from hash table
+  if (tmpbuf->valid)
+  {
+    hashTable->remove(tmpbuf->file, tmpbuf->pageNo);
   }
 
 	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+  tmpbuf->Clear();
+  tmpbuf->ioPending = true;
+  ioDone.notify_all();
 
   // return new frame number
-  frame = clockHand;
+  frame = victim;
 } // end allocBuf
 
+bool BufMgr::lookupFrame(const File* file, const PageId pageNo, FrameId & frame,
+                         std::unique_lock<std::recursive_mutex> & lock)
+{
+  while (true)
+  {
+    try
+    {
+      hashTable->lookup(file, pageNo, frame);
+    }
+    catch(const HashNotFoundException& e)
+    {
+      return false;
+    }
+    if (!bufDescTable[frame].ioPending)
+    {
+      return true;
+    }
+    // the frame may hold another page once the I/O is over, so look again
+    ioDone.wait(lock);
+  }
+}
+
 	
 void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 {
+  std::unique_lock<std::recursive_mutex> lock(latch);
   // check to see if it is already in the buffer pool
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
   FrameId frameNo = 0;
-	try
-	{
-  	hashTable->lookup(file, pageNo, frameNo);
+  if (!lookupFrame(file, pageNo, frameNo, lock))
+  {
+    // not in the buffer pool, must allocate a new page
+    FrameId freeFrame = 0;
+    allocBuf(freeFrame, lock);
 
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
+    // the latch may have been released, and the page read in by another thread
+    if (lookupFrame(file, pageNo, frameNo, lock))
+    {
+      bufDescTable[freeFrame].ioPending = false;
+      ioDone.notify_all();
+    }
+    else
+    {
+      // claim the frame for the page, then read it in without the latch
+      frameNo = freeFrame;
+      bufDescTable[frameNo].Set(file, pageNo);
+      hashTable->insert(file, pageNo, frameNo);
+      bufStats.diskreads++;
+      lock.unlock();
+      try
+      {
+        bufPool[frameNo] = file->readPage(pageNo);
+      }
+      catch(...)
+      {
+        lock.lock();
+        hashTable->remove(file, pageNo);
+        bufDescTable[frameNo].Clear();
+        ioDone.notify_all();
+        throw;
+      }
+      lock.lock();
+      bufDescTable[frameNo].ioPending = false;
+      ioDone.notify_all();
+      page = &bufPool[frameNo];
+      return;
+    }
   }
-  catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
-  {
-    // alloc a new frame
-    allocBuf(frameNo);
 
-    // read the page into the new frame
-    bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
+  // set the referenced bit; the page is written back through the File
+  // object pinning it, which may not be the one that read it in
+  bufDescTable[frameNo].refbit = true;
+  bufDescTable[frameNo].pinCnt++;
+  bufDescTable[frameNo].file = file;
+  page = &bufPool[frameNo];
+}
+
+
+void BufMgr::readPageRange(File* file, const PageId firstPageNo, const PageId count, Page** pages)
+{
+  std::unique_lock<std::recursive_mutex> lock(latch);
+  // frames pinned so far, and those of them claimed for the run being read
+  std::vector<FrameId> frames;
+  std::vector<FrameId> runFrames;
+  std::vector<Page*> runPages;
+
+  try
+  {
+    PageId i = 0;
+    while (i < count)
+    {
+      FrameId frameNo = 0;
+      if (lookupFrame(file, firstPageNo + i, frameNo, lock))
+      {
+        bufDescTable[frameNo].refbit = true;
+        bufDescTable[frameNo].pinCnt++;
+        bufDescTable[frameNo].file = file;
+        frames.push_back(frameNo);
+        pages[i] = &bufPool[frameNo];
+        i++;
+        continue;
+      }
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+      // claim frames for the run of missing pages starting here; a page
+      // found in the pool (read in by another thread while allocBuf had the
+      // latch released) ends the run early
+      const PageId runStart = i;
+      while (i < count)
+      {
+        try
+        {
+          hashTable->lookup(file, firstPageNo + i, frameNo);
+          break;
+        }
+        catch(const HashNotFoundException& e)
+        {
+        }
+        FrameId freeFrame = 0;
+        allocBuf(freeFrame, lock);
+        try
+        {
+          hashTable->lookup(file, firstPageNo + i, frameNo);
+          bufDescTable[freeFrame].ioPending = false;
+          ioDone.notify_all();
+          break;
+        }
+        catch(const HashNotFoundException& e)
+        {
+        }
+        bufDescTable[freeFrame].Set(file, firstPageNo + i);
+        hashTable->insert(file, firstPageNo + i, freeFrame);
+        frames.push_back(freeFrame);
+        runFrames.push_back(freeFrame);
+        runPages.push_back(&bufPool[freeFrame]);
+        pages[i] = &bufPool[freeFrame];
+        i++;
+      }
 
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+      // read the run with one request, without the latch, then publish it
+      // before waiting on anyone else's I/O
+      if (!runPages.empty())
+      {
+        bufStats.diskreads += runPages.size();
+        lock.unlock();
+        file->readPages(firstPageNo + runStart, runPages.size(), runPages.data());
+        lock.lock();
+        for (std::size_t j = 0; j < runFrames.size(); j++)
+          bufDescTable[runFrames[j]].ioPending = false;
+        ioDone.notify_all();
+        runFrames.clear();
+        runPages.clear();
+      }
+    }
+  }
+  catch(...)
+  {
+    // give back every frame pinned so far; frames whose read never completed
+    // are dropped from the pool altogether
+    if (!lock.owns_lock())
+      lock.lock();
+    for (std::size_t i = 0; i < frames.size(); i++)
+    {
+      BufDesc* tmpbuf = &bufDescTable[frames[i]];
+      if (std::find(runFrames.begin(), runFrames.end(), frames[i]) != runFrames.end())
+      {
+        hashTable->remove(file, tmpbuf->pageNo);
+        tmpbuf->Clear();
+      }
+      else
+        tmpbuf->pinCnt--;
+    }
+    ioDone.notify_all();
+    throw;
   }
 }
 
@@ -155,6 +341,7 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 void BufMgr::unPinPage(File* file, const PageId pageNo, 
 			     const bool dirty) 
 {
+  std::lock_guard<std::recursive_mutex> lock(latch);
   // lookup in hashtable
   FrameId frameNo = 0;
   hashTable->lookup(file, pageNo, frameNo);
@@ -167,17 +354,34 @@ void BufMgr::unPinPage(File* file, const PageId pageNo,
   	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
   }
   else bufDescTable[frameNo].pinCnt--;
+
+  // the last File object to unpin the page writes it back; one closed
+  // earlier may be gone
+  bufDescTable[frameNo].file = file;
 }
 
 void BufMgr::flushFile(const File* file) 
 {
+  std::unique_lock<std::recursive_mutex> lock(latch);
+  // pins are not tracked per File object, so while other objects have the
+  // file open a pinned page may be theirs; they write it back through
+  // themselves once they unpin it
+  const bool shared = FileRegistry::instance().users(file->id()) > 1;
   for (std::uint32_t i = 0; i < numBufs; i++)
 	{
   	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->valid == true && tmpbuf->file == file)
+		// let reads and write-backs done without the latch finish first
+		while (tmpbuf->ioPending)
+			ioDone.wait(lock);
+  	if(tmpbuf->valid == true && tmpbuf->file != NULL && tmpbuf->fileId == file->id())
 		{
 	    if (tmpbuf->pinCnt > 0)
+			{
+				// left in the pool for the object using it to flush
+				if (shared)
+					continue;
   			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+			}
 
 	    if (tmpbuf->dirty == true)
 			{
@@ -189,17 +393,39 @@ void BufMgr::flushFile(const File* file)
     	hashTable->remove(file,tmpbuf->pageNo);
     	tmpbuf->Clear();
   	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
+		else if (tmpbuf->valid == false && tmpbuf->file != NULL && tmpbuf->fileId == file->id())
   		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
   }
+
+  // group commit also makes a flush durable, rather than leave the last
+  // writes to the flusher
+  if (file->durability() != NO_SYNC)
+    file->sync();
+}
+
+bool BufMgr::isResident(const File* file, const PageId pageNo)
+{
+  std::lock_guard<std::recursive_mutex> lock(latch);
+  FrameId frameNo = 0;
+  try
+  {
+    hashTable->lookup(file, pageNo, frameNo);
+    return true;
+  }
+  catch(const HashNotFoundException& e)
+  {
+    return false;
+  }
 }
 
 void BufMgr::disposePage(File* file, const PageId pageNo) 
 {
+  std::unique_lock<std::recursive_mutex> lock(latch);
 	//Deallocate from file altogether
   //See if it is in the buffer pool
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  if (!lookupFrame(file, pageNo, frameNo, lock))
+    throw HashNotFoundException(file->filename(), pageNo);
 
 	// clear the page
 	bufDescTable[frameNo].Clear();
@@ -213,18 +439,34 @@ void BufMgr::disposePage(File* file, const PageId pageNo)
 
 void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
 {
+  std::unique_lock<std::recursive_mutex> lock(latch);
   FrameId frameNo;
 
   // alloc a new frame
-  allocBuf(frameNo);
+  allocBuf(frameNo, lock);
 
-  // allocate a new page in the file
-	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
+  // allocate a new page in the file, without the latch; the frame stays
+  // reserved meanwhile
+  lock.unlock();
+  try
+  {
+    std::lock_guard<std::mutex> allocLock(allocLatch);
+    bufPool[frameNo] = file->allocatePage(pageNo);
+  }
+  catch(...)
+  {
+    lock.lock();
+    bufDescTable[frameNo].Clear();
+    ioDone.notify_all();
+    throw;
+  }
+  lock.lock();
   page = &bufPool[frameNo];
 
   // set up the entry properly
   bufDescTable[frameNo].Set(file, pageNo);
+  bufDescTable[frameNo].ioPending = false;
+  ioDone.notify_all();
 
   // insert in the hash table
   hashTable->insert(file, pageNo, frameNo);
@@ -232,6 +474,7 @@ void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page)
 
 void BufMgr::printSelf(void) 
 {
+  std::lock_guard<std::recursive_mutex> lock(latch);
   BufDesc* tmpbuf;
 	int validFrames = 0;
   
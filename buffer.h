@@ -7,9 +7,11 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
 #include "file.h"
 #include "bufHashTbl.h"
-#include <iostream>
 
 namespace badgerdb {
 
@@ -27,10 +29,18 @@ class BufDesc {
 
  private:
 	/**
-   * Pointer to file to which corresponding frame is assigned
+   * Pointer to file to which corresponding frame is assigned: the File object
+   * that last pinned or unpinned the page.  Objects sharing a FileId flush
+   * the file before closing, which drops its unpinned pages, so an unpinned
+   * page never points at a closed object.
 	 */
   File* file;
 
+	/**
+   * Id of file to which corresponding frame is assigned
+	 */
+  FileId fileId;
+
 	/**
    * Page within file to which corresponding frame is assigned
 	 */
@@ -61,6 +71,13 @@ class BufDesc {
 	 */
   bool refbit;
 
+	/**
+   * True while the frame is reserved for disk I/O done without the latch: its page is being read in or written
+   * back, or a page is being allocated into it.  The clock passes such frames by, and threads that look up
+   * the page wait for the I/O to finish.
+	 */
+  bool ioPending;
+
 	/**
    * Initialize buffer frame for a new user
 	 */
@@ -68,10 +85,12 @@ class BufDesc {
 	{
     pinCnt = 0;
 		file = NULL;
+		fileId = 0;
 		pageNo = Page::INVALID_NUMBER;
     dirty = false;
     refbit = false;
 		valid = false;
+		ioPending = false;
   };
 
 	/**
@@ -84,6 +103,7 @@ class BufDesc {
   void Set(File* filePtr, PageId pageNum)
 	{ 
 		file = filePtr;
+		fileId = filePtr->id();
     pageNo = pageNum;
     pinCnt = 1;
     dirty = false;
@@ -157,10 +177,31 @@ struct BufStats
 
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* Every public method holds the buffer manager's latch while it runs, so one buffer manager may be shared by several
+* threads.  The disk I/O of readPage(), readPageRange() and allocPage(), and the write-back of the page a frame
+* held before, happen without it: a frame is reserved under the latch, marked ioPending, and published once its
+* I/O is done, so threads that hit other pages are not held up by a slow disk.  Pages in frames are not latched;
+* threads must not modify a page another thread has pinned.
 */
 class BufMgr 
 {
  private:
+	/**
+   * Serializes all operations on the buffer pool.  Recursive since some operations are built on others.
+	 */
+  std::recursive_mutex latch;
+
+	/**
+   * Signalled whenever a frame's I/O finishes and its ioPending flag is cleared.
+	 */
+  std::condition_variable_any ioDone;
+
+	/**
+   * Serializes allocatePage() calls made without the latch, since each updates the file header.
+	 */
+  std::mutex allocLatch;
+
 	/**
    * Current position of clockhand in our buffer pool
 	 */
@@ -187,12 +228,27 @@ class BufMgr
   BufStats bufStats;
 
 	/**
-	 * Allocate a free frame.  
+	 * Allocate a free frame.  The frame is returned cleared and reserved with ioPending set; the caller either
+	 * assigns it a page or clears it again, and notifies ioDone when the frame's I/O is over.  A dirty page in the
+	 * frame is written back with the latch released, so the caller must look its page up again afterwards.
 	 *
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param lock			Lock of the latch, held by the caller
 	 * @throws BufferExceededException If no such buffer is found which can be allocated
 	 */
-  void allocBuf(FrameId & frame);
+  void allocBuf(FrameId & frame, std::unique_lock<std::recursive_mutex> & lock);
+
+	/**
+	 * Looks up the frame of a page, waiting for I/O in progress on it to finish.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param frame   	Frame of the page returned via this variable
+	 * @param lock			Lock of the latch, held by the caller
+	 * @return  False if the page is not in the buffer pool
+	 */
+  bool lookupFrame(const File* file, const PageId pageNo, FrameId & frame,
+                   std::unique_lock<std::recursive_mutex> & lock);
 
 	/**
    * Advance clock to next frame in the buffer pool
@@ -205,14 +261,18 @@ class BufMgr
 
  public:
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Actual buffer pool from which frames are allocated.  Frames are aligned to
+   * Page::IO_ALIGNMENT so that files opened for direct I/O can use them.
 	 */
   Page* bufPool;
 
 	/**
    * Constructor of BufMgr class
+	 *
+	 * @param bufs						Number of frames in the buffer pool
+	 * @param useHugePages		Ask the operating system to back the pool with huge pages
 	 */
-  BufMgr(std::uint32_t bufs);
+  BufMgr(std::uint32_t bufs, const bool useHugePages = false);
 	
 	/**
    * Destructor of BufMgr class
@@ -230,6 +290,30 @@ class BufMgr
 	 */
   void readPage(File* file, const PageId PageNo, Page*& page);
 
+	/**
+	 * Reads <count> consecutive pages of the file, starting at firstPageNo, into frames and returns pointers to them
+	 * in <pages>.  Pages already in the buffer pool are reused; each run of consecutive pages that is not is read
+	 * from disk into its frames with a single vectored read.  Every returned page is pinned and must be unpinned
+	 * separately.
+	 *
+	 * @param file   				File object
+	 * @param firstPageNo		Page number of the first page to be read
+	 * @param count					Number of pages to read
+	 * @param pages					Array of at least <count> page pointers.  Pointers to the frames holding the pages are returned in it.
+	 * @throws BufferExceededException If there are not enough unpinned frames to hold the pages
+	 * @throws InvalidPageException If any page in the range doesn't exist in the file
+	 */
+  void readPageRange(File* file, const PageId firstPageNo, const PageId count, Page** pages);
+
+	/**
+	 * Returns true if the given page of the file is in the buffer pool.  The page is neither pinned nor referenced.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file
+	 * @return  Whether the page is in a frame of the buffer pool
+	 */
+  bool isResident(const File* file, const PageId PageNo);
+
 	/**
 	 * Unpin a page from memory since it is no longer required for it to remain in memory.
 	 *
@@ -254,9 +338,11 @@ class BufMgr
 	 * Writes out all dirty pages of the file to disk.
 	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
 	 * Otherwise Error returned.
+	 * While other File objects have the same file open, pinned frames may be in use through them; those are left in the pool instead.
+	 * Unless the file's durability mode is NO_SYNC, writes to it still outstanding are also forced to stable storage.
 	 *
 	 * @param file   	File object
-   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool and no other File object has the file open
    * @throws BadBufferException If any frame allocated to the file is found to be invalid
 	 */
   void flushFile(const File* file);
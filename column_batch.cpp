@@ -0,0 +1,90 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "column_batch.h"
+
+#include <cstring>
+
+namespace badgerdb {
+
+const std::size_t ColumnBatch::DEFAULT_CAPACITY;
+
+ColumnBatch::ColumnBatch(const std::size_t capacity)
+    : capacity_(capacity) {
+  rids_.reserve(capacity_);
+  selection_.reserve(capacity_);
+}
+
+std::size_t ColumnBatch::addColumn(const std::uint16_t offset,
+                                   const Datatype type,
+                                   const std::uint16_t width) {
+  BatchColumn col;
+  col.offset = offset;
+  col.type = type;
+  switch (type) {
+    case INTEGER:
+      col.width = sizeof(std::int32_t);
+      col.ints.reserve(capacity_);
+      break;
+    case DOUBLE:
+      col.width = sizeof(double);
+      col.doubles.reserve(capacity_);
+      break;
+    case STRING:
+      col.width = width;
+      col.chars.reserve(capacity_ * width);
+      break;
+  }
+  columns_.push_back(col);
+  return columns_.size() - 1;
+}
+
+void ColumnBatch::clear() {
+  for (std::size_t i = 0; i < columns_.size(); ++i) {
+    columns_[i].ints.clear();
+    columns_[i].doubles.clear();
+    columns_[i].chars.clear();
+  }
+  rids_.clear();
+  selection_.clear();
+}
+
+void ColumnBatch::appendRow(const RecordId& rid, const char* const* fields) {
+  selection_.push_back(rids_.size());
+  rids_.push_back(rid);
+  for (std::size_t i = 0; i < columns_.size(); ++i) {
+    BatchColumn& col = columns_[i];
+    const char* field = fields[i];
+    switch (col.type) {
+      case INTEGER: {
+        std::int32_t value = 0;
+        if (field != NULL) {
+          memcpy(&value, field, sizeof(value));
+        }
+        col.ints.push_back(value);
+        break;
+      }
+      case DOUBLE: {
+        double value = 0;
+        if (field != NULL) {
+          memcpy(&value, field, sizeof(value));
+        }
+        col.doubles.push_back(value);
+        break;
+      }
+      case STRING:
+        if (field != NULL) {
+          col.chars.insert(col.chars.end(), field, field + col.width);
+        } else {
+          col.chars.resize(col.chars.size() + col.width, '\0');
+        }
+        break;
+    }
+  }
+}
+
+}
@@ -0,0 +1,194 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "tuple_layout.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Values of one attribute for the rows of a ColumnBatch.
+ *
+ * Only the vector matching <type> is used: ints for INTEGER, doubles for
+ * DOUBLE and chars for STRING, where row r takes bytes [r * width, (r + 1) *
+ * width).
+ */
+struct BatchColumn {
+  /**
+   * Byte offset of the attribute in records.
+   */
+  std::uint16_t offset;
+
+  /**
+   * Datatype of the attribute.
+   */
+  Datatype type;
+
+  /**
+   * Width of the attribute in bytes.
+   */
+  std::uint16_t width;
+
+  std::vector<std::int32_t> ints;
+  std::vector<double> doubles;
+  std::vector<char> chars;
+};
+
+/**
+ * @brief Up to capacity() records of a scan, decoded into one array per
+ *        attribute.
+ *
+ * The caller declares the attributes it needs with addColumn() and passes
+ * the batch to FileScan::nextBatch(), which fills the arrays row by row.
+ * Rows that are not of interest are not removed; instead the selection
+ * vector lists the rows still selected, in increasing order, so filters can
+ * narrow it without moving values around.  Records too short for an
+ * attribute read as zeros.
+ *
+ * @warning This class is not threadsafe.
+ */
+class ColumnBatch {
+ public:
+  /**
+   * Default number of rows in a batch.
+   */
+  static const std::size_t DEFAULT_CAPACITY = 1024;
+
+  /**
+   * Constructs a batch without columns.
+   *
+   * @param capacity  Largest number of rows in the batch.
+   */
+  explicit ColumnBatch(const std::size_t capacity = DEFAULT_CAPACITY);
+
+  /**
+   * Adds an attribute to decode.
+   *
+   * @param offset  Byte offset of the attribute in records.
+   * @param type    Datatype of the attribute.
+   * @param width   Width in bytes of a STRING attribute; ignored otherwise.
+   * @return  Number of the column, starting at 0.
+   */
+  std::size_t addColumn(const std::uint16_t offset, const Datatype type,
+                        const std::uint16_t width = 0);
+
+  /**
+   * Adds an attribute of a Schema to decode.
+   *
+   * @param field   Attribute, e.g. schema.field("d").
+   * @return  Number of the column, starting at 0.
+   */
+  std::size_t addColumn(const FieldInfo& field) {
+    return addColumn(field.offset, field.type, field.width);
+  }
+
+  /**
+   * Returns the number of columns.
+   */
+  std::size_t numColumns() const { return columns_.size(); }
+
+  /**
+   * Returns a column.
+   *
+   * @param column  Number of the column.
+   */
+  const BatchColumn& column(const std::size_t column) const {
+    return columns_[column];
+  }
+
+  /**
+   * Returns the values of an INTEGER column, one per row.
+   */
+  const std::int32_t* intColumn(const std::size_t column) const {
+    return columns_[column].ints.data();
+  }
+
+  /**
+   * Returns the values of a DOUBLE column, one per row.
+   */
+  const double* doubleColumn(const std::size_t column) const {
+    return columns_[column].doubles.data();
+  }
+
+  /**
+   * Returns the value of a STRING column in the given row, of
+   * column(column).width bytes and not null-terminated.
+   */
+  const char* charValue(const std::size_t column, const std::size_t row) const {
+    const BatchColumn& col = columns_[column];
+    return col.chars.data() + row * col.width;
+  }
+
+  /**
+   * Returns the IDs of the records in the batch, one per row.
+   */
+  const RecordId* rids() const { return rids_.data(); }
+
+  /**
+   * Returns the number of rows in the batch, selected or not.
+   */
+  std::size_t size() const { return rids_.size(); }
+
+  /**
+   * Returns the largest number of rows in the batch.
+   */
+  std::size_t capacity() const { return capacity_; }
+
+  /**
+   * Returns true if the batch holds as many rows as it can.
+   */
+  bool full() const { return rids_.size() == capacity_; }
+
+  /**
+   * Returns the selection vector: the numbers of the selected rows, in
+   * increasing order.  Filters may shrink it in place.
+   */
+  std::vector<std::uint32_t>& selection() { return selection_; }
+  const std::vector<std::uint32_t>& selection() const { return selection_; }
+
+  /**
+   * Removes all rows, keeping the columns.
+   */
+  void clear();
+
+  /**
+   * Appends a selected row, filling each column from the record's bytes.
+   *
+   * @param rid     ID of the record.
+   * @param fields  Pointer to the value of every column in the record, or
+   *                NULL if the record is too short for it.
+   */
+  void appendRow(const RecordId& rid, const char* const* fields);
+
+ private:
+  /**
+   * Largest number of rows in the batch.
+   */
+  std::size_t capacity_;
+
+  /**
+   * Attributes being decoded.
+   */
+  std::vector<BatchColumn> columns_;
+
+  /**
+   * ID of the record in every row.
+   */
+  std::vector<RecordId> rids_;
+
+  /**
+   * Numbers of the selected rows.
+   */
+  std::vector<std::uint32_t> selection_;
+};
+
+}
@@ -0,0 +1,41 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a schema does not have a requested
+ *        field, or the field is not of the requested type.
+ */
+class BadSchemaException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a bad schema exception.
+   *
+   * @param reason  What is wrong with the request.
+   */
+  explicit BadSchemaException(const std::string& reason);
+
+  /**
+   * Returns what is wrong with the request.
+   */
+  virtual const std::string& reason() const { return reason_; }
+
+ protected:
+  /**
+   * What is wrong with the request.
+   */
+  const std::string reason_;
+};
+
+}
@@ -0,0 +1,29 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "file_io_exception.h"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+FileIOException::FileIOException(const std::string& name,
+                                 const off_t position, const int error)
+    : BadgerDbException(""), filename_(name), error_(error) {
+  std::stringstream ss;
+  if (error_ == 0) {
+    ss << "Unexpected end of file: " << filename_ << " offset: " << position;
+  } else {
+    ss << "I/O error in file: " << filename_ << " offset: " << position
+       << ": " << strerror(error_);
+  }
+  message_.assign(ss.str());
+}
+
+}
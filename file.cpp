@@ -7,24 +7,322 @@
 
 #include "file.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
+#include <climits>
 #include <cstdio>
+#include <cstring>
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <utility>
 
+#include "exceptions/bad_file_format_exception.h"
 #include "exceptions/file_exists_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
 #include "file_iterator.h"
 #include "page.h"
+#include "page_compressor.h"
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
-File::CountMap File::open_counts_;
+namespace {
+
+/**
+ * Reads exactly <length> bytes at <position>, retrying short and interrupted
+ * reads.
+ *
+ * @throws  FileIOException   If a read fails or the file ends first.
+ */
+void readFully(const int fd, const std::string& filename, void* buffer,
+               const std::size_t length, const off_t position) {
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t n = pread(fd, static_cast<char*>(buffer) + done,
+                            length - done, position + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      throw FileIOException(filename, position + done, n < 0 ? errno : 0);
+    }
+    done += n;
+  }
+}
+
+/**
+ * Writes exactly <length> bytes at <position>, retrying short and interrupted
+ * writes.
+ *
+ * @throws  FileIOException   If a write fails.
+ */
+void writeFully(const int fd, const std::string& filename, const void* buffer,
+                const std::size_t length, const off_t position) {
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t n = pwrite(fd, static_cast<const char*>(buffer) + done,
+                             length - done, position + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      // A write that makes no progress is as good as out of space.
+      throw FileIOException(filename, position + done, n < 0 ? errno : ENOSPC);
+    }
+    done += n;
+  }
+}
+
+}
+
+alignas(Page::IO_ALIGNMENT) thread_local char File::direct_io_buffer_[Page::SIZE];
+
+FileRegistry& FileRegistry::instance() {
+  static FileRegistry registry;
+  return registry;
+}
+
+FileSyncState::FileSyncState()
+    : durability(NO_SYNC), group_commit_bytes(0), group_commit_interval(0),
+      written(0), synced(0), unsynced_bytes(0), syncing(false),
+      stopping(false), close_error(0) {
+}
+
+void FileSyncState::sync(const int fd, const std::string& filename) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (close_error != 0) {
+    // Writes made before the file was last closed may be lost.
+    const int error = close_error;
+    close_error = 0;
+    throw FileIOException(filename, 0, error);
+  }
+  const std::uint64_t target = written;
+  while (synced < target) {
+    if (syncing) {
+      // Someone else is syncing; it may already cover our writes.
+      sync_done.wait(lock);
+      continue;
+    }
+    // Lead a sync covering everything written so far, including writes of
+    // the threads queued behind us.
+    syncing = true;
+    const std::uint64_t covered = written;
+    unsynced_bytes = 0;
+    lock.unlock();
+#ifdef __APPLE__
+    const int result = fsync(fd);
+#else
+    const int result = fdatasync(fd);
+#endif
+    const int error = errno;
+    lock.lock();
+    syncing = false;
+    sync_done.notify_all();
+    if (result != 0) {
+      // Let the next caller try again.
+      throw FileIOException(filename, 0, error);
+    }
+    synced = covered;
+  }
+}
+
+CompressedPageMap::CompressedPageMap()
+    : data_end(Page::SIZE), dirty(false) {
+}
+
+std::size_t CompressedPageMap::save(const int fd, const std::string& filename) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!dirty) {
+    return 0;
+  }
+  // The map goes after the last page, not over the one the header points
+  // at, and must be on disk before the header is pointed at it.
+  const std::size_t map_size = extents.size() * sizeof(Extent);
+  writeFully(fd, filename, extents.data(), map_size, data_end);
+  if (fdatasync(fd) != 0) {
+    throw FileIOException(filename, data_end, errno);
+  }
+  const CompressedBlobHeader header = {
+      COMPRESSED_BLOB_MAGIC, static_cast<std::uint32_t>(extents.size()),
+      data_end};
+  writeFully(fd, filename, &header, sizeof(header), sizeof(FileHeader));
+  data_end += map_size;
+  dirty = false;
+  return map_size + sizeof(header);
+}
+
+FileId FileRegistry::acquire(const std::string& filename,
+                             const std::function<int()>& opener, int& fd,
+                             std::shared_ptr<FileSyncState>& sync) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // A file still being closed must be on disk before it is read again.
+  closed_.wait(lock, [this, &filename]() {
+    return closing_.find(filename) == closing_.end();
+  });
+  std::unordered_map<std::string, FileId>::const_iterator it =
+      ids_.find(filename);
+  if (it != ids_.end()) {
+    Entry& entry = entries_[it->second];
+    ++entry.count;
+    fd = entry.fd;
+    sync = entry.sync;
+    return it->second;
+  }
+
+  fd = opener();
+  const FileId file_id = next_id_++;
+  Entry& entry = entries_[file_id];
+  entry.filename = filename;
+  entry.fd = fd;
+  entry.count = 1;
+  entry.sync.reset(new FileSyncState());
+  std::unordered_map<std::string, int>::iterator error =
+      close_errors_.find(filename);
+  if (error != close_errors_.end()) {
+    entry.sync->close_error = error->second;
+    close_errors_.erase(error);
+  }
+  sync = entry.sync;
+  ids_[filename] = file_id;
+  return file_id;
+}
+
+void FileRegistry::release(const FileId file_id) {
+  Entry entry;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unordered_map<FileId, Entry>::iterator it = entries_.find(file_id);
+    assert(it != entries_.end() && it->second.count > 0);
+    if (--it->second.count > 0) {
+      return;
+    }
+    // The slow part of closing runs unlocked; opens of this file wait for it
+    // in acquire().
+    entry = std::move(it->second);
+    entries_.erase(it);
+    ids_.erase(entry.filename);
+    closing_.insert(entry.filename);
+  }
+
+  if (entry.flusher.joinable()) {
+    {
+      std::lock_guard<std::mutex> sync_lock(entry.sync->mutex);
+      entry.sync->stopping = true;
+    }
+    entry.sync->flusher_wakeup.notify_all();
+    entry.flusher.join();
+  }
+  // Files are closed from destructors, which must not throw; the errors are
+  // kept for the next sync of the file instead.
+  int error = 0;
+  if (entry.page_map) {
+    try {
+      if (entry.page_map->save(entry.fd, entry.filename) > 0) {
+        std::lock_guard<std::mutex> sync_lock(entry.sync->mutex);
+        ++entry.sync->written;
+      }
+    } catch (const FileIOException& e) {
+      error = e.error() != 0 ? e.error() : EIO;
+    }
+    entry.page_map.reset();
+  }
+  bool sync_now;
+  {
+    std::lock_guard<std::mutex> sync_lock(entry.sync->mutex);
+    sync_now = entry.sync->durability != NO_SYNC &&
+               entry.sync->synced < entry.sync->written;
+    // An error of the previous close that no sync has reported still stands.
+    if (error == 0) {
+      error = entry.sync->close_error;
+    }
+    entry.sync->close_error = 0;
+  }
+  if (sync_now) {
+    try {
+      entry.sync->sync(entry.fd, entry.filename);
+    } catch (const FileIOException& e) {
+      if (error == 0) {
+        error = e.error() != 0 ? e.error() : EIO;
+      }
+    }
+  }
+  ::close(entry.fd);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error != 0) {
+      close_errors_[entry.filename] = error;
+    }
+    closing_.erase(entry.filename);
+  }
+  closed_.notify_all();
+}
+
+bool FileRegistry::isOpen(const std::string& filename) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return ids_.find(filename) != ids_.end() ||
+         closing_.find(filename) != closing_.end();
+}
+
+int FileRegistry::users(const FileId file_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unordered_map<FileId, Entry>::const_iterator it = entries_.find(file_id);
+  return it == entries_.end() ? 0 : it->second.count;
+}
+
+void FileRegistry::startFlusher(const FileId file_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry& entry = entries_[file_id];
+  if (!entry.flusher.joinable()) {
+    entry.flusher = std::thread(&FileRegistry::runFlusher, entry.fd,
+                                entry.filename, entry.sync);
+  }
+}
+
+void FileRegistry::runFlusher(const int fd, const std::string filename,
+                              const std::shared_ptr<FileSyncState> sync) {
+  std::unique_lock<std::mutex> lock(sync->mutex);
+  while (!sync->stopping) {
+    if (sync->durability != GROUP_COMMIT || sync->unsynced_bytes == 0) {
+      sync->flusher_wakeup.wait(lock);
+      continue;
+    }
+    const std::chrono::steady_clock::time_point deadline =
+        sync->first_unsynced + sync->group_commit_interval;
+    if (std::chrono::steady_clock::now() < deadline) {
+      sync->flusher_wakeup.wait_until(lock, deadline);
+      continue;
+    }
+    lock.unlock();
+    try {
+      sync->sync(fd, filename);
+    } catch (const FileIOException&) {
+      // Nobody to report to; the next explicit sync will fail as well.
+    }
+    lock.lock();
+  }
+}
+
+std::shared_ptr<CompressedPageMap> FileRegistry::pageMap(const FileId file_id,
+    const std::function<std::shared_ptr<CompressedPageMap>()>& loader) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry& entry = entries_[file_id];
+  if (!entry.page_map) {
+    entry.page_map = loader();
+  }
+  return entry.page_map;
+}
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -40,7 +338,7 @@ bool File::isOpen(const std::string& filename) {
   if (!exists(filename)) {
     return false;
   }
-  return open_counts_.find(filename) != open_counts_.end();
+  return FileRegistry::instance().isOpen(filename);
 }
 
 bool File::exists(const std::string& filename) {
@@ -64,85 +362,312 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
-  openIfNeeded(create_new);
+PageId File::getNumPages() {
+  const FileHeader& header = readHeader();
+  return header.num_pages;
+}
+
+void File::readPages(const PageId first_page_number, const PageId count,
+                     Page* pages) const {
+  std::vector<Page*> page_ptrs(count);
+  for (PageId i = 0; i < count; ++i) {
+    page_ptrs[i] = &pages[i];
+  }
+  readPages(first_page_number, count, page_ptrs.data());
+}
+
+File::File(const std::string& name, const bool create_new,
+           const bool direct_io)
+    : filename_(name), file_id_(0), fd_(-1), direct_io_(false),
+      header_size_(sizeof(FileHeader)) {
+  openIfNeeded(create_new, direct_io);
 
   if (create_new) {
+    // Direct I/O needs every page on a block boundary, so give the header a
+    // page of its own.
+    if (direct_io) {
+      header_size_ = Page::SIZE;
+    }
     // File starts with 1 page (the header).
-    FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+    FileHeader header = {FILE_MAGIC, FILE_FORMAT_VERSION,
+                         1 /* num_pages */, 0 /* first_used_page */,
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         0 /* flags */};
     writeHeader(header);
   }
 }
 
-void File::openIfNeeded(const bool create_new) {
-  if (open_counts_.find(filename_) != open_counts_.end()) {	
-    //exists an entry already
-    ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
-  } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
-    const bool already_exists = exists(filename_);
+void File::openIfNeeded(const bool create_new, const bool direct_io) {
+  const std::string& filename = filename_;
+  // Only runs if no other File object has the file open.
+  std::function<int()> opener = [&filename, create_new, direct_io]() {
+    int flags = O_RDWR;
+    const bool already_exists = exists(filename);
     if (create_new) {
       // Error if we try to overwrite an existing file.
       if (already_exists) {
-        throw FileExistsException(filename_);
+        throw FileExistsException(filename);
       }
       // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
+      flags = flags | O_CREAT | O_TRUNC;
     } else {
       // Error if we try to open a file that doesn't exist.
       if (!already_exists) {
-        throw FileNotFoundException(filename_);
+        throw FileNotFoundException(filename);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
-    open_counts_[filename_] = 1;
+    int fd = -1;
+#ifdef O_DIRECT
+    if (direct_io) {
+      fd = ::open(filename.c_str(), flags | O_DIRECT, 0644);
+      struct stat file_stat;
+      if (fd >= 0 && !create_new && fstat(fd, &file_stat) == 0 &&
+          file_stat.st_size % Page::SIZE != 0) {
+        // Pages of the original layout are not block aligned, so this file
+        // cannot be accessed directly.
+        ::close(fd);
+        fd = -1;
+      }
+      if (fd >= 0 && !create_new &&
+          pread(fd, direct_io_buffer_, Page::SIZE, 0) == Page::SIZE) {
+        // Neither are the pages of compressed blob files.
+        FileHeader header;
+        memcpy(&header, direct_io_buffer_, sizeof(FileHeader));
+        if (header.flags & FILE_COMPRESSED) {
+          ::close(fd);
+          fd = -1;
+        }
+      }
+    }
+#endif
+    if (fd < 0) {
+      // Either direct I/O was not asked for or could not be used.
+      fd = ::open(filename.c_str(), flags, 0644);
+    }
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+    if (direct_io) {
+      fcntl(fd, F_NOCACHE, 1);
+    }
+#endif
+    if (fd < 0) {
+      throw FileNotFoundException(filename);
+    }
+    return fd;
+  };
+  file_id_ = FileRegistry::instance().acquire(filename_, opener, fd_, sync_);
+
+  // Files laid out for direct I/O are a whole number of pages long; files with
+  // the original layout always have the odd-sized header in front.
+  struct stat file_stat;
+  if (fstat(fd_, &file_stat) != 0) {
+    file_stat.st_size = 0;
+  }
+  header_size_ = sizeof(FileHeader);
+  if (file_stat.st_size > 0 && file_stat.st_size % Page::SIZE == 0) {
+    header_size_ = Page::SIZE;
+  }
+
+  direct_io_ = false;
+#ifdef O_DIRECT
+  direct_io_ = (fcntl(fd_, F_GETFL) & O_DIRECT) != 0;
+#endif
+
+  if (!create_new) {
+    // Pages of any other format would be misread, and unversioned files start
+    // with a shorter header.
+    bool current_format =
+        file_stat.st_size >= static_cast<off_t>(sizeof(FileHeader));
+    if (current_format) {
+      const FileHeader header = readHeader();
+      current_format = header.magic == FILE_MAGIC &&
+                       header.version == FILE_FORMAT_VERSION;
+    }
+    if (!current_format) {
+      close();
+      throw BadFileFormatException(filename_);
+    }
   }
 }
 
 void File::close() {
-	if(open_counts_[filename_] > 0)
-  	--open_counts_[filename_];
-
-  stream_.reset();
-	assert(open_counts_[filename_] >= 0);
-
-  if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
-    open_counts_.erase(filename_);
+  if (fd_ < 0) {
+    return;
   }
+  FileRegistry::instance().release(file_id_);
+  sync_.reset();
+  fd_ = -1;
 }
 
 FileHeader File::readHeader() const {
   FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+  readAt(0 /* pos */, &header, sizeof(FileHeader));
   return header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
-  stream_->flush();
+  if (header_size_ == Page::SIZE) {
+    // The header owns the first page; pad it out so the file stays a whole
+    // number of pages long.
+    char block[Page::SIZE] = {0};
+    memcpy(block, &header, sizeof(FileHeader));
+    writeAt(0 /* pos */, block, Page::SIZE);
+  } else {
+    writeAt(0 /* pos */, &header, sizeof(FileHeader));
+  }
+}
+
+void File::setDurability(const Durability durability,
+                         const std::size_t group_commit_bytes,
+                         const unsigned int group_commit_millis) {
+  {
+    std::lock_guard<std::mutex> lock(sync_->mutex);
+    sync_->durability = durability;
+    sync_->group_commit_bytes = group_commit_bytes;
+    sync_->group_commit_interval =
+        std::chrono::milliseconds(group_commit_millis);
+  }
+  sync_->flusher_wakeup.notify_all();
+  if (durability == GROUP_COMMIT) {
+    FileRegistry::instance().startFlusher(file_id_);
+  }
 }
 
+Durability File::durability() const {
+  std::lock_guard<std::mutex> lock(sync_->mutex);
+  return sync_->durability;
+}
 
+void File::sync() const {
+  sync_->sync(fd_, filename_);
+}
 
+void File::readAt(const off_t position, void* buffer,
+                  const std::size_t length) const {
+  if (direct_io_ && (length != Page::SIZE ||
+      reinterpret_cast<std::uintptr_t>(buffer) % Page::IO_ALIGNMENT != 0)) {
+    readFully(fd_, filename_, direct_io_buffer_, Page::SIZE, position);
+    memcpy(buffer, direct_io_buffer_, length);
+    return;
+  }
+  readFully(fd_, filename_, buffer, length, position);
+}
 
+void File::writeAt(const off_t position, const void* buffer,
+                   const std::size_t length) {
+  if (direct_io_ && (length != Page::SIZE ||
+      reinterpret_cast<std::uintptr_t>(buffer) % Page::IO_ALIGNMENT != 0)) {
+    memset(direct_io_buffer_, 0, Page::SIZE);
+    memcpy(direct_io_buffer_, buffer, length);
+    writeFully(fd_, filename_, direct_io_buffer_, Page::SIZE, position);
+  } else {
+    writeFully(fd_, filename_, buffer, length, position);
+  }
 
-PageFile PageFile::create(const std::string& filename) {
-  return PageFile(filename, true /* create_new */);
+  bool sync_now = false;
+  bool first = false;
+  {
+    std::lock_guard<std::mutex> lock(sync_->mutex);
+    if (sync_->unsynced_bytes == 0) {
+      sync_->first_unsynced = std::chrono::steady_clock::now();
+      first = true;
+    }
+    ++sync_->written;
+    sync_->unsynced_bytes += length;
+    if (sync_->durability == GROUP_COMMIT) {
+      sync_now = sync_->unsynced_bytes >= sync_->group_commit_bytes ||
+          std::chrono::steady_clock::now() - sync_->first_unsynced >=
+              sync_->group_commit_interval;
+    }
+  }
+  if (sync_now) {
+    sync();
+  } else if (first) {
+    // Let the flusher time the age limit from this write.
+    sync_->flusher_wakeup.notify_all();
+  }
 }
 
-PageFile PageFile::open(const std::string& filename) {
-  return PageFile(filename, false /* create_new */);
+
+
+
+
+void File::readRawPages(const PageId first_page_number, const PageId count,
+                        Page* const* pages) const {
+  if (direct_io_) {
+    for (PageId i = 0; i < count; ++i) {
+      if (reinterpret_cast<std::uintptr_t>(pages[i]) % Page::IO_ALIGNMENT != 0) {
+        // Some frame can't take a direct transfer; stage pages one at a time.
+        for (PageId j = 0; j < count; ++j) {
+          readAt(pagePosition(first_page_number + j), pages[j], Page::SIZE);
+        }
+        return;
+      }
+    }
+  }
+
+  // The kernel caps the number of buffers per request, so very long runs are
+  // split into several vectored reads.
+  std::vector<struct iovec> iov(count);
+  for (PageId i = 0; i < count; ++i) {
+    iov[i].iov_base = pages[i];
+    iov[i].iov_len = Page::SIZE;
+  }
+  std::size_t next = 0;
+  off_t position = pagePosition(first_page_number);
+  while (next < iov.size()) {
+    const int batch = std::min<std::size_t>(iov.size() - next, IOV_MAX);
+    const ssize_t n = preadv(fd_, &iov[next], batch, position);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      throw FileIOException(filename_, position, n < 0 ? errno : 0);
+    }
+    position += n;
+    // Skip the buffers filled and resume a short read where it stopped.
+    std::size_t filled = n;
+    while (filled > 0 && filled >= iov[next].iov_len) {
+      filled -= iov[next].iov_len;
+      ++next;
+    }
+    if (filled > 0) {
+      iov[next].iov_base = static_cast<char*>(iov[next].iov_base) + filled;
+      iov[next].iov_len -= filled;
+    }
+  }
 }
 
-PageFile::PageFile(const std::string& name, const bool create_new)
-: File(name, create_new)
+
+
+
+
+void File::writeRawPages(const PageId first_page_number, const PageId count,
+                         const Page* pages) {
+  if (direct_io_) {
+    for (PageId i = 0; i < count; ++i) {
+      writeAt(pagePosition(first_page_number + i), &pages[i], Page::SIZE);
+    }
+    return;
+  }
+  writeAt(pagePosition(first_page_number), pages,
+          static_cast<std::size_t>(count) * Page::SIZE);
+}
+
+
+
+
+
+PageFile PageFile::create(const std::string& filename, const bool direct_io) {
+  return PageFile(filename, true /* create_new */, direct_io);
+}
+
+PageFile PageFile::open(const std::string& filename, const bool direct_io) {
+  return PageFile(filename, false /* create_new */, direct_io);
+}
+
+PageFile::PageFile(const std::string& name, const bool create_new,
+                   const bool direct_io)
+: File(name, create_new, direct_io)
 {
 }
 
@@ -248,9 +773,7 @@ Page PageFile::readPage(const PageId page_number) const {
 
 Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
+  readAt(pagePosition(page_number), &page, Page::SIZE);
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
@@ -258,6 +781,28 @@ Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
   return page;
 }
 
+void PageFile::readPages(const PageId first_page_number, const PageId count,
+                         Page* const* pages) const {
+  FileHeader header = readHeader();
+
+	if (first_page_number == Page::INVALID_NUMBER)
+	{
+		throw InvalidPageException(first_page_number, filename_);
+	}
+	if (first_page_number + count > header.num_pages)
+	{
+		throw InvalidPageException(header.num_pages, filename_);
+	}
+	readRawPages(first_page_number, count, pages);
+	for (PageId i = 0; i < count; ++i)
+	{
+		if (!pages[i]->isUsed())
+		{
+			throw InvalidPageException(first_page_number + i, filename_);
+		}
+	}
+}
+
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
 	PageHeader header = readPageHeader(new_page_number);
 	if (header.current_page_number == Page::INVALID_NUMBER)
@@ -316,33 +861,43 @@ FileIterator PageFile::end() {
 
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  if (&header == &new_page.header_) {
+    writeAt(pagePosition(page_number), &new_page, Page::SIZE);
+    return;
+  }
+  // Header and data go out in a single transfer, so stitch them together
+  // first.
+  Page page(new_page);
+  page.header_ = header;
+  writeAt(pagePosition(page_number), &page, Page::SIZE);
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
+  readAt(pagePosition(page_number), &header, sizeof(PageHeader));
   return header;
 }
 
 
 
 
-BlobFile BlobFile::create(const std::string& filename) {
-  return BlobFile(filename, true /* create_new */);
+BlobFile BlobFile::create(const std::string& filename, const bool direct_io) {
+  return BlobFile(filename, true /* create_new */, direct_io);
 }
 
-BlobFile BlobFile::open(const std::string& filename) {
-  return BlobFile(filename, false /* create_new */);
+BlobFile BlobFile::createCompressed(const std::string& filename) {
+  return BlobFile(filename, true /* create_new */, false /* direct_io */,
+                  true /* compressed */);
 }
 
-BlobFile::BlobFile(const std::string& name, const bool create_new)
-: File(name, create_new) {
+BlobFile BlobFile::open(const std::string& filename, const bool direct_io) {
+  return BlobFile(filename, false /* create_new */, direct_io);
+}
+
+BlobFile::BlobFile(const std::string& name, const bool create_new,
+                   const bool direct_io, const bool compressed)
+: File(name, create_new, direct_io && !compressed) {
+  attachPageMap(create_new && compressed);
 }
 
 BlobFile::~BlobFile() {
@@ -351,6 +906,7 @@ BlobFile::~BlobFile() {
 BlobFile::BlobFile(const BlobFile& other)
 : File(other.filename_, false /* create_new */)
 {
+  attachPageMap(false /* create_compressed */);
 }
 
 BlobFile& BlobFile::operator=(const BlobFile& rhs) {
@@ -359,9 +915,66 @@ BlobFile& BlobFile::operator=(const BlobFile& rhs) {
   close();	//close my file and associate me with the new one
   filename_ = rhs.filename_;
   openIfNeeded(false /* create_new */);
+  attachPageMap(false /* create_compressed */);
   return *this;
 }
 
+void BlobFile::attachPageMap(const bool create_compressed) {
+  const int fd = fd_;
+  const std::string& filename = filename_;
+  page_map_ = FileRegistry::instance().pageMap(file_id_,
+      [fd, &filename, create_compressed]() {
+    std::shared_ptr<CompressedPageMap> page_map;
+    if (create_compressed) {
+      // Page numbers start at 1; slot 0 stands for the header page.
+      page_map.reset(new CompressedPageMap());
+      page_map->extents.resize(1, CompressedPageMap::Extent());
+      page_map->dirty = true;
+      return page_map;
+    }
+
+    FileHeader file_header;
+    readFully(fd, filename, &file_header, sizeof(file_header), 0);
+    if (!(file_header.flags & FILE_COMPRESSED)) {
+      return page_map;
+    }
+    struct stat file_stat;
+    CompressedBlobHeader header;
+    if (fstat(fd, &file_stat) != 0) {
+      throw FileIOException(filename, 0, errno);
+    }
+    readFully(fd, filename, &header, sizeof(header), sizeof(FileHeader));
+    const std::size_t map_size =
+        header.num_extents * sizeof(CompressedPageMap::Extent);
+    if (header.magic != COMPRESSED_BLOB_MAGIC ||
+        header.map_offset < Page::SIZE ||
+        header.map_offset + map_size > static_cast<std::uint64_t>(file_stat.st_size)) {
+      // The file says it is compressed, but its page map is gone.
+      throw FileIOException(filename, sizeof(FileHeader), 0);
+    }
+    page_map.reset(new CompressedPageMap());
+    page_map->extents.resize(header.num_extents);
+    readFully(fd, filename, page_map->extents.data(), map_size,
+              header.map_offset);
+    // Pages written from now on go after the map, leaving it intact.
+    page_map->data_end = header.map_offset + map_size;
+    return page_map;
+  });
+
+  if (page_map_) {
+    // The rest of the header page holds the CompressedBlobHeader, so the
+    // FileHeader must be written on its own.
+    header_size_ = sizeof(FileHeader);
+    if (create_compressed) {
+      // Flag the file only once it has a page map to find.
+      page_map_->save(fd_, filename_);
+      FileHeader header = readHeader();
+      header.flags |= FILE_COMPRESSED;
+      writeHeader(header);
+    }
+  }
+}
+
 Page BlobFile::allocatePage(PageId &new_page_number) {
   FileHeader header = readHeader();
 	Page new_page;
@@ -383,15 +996,85 @@ Page BlobFile::allocatePage(PageId &new_page_number) {
 
 Page BlobFile::readPage(const PageId page_number) const {
 	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	if (page_map_) {
+		readCompressedPage(page_number, &page);
+		return page;
+	}
+	readAt(pagePosition(page_number), &page, Page::SIZE);
 	return page;
 }
 
+void BlobFile::readPages(const PageId first_page_number, const PageId count,
+                         Page* const* pages) const {
+	if (page_map_) {
+		// Compressed pages are not adjacent on disk; read them one by one.
+		for (PageId i = 0; i < count; ++i) {
+			readCompressedPage(first_page_number + i, pages[i]);
+		}
+		return;
+	}
+	readRawPages(first_page_number, count, pages);
+}
+
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+	if (!page_map_) {
+		writeAt(pagePosition(new_page_number), &new_page, Page::SIZE);
+		return;
+	}
+
+	char image[PageCompressor::MAX_COMPRESSED_SIZE];
+	const std::size_t length = PageCompressor::compress(new_page, image);
+	off_t position;
+	{
+		std::lock_guard<std::mutex> lock(page_map_->mutex);
+		if (new_page_number >= page_map_->extents.size()) {
+			page_map_->extents.resize(new_page_number + 1, CompressedPageMap::Extent());
+		}
+		CompressedPageMap::Extent& extent = page_map_->extents[new_page_number];
+		if (length > extent.capacity) {
+			// Move the page to the end, with some slack so that it can grow a
+			// little before it has to move again.  Its old space is not reused.
+			const std::size_t capacity = std::min<std::size_t>(
+			    (length + length / 8 + 63) & ~static_cast<std::size_t>(63),
+			    PageCompressor::MAX_COMPRESSED_SIZE);
+			extent.offset = page_map_->data_end;
+			extent.capacity = capacity;
+			page_map_->data_end += capacity;
+		}
+		extent.length = length;
+		page_map_->dirty = true;
+		position = extent.offset;
+	}
+	writeAt(position, image, length);
+}
+
+void BlobFile::readCompressedPage(const PageId page_number, Page* page) const {
+	CompressedPageMap::Extent extent = CompressedPageMap::Extent();
+	{
+		std::lock_guard<std::mutex> lock(page_map_->mutex);
+		if (page_number < page_map_->extents.size()) {
+			extent = page_map_->extents[page_number];
+		}
+	}
+	if (extent.length == 0) {
+		throw InvalidPageException(page_number, filename_);
+	}
+
+	char image[PageCompressor::MAX_COMPRESSED_SIZE];
+	readAt(extent.offset, image, extent.length);
+	if (!PageCompressor::decompress(image, extent.length, page)) {
+		throw InvalidPageException(page_number, filename_);
+	}
+}
+
+void BlobFile::sync() const {
+	if (page_map_ && page_map_->save(fd_, filename_) > 0) {
+		// The map does not go through writeAt; count it so the sync below
+		// covers it.
+		std::lock_guard<std::mutex> lock(sync_->mutex);
+		++sync_->written;
+	}
+	File::sync();
 }
 
 //delePage should not be called for a blob_file, not supported
@@ -7,10 +7,18 @@
 
 #pragma once
 
-#include <fstream>
-#include <string>
-#include <map>
+#include <sys/types.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "page.h"
 
@@ -22,6 +30,17 @@ class FileIterator;
  * @brief Header metadata for files on disk which contain pages.
  */
 struct FileHeader {
+  /**
+   * FILE_MAGIC.  Files written before the format was versioned start with
+   * num_pages instead.
+   */
+  std::uint32_t magic;
+
+  /**
+   * FILE_FORMAT_VERSION the file was written with.
+   */
+  std::uint32_t version;
+
   /**
    * Number of pages allocated in the file.
    */
@@ -42,6 +61,11 @@ struct FileHeader {
    */
   PageId first_free_page;
 
+  /**
+   * Format of the file, a combination of the FILE_* flags below.
+   */
+  std::uint32_t flags;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -49,26 +73,422 @@ struct FileHeader {
    * @return  True if the other header is equal to this one.
    */
   bool operator==(const FileHeader& rhs) const {
-    return num_pages == rhs.num_pages &&
+    return magic == rhs.magic &&
+        version == rhs.version &&
+        num_pages == rhs.num_pages &&
         num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        first_free_page == rhs.first_free_page &&
+        flags == rhs.flags;
   }
 };
 
+/**
+ * Identifies a versioned FileHeader.  The high bit is set so that it cannot
+ * be mistaken for the page count an unversioned file starts with.
+ */
+const std::uint32_t FILE_MAGIC = 0xBAD6E7DB;
+
+/**
+ * Version of the on-disk format: the FileHeader and the PageHeader of every
+ * page.  Bump it whenever either changes; files of any other version are
+ * rejected when opened.
+ */
+const std::uint32_t FILE_FORMAT_VERSION = 1;
+
+/**
+ * Set in FileHeader::flags for a BlobFile whose pages are stored compressed.
+ */
+const std::uint32_t FILE_COMPRESSED = 0x1;
+
+/**
+ * @brief How writes to a file are made durable.
+ */
+enum Durability {
+  NO_SYNC = 0,        /* Leave write-back to the operating system */
+  SYNC_ON_FLUSH = 1,  /* fdatasync whenever the buffer manager flushes the file */
+  GROUP_COMMIT = 2    /* fdatasync once enough bytes or time have accumulated,
+                         even if no more writes come, and on every flush */
+};
+
+/**
+ * @brief Durability bookkeeping shared by all File objects open on the same
+ *        file.
+ *
+ * Every write bumps <written>; a sync records the value it covered in
+ * <synced>.  Threads that ask for a sync while another one is running wait
+ * for it and, if it did not cover their writes, one of them issues the next
+ * sync for all of them.  Several writers' syncs thus collapse into one
+ * fdatasync.
+ *
+ * Under GROUP_COMMIT a flusher thread, run by the FileRegistry while the file
+ * is open, syncs writes that reach the age limit when no later write comes
+ * along to notice.
+ */
+struct FileSyncState {
+  /**
+   * Guards every member below.
+   */
+  std::mutex mutex;
+
+  /**
+   * Signalled whenever a sync completes.
+   */
+  std::condition_variable sync_done;
+
+  /**
+   * Durability mode of the file.
+   */
+  Durability durability;
+
+  /**
+   * Unsynced bytes after which GROUP_COMMIT syncs the file.
+   */
+  std::size_t group_commit_bytes;
+
+  /**
+   * Age of the oldest unsynced write after which GROUP_COMMIT syncs the file.
+   */
+  std::chrono::milliseconds group_commit_interval;
+
+  /**
+   * Number of writes issued to the file.
+   */
+  std::uint64_t written;
+
+  /**
+   * Value of <written> covered by the last completed sync.
+   */
+  std::uint64_t synced;
+
+  /**
+   * Bytes written since the last sync started.
+   */
+  std::size_t unsynced_bytes;
+
+  /**
+   * Time of the first write since the last sync started.
+   */
+  std::chrono::steady_clock::time_point first_unsynced;
+
+  /**
+   * True while some thread is running fdatasync.
+   */
+  bool syncing;
+
+  /**
+   * Signalled to wake the flusher: on the first unsynced write, a change of
+   * durability mode, and when the file is closed.
+   */
+  std::condition_variable flusher_wakeup;
+
+  /**
+   * True once the flusher is to exit.
+   */
+  bool stopping;
+
+  /**
+   * errno of the page map save or sync that failed when the file was last
+   * closed, or 0.  Reported once, by the next sync.
+   */
+  int close_error;
+
+  FileSyncState();
+
+  /**
+   * Blocks until every write issued so far is on stable storage, sharing the
+   * fdatasync with concurrent callers.  The mutex must not be held.
+   *
+   * @param fd        Descriptor of the file.
+   * @param filename  Name of the file, for errors.
+   * @throws  FileIOException   If the sync fails, or <close_error> is set.
+   */
+  void sync(const int fd, const std::string& filename);
+};
+
+/**
+ * @brief Metadata of a compressed BlobFile, stored in the header page right
+ *        after the FileHeader.
+ */
+struct CompressedBlobHeader {
+  /**
+   * COMPRESSED_BLOB_MAGIC; checked when a file flagged FILE_COMPRESSED is
+   * opened.
+   */
+  std::uint32_t magic;
+
+  /**
+   * Number of entries in the page map.
+   */
+  std::uint32_t num_extents;
+
+  /**
+   * Offset of the page map in the file; compressed pages end here.
+   */
+  std::uint64_t map_offset;
+};
+
+/**
+ * Identifies a valid CompressedBlobHeader.
+ */
+const std::uint32_t COMPRESSED_BLOB_MAGIC = 0x42444243;
+
+/**
+ * @brief Location of every page of a compressed BlobFile, shared by all
+ *        BlobFile objects open on the same file.
+ *
+ * Compressed pages vary in size, so they are packed one after the other
+ * starting at the second page of the file, and this map records where each
+ * page lives.  A page that is rewritten stays in place while it fits the
+ * space it was given and otherwise moves to the end.  The map itself is
+ * written out of place by save(), after the last page, and pages written
+ * later go past it, so the map the header points at stays intact until the
+ * next save replaces it.
+ */
+struct CompressedPageMap {
+  /**
+   * @brief Where one compressed page is stored.
+   */
+  struct Extent {
+    /**
+     * Offset of the compressed page in the file.
+     */
+    std::uint64_t offset;
+
+    /**
+     * Size of the compressed page; zero if the page was never written.
+     */
+    std::uint32_t length;
+
+    /**
+     * Bytes reserved at <offset>; rewrites up to this size stay in place.
+     */
+    std::uint32_t capacity;
+  };
+
+  /**
+   * Guards every member below.
+   */
+  std::mutex mutex;
+
+  /**
+   * Extent of every page, indexed by page number.
+   */
+  std::vector<Extent> extents;
+
+  /**
+   * Offset just past the last compressed page.
+   */
+  std::uint64_t data_end;
+
+  /**
+   * True if <extents> changed since the map was last saved.
+   */
+  bool dirty;
+
+  CompressedPageMap();
+
+  /**
+   * Writes the map after the last page and points the header at it, if it
+   * changed since the last save.  The map is synced before the header is
+   * updated, so a crash leaves the header pointing at either the old map or
+   * the new one.  Later pages are placed after the new map; the space of the
+   * old one is not reused.
+   *
+   * @param fd        Descriptor of the file.
+   * @param filename  Name of the file, for errors.
+   * @return  Number of bytes written.
+   * @throws  FileIOException   If writing the map fails.
+   */
+  std::size_t save(const int fd, const std::string& filename);
+};
+
+/**
+ * @brief Table of the filesystem files currently open, shared by all File
+ *        objects.
+ *
+ * Each open file gets an integer FileId, along with the descriptor and the
+ * number of File objects using it.  The buffer manager hashes and compares
+ * pages by FileId instead of by name.  Identifiers are never reused, so
+ * frames the buffer pool still holds for a closed file cannot be mistaken
+ * for pages of a file opened later.
+ *
+ * All methods are threadsafe.
+ */
+class FileRegistry {
+ public:
+  /**
+   * Returns the registry used by all File objects.
+   *
+   * @return  The registry.
+   */
+  static FileRegistry& instance();
+
+  /**
+   * Registers one more user of the named file.  If the file is not open yet,
+   * <opener> is called to open it and must return its descriptor; it is
+   * called with the registry locked, so concurrent opens of the same file
+   * share one descriptor.
+   *
+   * @param filename  Name of the file.
+   * @param opener    Opens the file and returns its descriptor.  May throw.
+   * @param fd        Descriptor of the file returned in this.
+   * @param sync      Durability state of the file returned in this.
+   * @return  Identifier of the file.
+   */
+  FileId acquire(const std::string& filename, const std::function<int()>& opener,
+                 int& fd, std::shared_ptr<FileSyncState>& sync);
+
+  /**
+   * Drops one user of the given file.  The last user's release retires the
+   * identifier, then, without holding the registry, stops the flusher, saves
+   * the page map, syncs writes still outstanding unless the file is NO_SYNC
+   * and closes the descriptor.  Opening the file again waits for that to
+   * finish.  Errors cannot be thrown from here; they are reported by the
+   * first sync after the file is next opened.
+   *
+   * @param file_id   Identifier of the file.
+   */
+  void release(const FileId file_id);
+
+  /**
+   * Returns true if the named file is currently open, or still closing.
+   *
+   * @param filename  Name of the file.
+   */
+  bool isOpen(const std::string& filename);
+
+  /**
+   * Returns the number of File objects using the given file.
+   *
+   * @param file_id   Identifier of the file.
+   * @return  Number of users, or 0 if the file is closed.
+   */
+  int users(const FileId file_id);
+
+  /**
+   * Starts the GROUP_COMMIT flusher of the given open file, if it is not
+   * running yet.
+   *
+   * @param file_id   Identifier of the file.
+   */
+  void startFlusher(const FileId file_id);
+
+  /**
+   * Returns the page map of the given open file.  If the file has none yet,
+   * <loader> is called, with the registry locked, to build it; files that
+   * are not compressed get a null map.  A map is saved when its file is
+   * finally closed.
+   *
+   * @param file_id   Identifier of the file.
+   * @param loader    Builds the page map of the file.  May return null.
+   * @return  Page map of the file, or null.
+   */
+  std::shared_ptr<CompressedPageMap> pageMap(const FileId file_id,
+      const std::function<std::shared_ptr<CompressedPageMap>()>& loader);
+
+ private:
+  FileRegistry() : next_id_(0) {}
+
+  /**
+   * @brief State kept for every open file.
+   */
+  struct Entry {
+    /**
+     * Name of the file, empty if this identifier is free.
+     */
+    std::string filename;
+
+    /**
+     * Descriptor shared by all users of the file.
+     */
+    int fd;
+
+    /**
+     * Number of File objects using the file.
+     */
+    int count;
+
+    /**
+     * Durability state shared by all users of the file.
+     */
+    std::shared_ptr<FileSyncState> sync;
+
+    /**
+     * Page map shared by all users of the file, if it is compressed.
+     */
+    std::shared_ptr<CompressedPageMap> page_map;
+
+    /**
+     * Thread syncing GROUP_COMMIT writes that grow too old, once started.
+     */
+    std::thread flusher;
+  };
+
+  /**
+   * Body of a flusher thread: syncs the file whenever its oldest unsynced
+   * write reaches the GROUP_COMMIT age limit, until <sync>.stopping.
+   */
+  static void runFlusher(const int fd, const std::string filename,
+                         const std::shared_ptr<FileSyncState> sync);
+
+  /**
+   * Guards every member below.
+   */
+  std::mutex mutex_;
+
+  /**
+   * Open files by FileId.
+   */
+  std::unordered_map<FileId, Entry> entries_;
+
+  /**
+   * Identifier given to the next file opened.
+   */
+  FileId next_id_;
+
+  /**
+   * Identifier of each open file by name.
+   */
+  std::unordered_map<std::string, FileId> ids_;
+
+  /**
+   * Names of the files whose last user is still closing them.
+   */
+  std::unordered_set<std::string> closing_;
+
+  /**
+   * Signalled whenever a file in <closing_> is closed.
+   */
+  std::condition_variable closed_;
+
+  /**
+   * errno of the failed close of each file, until it is opened again.
+   */
+  std::unordered_map<std::string, int> close_errors_;
+};
+
 /**
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
+ * The File class wraps a descriptor for an underlying file on disk.  Files contain
  * fixed-sized pages, and they never deallocate space (though they do reuse
  * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * underlying file, they will share the descriptor in memory.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * detects this (by looking in the FileRegistry) and just returns a file object with
+ * the already created descriptor for the file without actually opening the UNIX file again. 
  *
- * @warning This class is not threadsafe.
+ * A file may be opened in direct I/O mode, in which case pages bypass the
+ * operating system's page cache (O_DIRECT) and the buffer pool is the only
+ * cache.  Direct I/O requires page-aligned file offsets, so files created in
+ * this mode reserve a whole page for the file header.  The layout is detected
+ * again on open, so such files can also be opened normally; files with the
+ * original, unaligned layout silently fall back to buffered I/O.
+ *
+ * @warning This class is not threadsafe, although File objects for the same
+ *          file may be opened and closed from different threads.
  */
 
 
@@ -80,12 +500,16 @@ class File {
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param direct_io   Whether to bypass the operating system page cache.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  BadFileFormatException  If the existing file is not in the
+   *                                  current format.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new,
+       const bool direct_io = false);
 
   /**
    * Deletes an existing file.
@@ -134,6 +558,33 @@ class File {
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
+  /**
+   * Reads <count> consecutive pages, starting at <first_page_number>, into the
+   * array <pages> using a single read request.
+   *
+   * @param first_page_number   Number of first page to read.
+   * @param count               Number of pages to read.
+   * @param pages               Array of at least <count> pages to read into.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  void readPages(const PageId first_page_number, const PageId count,
+                 Page* pages) const;
+
+  /**
+   * Reads <count> consecutive pages, starting at <first_page_number>, into the
+   * pages pointed to by <pages>, which need not be adjacent in memory.  All
+   * pages are transferred with one vectored read request.
+   *
+   * @param first_page_number   Number of first page to read.
+   * @param count               Number of pages to read.
+   * @param pages               Array of <count> pointers to pages to read into.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  virtual void readPages(const PageId first_page_number, const PageId count,
+                         Page* const* pages) const = 0;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -157,6 +608,51 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns the identifier shared by all File objects open on this file.
+   *
+   * @return  Identifier of file.
+   */
+  FileId id() const { return file_id_; }
+
+  /**
+   * Sets how writes to this file are made durable.  The setting is shared by
+   * all File objects open on the same file.  GROUP_COMMIT starts a thread
+   * that syncs writes reaching the age limit while the file is idle.
+   *
+   * @param durability      Durability mode.
+   * @param group_commit_bytes    For GROUP_COMMIT, unsynced bytes that trigger
+   *                              a sync.
+   * @param group_commit_millis   For GROUP_COMMIT, age in milliseconds of the
+   *                              oldest unsynced write that triggers a sync.
+   */
+  void setDurability(const Durability durability,
+                     const std::size_t group_commit_bytes = 1 << 20,
+                     const unsigned int group_commit_millis = 10);
+
+  /**
+   * Returns the durability mode of this file.
+   *
+   * @return  Durability mode.
+   */
+  Durability durability() const;
+
+  /**
+   * Blocks until every write issued to this file so far is on stable storage,
+   * whatever the durability mode.  Concurrent callers share one fdatasync.
+   *
+   * @throws  FileIOException   If the sync fails, or the file was last closed
+   *                            without saving or syncing it.
+   */
+  virtual void sync() const;
+
+  /**
+   * Returns true if pages of this file bypass the operating system page cache.
+   *
+   * @return  Whether the file is open for direct I/O.
+   */
+  bool isDirectIO() const { return direct_io_; }
+
  	/**
    * Returns pageid of first page in the file.
    *
@@ -164,6 +660,14 @@ class File {
    */
 	PageId getFirstPageNo();
 
+ 	/**
+   * Returns the number of pages allocated in the file, including the header
+   * page.  Page numbers of the file are all smaller than this.
+   *
+   * @return  Number of pages in the file.
+   */
+	PageId getNumPages();
+
  protected:
   /**
    * Returns the position of the page with the given number in the file (as an
@@ -172,25 +676,29 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+  off_t pagePosition(const PageId page_number) const {
+    return header_size_ + (static_cast<off_t>(page_number - 1) * Page::SIZE);
   }
 
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing descriptor.
    *
    * @param create_new  Whether to create a new file.
+   * @param direct_io   Whether to open the file for direct I/O.  Ignored if
+   *                    the file is already open.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  BadFileFormatException  If the existing file is not in the
+   *                                  current format.
    */
-  void openIfNeeded(const bool create_new);
+  void openIfNeeded(const bool create_new, const bool direct_io = false);
 
   /**
-   * Closes the underlying file stream in <stream_>.
+   * Closes the underlying file descriptor in <fd_>.
    * This method only closes the file if no other File objects exist that access
    * the same file.
    */
@@ -210,18 +718,60 @@ class File {
    */
   void writeHeader(const FileHeader& header);
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
-  typedef std::map<std::string, int> CountMap;
+  /**
+   * Reads <length> bytes at <position> into <buffer>.  When the file is open
+   * for direct I/O, <position> must be aligned to Page::IO_ALIGNMENT; buffers
+   * that are unaligned or shorter than a page are staged through an aligned
+   * buffer.
+   *
+   * @param position  Offset in the file to read from.
+   * @param buffer    Memory to read the bytes into.
+   * @param length    Number of bytes to read.
+   * @throws  FileIOException   If the read fails or the file ends first.
+   */
+  void readAt(const off_t position, void* buffer, const std::size_t length) const;
+
+  /**
+   * Writes <length> bytes from <buffer> at <position>.  When the file is open
+   * for direct I/O, <position> must be aligned to Page::IO_ALIGNMENT and a
+   * short write pads the rest of the page with zeros.
+   *
+   * @param position  Offset in the file to write to.
+   * @param buffer    Bytes to write.
+   * @param length    Number of bytes to write.
+   * @throws  FileIOException   If the write fails.
+   */
+  void writeAt(const off_t position, const void* buffer, const std::size_t length);
+
+  /**
+   * Reads <count> consecutive pages starting at <first_page_number> straight
+   * from disk, with one vectored read request.  No bounds checking is
+   * performed.
+   *
+   * @param first_page_number   Number of first page to read.
+   * @param count               Number of pages to read.
+   * @param pages               Array of <count> pointers to pages to read into.
+   * @throws  FileIOException   If the read fails or the file ends first.
+   */
+  void readRawPages(const PageId first_page_number, const PageId count,
+                    Page* const* pages) const;
 
   /**
-   * Streams for opened files.
+   * Writes <count> consecutive pages starting at <first_page_number> straight
+   * to disk, with one write request unless the file is open for direct I/O.
+   * No bounds checking is performed.
+   *
+   * @param first_page_number   Number of first page to write.
+   * @param count               Number of pages to write.
+   * @param pages               Array of <count> pages to write.
    */
-  static StreamMap open_streams_;
+  void writeRawPages(const PageId first_page_number, const PageId count,
+                     const Page* pages);
 
   /**
-   * Counts for opened files.
+   * Aligned staging area for direct I/O transfers of unaligned buffers.
    */
-  static CountMap open_counts_;
+  alignas(Page::IO_ALIGNMENT) static thread_local char direct_io_buffer_[Page::SIZE];
 
   /**
    * Name of the file this object represents.
@@ -229,9 +779,30 @@ class File {
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Identifier of the file in the FileRegistry.
+   */
+  FileId file_id_;
+
+  /**
+   * Descriptor for underlying filesystem object.
    */
-  std::shared_ptr<std::fstream> stream_;
+  int fd_;
+
+  /**
+   * Durability state shared with other File objects for the same file.
+   */
+  std::shared_ptr<FileSyncState> sync_;
+
+  /**
+   * True if <fd_> bypasses the page cache and needs aligned transfers.
+   */
+  bool direct_io_;
+
+  /**
+   * Bytes reserved for the file header before the first page.  Either
+   * sizeof(FileHeader) or, for files laid out for direct I/O, Page::SIZE.
+   */
+  off_t header_size_;
 
   friend class FileIterator;
 };
@@ -243,33 +814,39 @@ class PageFile : public File {
    * Creates a new file.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the operating system page cache.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static PageFile create(const std::string& filename);
+  static PageFile create(const std::string& filename, const bool direct_io = false);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
-	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * It first checks if the file is already open. If so, then the new File object created uses the same file descriptor to read to or write fom
+	 * that already open file. Its reference count in the FileRegistry is incremented whenever an already open file is
+	 * opened again. Otherwise the UNIX file is actually opened and registered under a new file id.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the operating system page cache.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
+   * @throws  BadFileFormatException  If the file is not in the current format.
    */
-  static PageFile open(const std::string& filename);
+  static PageFile open(const std::string& filename, const bool direct_io = false);
 
   /**
    * Constructs a file object representing a file on the filesystem.
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param direct_io   Whether to bypass the operating system page cache.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  BadFileFormatException  If the existing file is not in the
+   *                                  current format.
    */
-  PageFile(const std::string& name, const bool create_new);
+  PageFile(const std::string& name, const bool create_new,
+           const bool direct_io = false);
 
   /**
    * Copy constructor.
@@ -310,6 +887,21 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  using File::readPages;
+
+  /**
+   * Reads <count> consecutive pages, starting at <first_page_number>, into the
+   * pages pointed to by <pages> with one vectored read request.
+   *
+   * @param first_page_number   Number of first page to read.
+   * @param count               Number of pages to read.
+   * @param pages               Array of <count> pointers to pages to read into.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  void readPages(const PageId first_page_number, const PageId count,
+                 Page* const* pages) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -380,6 +972,7 @@ class PageFile : public File {
   PageHeader readPageHeader(const PageId page_number) const;
 
   friend class FileIterator;
+  friend class HeapAppender;
 };
 
 class BlobFile : public File {
@@ -389,21 +982,35 @@ class BlobFile : public File {
    * Creates a new BlobFile.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the operating system page cache.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static BlobFile create(const std::string& filename);
+  static BlobFile create(const std::string& filename, const bool direct_io = false);
+
+  /**
+   * Creates a new BlobFile whose pages are compressed on disk.  Pages are
+   * compressed on write and decompressed on read, so users of the file see
+   * ordinary pages; the file header records the format, so open()
+   * recognizes such files by themselves.  Compressed files never use direct
+   * I/O.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileExistsException     If the requested file already exists.
+   */
+  static BlobFile createCompressed(const std::string& filename);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
-	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * It first checks if the file is already open. If so, then the new File object created uses the same file descriptor to read to or write fom
+	 * that already open file. Its reference count in the FileRegistry is incremented whenever an already open file is
+	 * opened again. Otherwise the UNIX file is actually opened and registered under a new file id.
    *
    * @param filename  Name of the file.
+   * @param direct_io Whether to bypass the operating system page cache.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
+   * @throws  BadFileFormatException  If the file is not in the current format.
    */
-  static BlobFile open(const std::string& filename);
+  static BlobFile open(const std::string& filename, const bool direct_io = false);
 
   /**
    * Constructs a file object representing a file on the filesystem.
@@ -412,12 +1019,17 @@ class BlobFile : public File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param direct_io   Whether to bypass the operating system page cache.
+   * @param compressed  Whether a new file stores its pages compressed.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  BadFileFormatException  If the existing file is not in the
+   *                                  current format.
    */
-  BlobFile(const std::string& name, const bool create_new);
+  BlobFile(const std::string& name, const bool create_new,
+           const bool direct_io = false, const bool compressed = false);
 
   /**
    * Copy constructor.
@@ -460,6 +1072,19 @@ class BlobFile : public File {
   //IF ALL YOU HAVE IS THE FILE THIS WILL RETRUN A PAGE OBJECT OF A SPECIFIED PAGE IN THAT FILE
   Page readPage(const PageId page_number) const;
 
+  using File::readPages;
+
+  /**
+   * Reads <count> consecutive pages, starting at <first_page_number>, into the
+   * pages pointed to by <pages> with one vectored read request.
+   *
+   * @param first_page_number   Number of first page to read.
+   * @param count               Number of pages to read.
+   * @param pages               Array of <count> pointers to pages to read into.
+   */
+  void readPages(const PageId first_page_number, const PageId count,
+                 Page* const* pages) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -475,6 +1100,43 @@ class BlobFile : public File {
    * @param page_number   Number of page to delete.
    */
   void deletePage(const PageId page_number);
+
+  /**
+   * Saves the page map of a compressed file, then syncs the file.
+   */
+  void sync() const;
+
+  /**
+   * Returns true if the pages of this file are stored compressed.
+   *
+   * @return  Whether the file is compressed.
+   */
+  bool isCompressed() const { return page_map_.get() != NULL; }
+
+ private:
+  /**
+   * Looks up the page map of the file, loading it from disk or, for a newly
+   * created compressed file, starting an empty one.
+   *
+   * @param create_compressed   Whether the file was just created compressed.
+   */
+  void attachPageMap(const bool create_compressed);
+
+  /**
+   * Reads and decompresses a page of a compressed file.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page was never written or its
+   *                                compressed image is corrupt.
+   */
+  void readCompressedPage(const PageId page_number, Page* page) const;
+
+  /**
+   * Page map shared with other BlobFile objects for the same file; null if
+   * the file is not compressed.
+   */
+  std::shared_ptr<CompressedPageMap> page_map_;
 };
 
 }
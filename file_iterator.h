@@ -85,12 +85,12 @@ class FileIterator {
    * @return    True if other iterator is equal to this one.
    */
 	inline bool operator==(const FileIterator& rhs) const {
-    return file_->filename() == rhs.file_->filename() &&
+    return file_->id() == rhs.file_->id() &&
         current_page_number_ == rhs.current_page_number_;
   }
 
 	inline bool operator!=(const FileIterator& rhs) const {
-    return (file_->filename() != rhs.file_->filename()) ||
+    return (file_->id() != rhs.file_->id()) ||
         (current_page_number_ != rhs.current_page_number_);
   }
 
@@ -103,6 +103,27 @@ class FileIterator {
 	inline Page operator*() const
   { return file_->readPage(current_page_number_); }
 
+  /**
+   * Returns the number of the page the iterator is pointing to, without
+   * reading the page.
+   *
+   * @return  Page number of current page.
+   */
+	PageId getCurrentPageNumber() const
+	{
+		return current_page_number_;
+	}
+
+  /**
+   * Reads just the header of the page the iterator is pointing to from disk.
+   *
+   * @return  Header of current page.
+   */
+	PageHeader getCurrentPageHeader() const
+	{
+		return file_->readPageHeader(current_page_number_);
+	}
+
  private:
   /**
    * File we're iterating over.
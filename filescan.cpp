@@ -5,11 +5,76 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include "filescan.h"
+#include "filter_kernels.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/badgerdb_exception.h"
 
 namespace badgerdb { 
 
+namespace {
+
+/**
+ * Returns true if a value comparing <cmp> (negative, zero or positive) to a
+ * constant satisfies <op>.
+ */
+bool satisfiesComparison(const int cmp, const Operator op)
+{
+  switch (op)
+  {
+    case LT: return cmp < 0;
+    case LTE: return cmp <= 0;
+    case GTE: return cmp >= 0;
+    case GT: return cmp > 0;
+    case EQ: return cmp == 0;
+    case NE: return cmp != 0;
+  }
+  return false;
+}
+
+}
+
+ScanPredicate ScanPredicate::onInteger(const std::uint16_t offset,
+                                       const Operator op, const int value)
+{
+  ScanPredicate predicate;
+  predicate.offset = offset;
+  predicate.type = INTEGER;
+  predicate.op = op;
+  predicate.intValue = value;
+  predicate.doubleValue = value;
+  return predicate;
+}
+
+ScanPredicate ScanPredicate::onDouble(const std::uint16_t offset,
+                                      const Operator op, const double value)
+{
+  ScanPredicate predicate;
+  predicate.offset = offset;
+  predicate.type = DOUBLE;
+  predicate.op = op;
+  predicate.intValue = 0;
+  predicate.doubleValue = value;
+  return predicate;
+}
+
+ScanPredicate ScanPredicate::onString(const std::uint16_t offset,
+                                      const Operator op,
+                                      const std::string& value)
+{
+  ScanPredicate predicate;
+  predicate.offset = offset;
+  predicate.type = STRING;
+  predicate.op = op;
+  predicate.intValue = 0;
+  predicate.doubleValue = 0;
+  predicate.stringValue = value;
+  return predicate;
+}
+
 FileScan::FileScan(const std::string &name, BufMgr *bufferMgr)
 {
   file = new PageFile(name, false);	//dont create new file
@@ -17,26 +82,233 @@ FileScan::FileScan(const std::string &name, BufMgr *bufferMgr)
 	curDirtyFlag = false;
   curPage = NULL;
 	filePageIter = file->begin();
+	readAheadEnd = Page::INVALID_NUMBER;
+	readAheadPages = READ_AHEAD_PAGES;
+	rangeFilter = false;
+	filterOffset = 0;
+	filterLow = 0;
+	filterHigh = 0;
+	probeHeaders = true;
 }
 
 FileScan::~FileScan()
 {
-  // generally must unpin last page of the scan
-  if (curPage != NULL)
+  // a destructor must not throw, so errors of the final flush are dropped
+  try
+  {
+    // generally must unpin last page of the scan
+    if (curPage != NULL)
+    {
+      bufMgr->unPinPage(file, curPage->page_number(), curDirtyFlag);
+      curPage = NULL;
+      curDirtyFlag = false;
+      filePageIter = file->begin();
+    }
+    bufMgr->flushFile(file);
+  }
+  catch(const BadgerDbException& e)
   {
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
-    curPage = NULL;
-		curDirtyFlag = false;
-    filePageIter = file->begin();
   }
-  bufMgr->flushFile(file);
   delete file;
 }
 
 void FileScan::scanNext(RecordId& outRid)
 {
-  std::string rec;
+  do
+  {
+    nextRecord(outRid);
+  } while (!predicates.empty() && !matches());
+}
+
+void FileScan::addPredicate(const ScanPredicate& predicate)
+{
+  predicates.push_back(predicate);
+
+  if (predicate.type == STRING || predicate.op == NE ||
+      (rangeFilter && filterOffset != predicate.offset))
+    return;
+  // Zone maps only bound the range; an inclusive bound is good enough.
+  double low = rangeFilter ? filterLow : -std::numeric_limits<double>::infinity();
+  double high = rangeFilter ? filterHigh : std::numeric_limits<double>::infinity();
+  if (predicate.op == LT || predicate.op == LTE || predicate.op == EQ)
+    high = std::min(high, predicate.doubleValue);
+  if (predicate.op == GT || predicate.op == GTE || predicate.op == EQ)
+    low = std::max(low, predicate.doubleValue);
+  setRangeFilter(predicate.offset, low, high);
+}
+
+void FileScan::setProjection(const std::vector<ScanColumn>& columns)
+{
+  projection = columns;
+}
+
+RecordView FileScan::getProjection()
+{
+  std::size_t length = 0;
+  for (std::size_t i = 0; i < projection.size(); i++)
+    length += projection[i].length;
+  projectionBuffer.assign(length, '\0');
+
+  std::size_t position = 0;
+  for (std::size_t i = 0; i < projection.size(); i++)
+  {
+    const char* field = getField(projection[i].offset, projection[i].length);
+    if (field != NULL)
+      memcpy(&projectionBuffer[position], field, projection[i].length);
+    position += projection[i].length;
+  }
+  const RecordView fields = {projectionBuffer.data(),
+                             static_cast<std::uint16_t>(length)};
+  return fields;
+}
+
+bool FileScan::matches()
+{
+  for (std::size_t i = 0; i < predicates.size(); i++)
+  {
+    if (!satisfies(predicates[i]))
+      return false;
+  }
+  return true;
+}
+
+bool FileScan::satisfies(const ScanPredicate& predicate)
+{
+  int cmp = 0;
+  if (predicate.type == INTEGER)
+  {
+    const char* field = getField(predicate.offset, sizeof(int));
+    if (field == NULL)
+      return false;
+    int value;
+    memcpy(&value, field, sizeof(value));
+    cmp = (value > predicate.intValue) - (value < predicate.intValue);
+  }
+  else if (predicate.type == DOUBLE)
+  {
+    const char* field = getField(predicate.offset, sizeof(double));
+    if (field == NULL)
+      return false;
+    double value;
+    memcpy(&value, field, sizeof(value));
+    cmp = (value > predicate.doubleValue) - (value < predicate.doubleValue);
+  }
+  else
+  {
+    const std::uint16_t length = predicate.stringValue.length();
+    const char* field = getField(predicate.offset, length);
+    if (field == NULL)
+      return false;
+    cmp = memcmp(field, predicate.stringValue.data(), length);
+  }
+  return satisfiesComparison(cmp, predicate.op);
+}
+
+bool FileScan::nextBatch(ColumnBatch& batch)
+{
+  batch.clear();
+
+  // Find the predicates that can be applied to a column of the batch.
+  const std::size_t numColumns = batch.numColumns();
+  std::vector<std::size_t> predicateColumns(predicates.size(), numColumns);
+  for (std::size_t i = 0; i < predicates.size(); i++)
+  {
+    for (std::size_t c = 0; c < numColumns; c++)
+    {
+      const BatchColumn& column = batch.column(c);
+      if (predicates[i].type != STRING && column.type == predicates[i].type &&
+          column.offset == predicates[i].offset)
+        predicateColumns[i] = c;
+    }
+  }
+
+  std::vector<const char*> fields(numColumns);
+  while (!batch.full())
+  {
+    RecordId rid;
+    try
+    {
+      nextRecord(rid);
+    }
+    catch(const EndOfFileException& e)
+    {
+      break;
+    }
+
+    bool selected = true;
+    for (std::size_t i = 0; i < predicates.size() && selected; i++)
+    {
+      if (predicateColumns[i] == numColumns)
+        selected = satisfies(predicates[i]);
+    }
+    for (std::size_t c = 0; c < numColumns && selected; c++)
+      fields[c] = getField(batch.column(c).offset, batch.column(c).width);
+    // records too short for the attribute of a predicate do not satisfy it
+    for (std::size_t i = 0; i < predicates.size() && selected; i++)
+    {
+      if (predicateColumns[i] != numColumns && fields[predicateColumns[i]] == NULL)
+        selected = false;
+    }
+    if (selected)
+      batch.appendRow(rid, fields.data());
+  }
+
+  for (std::size_t i = 0; i < predicates.size(); i++)
+  {
+    if (predicateColumns[i] != numColumns)
+      filterBatch(predicates[i], predicateColumns[i], batch);
+  }
+  return batch.size() > 0;
+}
+
+void FileScan::filterBatch(const ScanPredicate& predicate, const std::size_t column,
+                           ColumnBatch& batch)
+{
+  bool complement;
+  if (predicate.type == INTEGER)
+  {
+    std::int32_t low, high;
+    if (!FilterKernels::rangeFor(predicate.op, predicate.intValue, low, high, complement))
+      batch.selection().clear();
+    else
+      FilterKernels::filterIntRange(batch.intColumn(column), low, high, complement,
+                                    batch.selection());
+  }
+  else
+  {
+    double low, high;
+    if (!FilterKernels::rangeFor(predicate.op, predicate.doubleValue, low, high, complement))
+      batch.selection().clear();
+    else
+      FilterKernels::filterDoubleRange(batch.doubleColumn(column), low, high, complement,
+                                       batch.selection());
+  }
+}
+
+const char* FileScan::getField(const std::uint16_t offset,
+                               const std::uint16_t length)
+{
+  const RecordId rid = pageRecordIter.getCurrentRecord();
+  RecordView record;
+  if (PaxPage::isPax(*curPage))
+  {
+    const char* field = PaxPage(curPage).getField(rid, offset, length);
+    if (field != NULL)
+      return field;
+    // The field spans mini-columns, so it has to be read off the whole row.
+    record = getRecordView();
+  }
+  else
+  {
+    record = curPage->getRecordView(rid);
+  }
+  if (offset + length > record.len)
+    return NULL;
+  return record.data + offset;
+}
 
+void FileScan::nextRecord(RecordId& outRid)
+{
   if (filePageIter == file->end())
 	{
 		throw EndOfFileException();
@@ -53,7 +325,11 @@ void FileScan::scanNext(RecordId& outRid)
 		}
 	 
 		// read the first page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage); 
+    readNextPage();
+    if(filePageIter == file->end())
+		{
+			throw EndOfFileException();
+		}
 		curDirtyFlag = false;
 
 		// get the first record off the page
@@ -61,9 +337,6 @@ void FileScan::scanNext(RecordId& outRid)
 
 		if(pageRecordIter != curPage->end()) 
 		{
-		  // get pointer to record
-		  rec = *pageRecordIter;
-
 			outRid = pageRecordIter.getCurrentRecord();
 			return;
 		}
@@ -76,34 +349,114 @@ void FileScan::scanNext(RecordId& outRid)
   while (pageRecordIter == curPage->end())
   {
     // unpin the current page
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
+    bufMgr->unPinPage(file, curPage->page_number(), curDirtyFlag);
     curPage = NULL;
     curDirtyFlag = false;
 
+    // read the next page of the file
     filePageIter++;
+    readNextPage();
     if (filePageIter == file->end())
     {
       curPage = NULL;
 			throw EndOfFileException();
     }
 
-    // read the next page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
-
     // get the first record off the page
     pageRecordIter = curPage->begin(); 
   }
 
   // curRec points at a valid record
-  // see if the record satisfies the scan's predicate 
-  // get a pointer to the record
-  rec = *pageRecordIter;
-
 	// return rid of the record
 	outRid = pageRecordIter.getCurrentRecord();
 	return;
 }
 
+void FileScan::setRangeFilter(const std::uint16_t offset, const double low,
+                              const double high)
+{
+  rangeFilter = true;
+  filterOffset = offset;
+  filterLow = low;
+  filterHigh = high;
+}
+
+void FileScan::readNextPage()
+{
+  while (filePageIter != file->end())
+  {
+    const PageId pageNo = filePageIter.getCurrentPageNumber();
+    if (!rangeFilter)
+    {
+      readCurrentPage(pageNo);
+      return;
+    }
+
+    if (bufMgr->isResident(file, pageNo) || !probeHeaders)
+    {
+      // The frame may be newer than the page on disk, so check the frame.
+      // After a page that passed, the next is likely to pass as well, so it
+      // is read through the read-ahead window rather than probed first.
+      if (probeHeaders)
+        bufMgr->readPage(file, pageNo, curPage);
+      else
+        readCurrentPage(pageNo);
+      probeHeaders = curPage->rulesOut(filterOffset, filterLow, filterHigh);
+      if (!probeHeaders)
+        return;
+      bufMgr->unPinPage(file, pageNo, false);
+      curPage = NULL;
+      filePageIter++;
+    }
+    else
+    {
+      // Decide by the header alone; it also tells where the chain goes on.
+      const PageHeader header = filePageIter.getCurrentPageHeader();
+      if (!header.rulesOut(filterOffset, filterLow, filterHigh))
+      {
+        readCurrentPage(pageNo);
+        probeHeaders = false;
+        return;
+      }
+      filePageIter = FileIterator(file, header.next_page_number);
+    }
+  }
+}
+
+void FileScan::readCurrentPage(const PageId pageNo)
+{
+  if (pageNo >= readAheadEnd || pageNo + READ_AHEAD_PAGES < readAheadEnd)
+  {
+    // Pages of a relation are usually chained in page number order, so read
+    // the next few with this one.
+    PageId count = readAheadPages;
+    const PageId numPages = file->getNumPages();
+    if (pageNo + count > numPages)
+      count = numPages - pageNo;
+
+    Page* pages[READ_AHEAD_PAGES];
+    try
+    {
+      bufMgr->readPageRange(file, pageNo, count, pages);
+      for (PageId i = 1; i < count; i++)
+        bufMgr->unPinPage(file, pageNo + i, false);
+      curPage = pages[0];
+      readAheadEnd = pageNo + count;
+      if (readAheadPages < READ_AHEAD_PAGES)
+        readAheadPages *= 2;
+      return;
+    }
+    catch(const BadgerDbException& e)
+    {
+      // free pages in the window or a crowded buffer pool; read this page
+      // alone and try a window half the size from the next page on
+      readAheadPages = count > 1 ? count / 2 : 1;
+      readAheadEnd = pageNo + 1;
+    }
+  }
+  bufMgr->readPage(file, pageNo, curPage);
+}
+
 // returns pointer to the current record.  page is left pinned
 // and the scan logic is required to unpin the page 
 std::string FileScan::getRecord()
@@ -111,6 +464,28 @@ std::string FileScan::getRecord()
   return *pageRecordIter;
 }
 
+RecordView FileScan::getRecordView()
+{
+  if (PaxPage::isPax(*curPage))
+  {
+    PaxPage paxPage(curPage);
+    rowBuffer.resize(paxPage.tupleSize());
+    paxPage.copyRecord(pageRecordIter.getCurrentRecord(), &rowBuffer[0]);
+    const RecordView record = {rowBuffer.data(),
+                               static_cast<std::uint16_t>(rowBuffer.size())};
+    return record;
+  }
+  return pageRecordIter.getRecordView();
+}
+
+bool FileScan::getColumnView(const std::uint16_t attr, ColumnView& column)
+{
+  if (curPage == NULL || !PaxPage::isPax(*curPage))
+    return false;
+  column = PaxPage(curPage).getColumnView(attr);
+  return true;
+}
+
 // mark current page of scan dirty
 void FileScan::markDirty()
 {
@@ -9,16 +9,93 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include "types.h"
 #include "page.h"
 #include "buffer.h"
 #include "file_iterator.h"
 #include "page_iterator.h"
+#include "pax_page.h"
+#include "column_batch.h"
 
 namespace badgerdb {
 
+/**
+ * @brief Condition on one attribute of the records of a scan.
+ */
+struct ScanPredicate {
+  /**
+   * Byte offset of the attribute in records.
+   */
+  std::uint16_t offset;
+
+  /**
+   * Datatype of the attribute.
+   */
+  Datatype type;
+
+  /**
+   * How the attribute is compared to the constant: attribute <op> constant.
+   */
+  Operator op;
+
+  /**
+   * Constant for INTEGER attributes.
+   */
+  int intValue;
+
+  /**
+   * Constant for DOUBLE attributes.
+   */
+  double doubleValue;
+
+  /**
+   * Constant for STRING attributes.  The attribute is taken to be as long as
+   * the constant and compared to it bytewise.
+   */
+  std::string stringValue;
+
+  /**
+   * Returns a predicate on an INTEGER attribute.
+   */
+  static ScanPredicate onInteger(const std::uint16_t offset, const Operator op,
+                                 const int value);
+
+  /**
+   * Returns a predicate on a DOUBLE attribute.
+   */
+  static ScanPredicate onDouble(const std::uint16_t offset, const Operator op,
+                                const double value);
+
+  /**
+   * Returns a predicate on a STRING attribute of value.length() bytes.
+   */
+  static ScanPredicate onString(const std::uint16_t offset, const Operator op,
+                                const std::string& value);
+};
+
+/**
+ * @brief Bytes of a record to keep in a projection.
+ */
+struct ScanColumn {
+  /**
+   * Byte offset of the field in records.
+   */
+  std::uint16_t offset;
+
+  /**
+   * Length of the field in bytes.
+   */
+  std::uint16_t length;
+};
+
 /**
  * @brief This class is used to sequentially scan records in a relation.
+ *
+ * Predicates added with addPredicate() are evaluated on the pinned page, so
+ * scanNext() only stops at records that satisfy all of them, and a
+ * projection set with setProjection() is cut out of the page without
+ * copying the rest of the record.
  */
 class FileScan
 {
@@ -31,13 +108,147 @@ class FileScan
   //return RecordId of next record that satisfies the scan 
   void scanNext(RecordId& outRid);
 
-  //read current record, returning pointer and length
+  /**
+   * Restricts the scan to records satisfying <predicate>, in addition to the
+   * predicates added before.  Records too short to hold the attribute do not
+   * satisfy it.  Range predicates on INTEGER and DOUBLE attributes also
+   * narrow the range filter (see setRangeFilter) if it is unset or on the
+   * same attribute, so pages their zone maps rule out are skipped.
+   *
+   * @param predicate   Condition records must satisfy.
+   */
+  void addPredicate(const ScanPredicate& predicate);
+
+  /**
+   * Sets the fields getProjection() returns for each record.
+   *
+   * @param columns   Fields to return, in order.
+   */
+  void setProjection(const std::vector<ScanColumn>& columns);
+
+  /**
+   * Returns the projected fields of the current record, one after the other.
+   * Fields the record is too short for are filled with zeros.  The view is
+   * valid until the next call to scanNext() or getProjection().
+   *
+   * @return  View of the projected fields.
+   */
+  RecordView getProjection();
+
+  /**
+   * Decodes the next records satisfying the predicates into <batch>, until
+   * the batch is full or the relation ends.  Predicates on INTEGER and DOUBLE
+   * attributes that are also columns of the batch are applied to the whole
+   * batch at the end with the FilterKernels, by shrinking its selection
+   * vector; the others are
+   * applied before a record is decoded.  Rows are cleared first.
+   *
+   * @param batch   Batch receiving the records, with its columns declared.
+   * @return  False if there were no more records.
+   */
+  bool nextBatch(ColumnBatch& batch);
+
+  //read current record, returning a copy of it
   std::string getRecord();
 
+  /**
+   * Returns a view of the current record, pointing into the pinned page of
+   * the scan.  The view is valid until the next call to scanNext().  Rows of
+   * PAX pages are not contiguous, so they are first gathered into a buffer
+   * of the scan.
+   *
+   * @return  View of the current record.
+   */
+  RecordView getRecordView();
+
+  /**
+   * Returns the values of one attribute for all rows of the current page,
+   * if that page is in PAX layout.  The view points into the pinned page and
+   * is valid until the scan moves to another page.
+   *
+   * @param attr    Number of attribute, starting at 0.
+   * @param column  View of the attribute's mini-column returned in this.
+   * @return  False if the current page is not in PAX layout.
+   */
+  bool getColumnView(const std::uint16_t attr, ColumnView& column);
+
   //marks current page of scan dirty
   void markDirty();
 
+  /**
+   * Makes the scan skip pages whose zone map for the attribute at <offset>
+   * shows no value in [low, high] (see Page::addZoneMap).  Pages without a
+   * zone map for the attribute are always read, and all records of the pages
+   * that are read are returned, so callers still have to check them.  While
+   * pages are being skipped, pages not in the buffer pool are judged by
+   * their header alone; once a page passes, the following ones are read
+   * through read-ahead and judged in the buffer pool, so a passing page is
+   * read from disk once.
+   *
+   * @param offset  Byte offset of the attribute in records.
+   * @param low     Smallest value of interest.
+   * @param high    Largest value of interest.
+   */
+  void setRangeFilter(const std::uint16_t offset, const double low,
+                      const double high);
+
+  /**
+   * Number of pages the scan reads from disk in one request when it reaches
+   * a page that is not in the buffer pool.  Fewer while such requests fail.
+   */
+  static const PageId READ_AHEAD_PAGES = 8;
+
  private:
+  /**
+   * Moves to the next record of the relation, whether or not it satisfies
+   * the predicates.
+   *
+   * @param outRid  RecordId of the record returned in this.
+   * @throws  EndOfFileException  If there are no more records.
+   */
+  void nextRecord(RecordId& outRid);
+
+  /**
+   * Returns true if the current record satisfies all predicates.
+   */
+  bool matches();
+
+  /**
+   * Returns true if the current record satisfies <predicate>.
+   */
+  bool satisfies(const ScanPredicate& predicate);
+
+  /**
+   * Removes the rows of <batch> whose value in <column> does not satisfy
+   * <predicate> from its selection vector.
+   */
+  static void filterBatch(const ScanPredicate& predicate, const std::size_t column,
+                          ColumnBatch& batch);
+
+  /**
+   * Returns a pointer to <length> bytes at <offset> in the current record,
+   * on the pinned page where possible.
+   *
+   * @param offset  Byte offset in the record.
+   * @param length  Number of bytes.
+   * @return  Pointer to the bytes, or NULL if the record is too short.
+   */
+  const char* getField(const std::uint16_t offset, const std::uint16_t length);
+
+  /**
+   * Pins the first page at or after filePageIter that the range filter does
+   * not rule out as curPage, moving filePageIter to it.  Leaves filePageIter
+   * at the end of the file if there is none.
+   */
+  void readNextPage();
+
+  /**
+   * Pins page pageNo as curPage.  If the page is past the last read-ahead
+   * window, the pages after it are read in the same request and unpinned
+   * again, leaving them in the buffer pool for the following steps.
+   */
+  void readCurrentPage(const PageId pageNo);
+
   /**
    * File which is being scanned.
    */
@@ -60,6 +271,59 @@ class FileScan
    * True if page has been updated
    */
   bool  	      curDirtyFlag;
+
+  /**
+   * Page number following the last page brought in by read-ahead.
+   */
+  PageId        readAheadEnd;
+
+  /**
+   * Pages the next read-ahead window spans: halved whenever a window cannot
+   * be read, doubled back up to READ_AHEAD_PAGES whenever one can.
+   */
+  PageId        readAheadPages;
+
+  /**
+   * Current row gathered from a PAX page by getRecordView().
+   */
+  std::string   rowBuffer;
+
+  /**
+   * True if pages are skipped by their zone maps.
+   */
+  bool          rangeFilter;
+
+  /**
+   * Byte offset in records of the attribute pages are skipped by.
+   */
+  std::uint16_t filterOffset;
+
+  /**
+   * Range of attribute values the scan is interested in.
+   */
+  double        filterLow;
+  double        filterHigh;
+
+  /**
+   * True if the last page judged by the range filter was skipped, so the next
+   * one is probed by its header before it is read.
+   */
+  bool          probeHeaders;
+
+  /**
+   * Conditions every returned record satisfies.
+   */
+  std::vector<ScanPredicate> predicates;
+
+  /**
+   * Fields returned by getProjection().
+   */
+  std::vector<ScanColumn> projection;
+
+  /**
+   * Projected fields of the current record.
+   */
+  std::string   projectionBuffer;
 };
 
 }
@@ -0,0 +1,407 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "filter_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BADGERDB_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Longest IN-list compared value by value; longer lists are searched.
+ */
+const std::size_t MAX_LINEAR_IN_LIST = 16;
+
+typedef std::size_t (*IntRangeKernel)(const std::int32_t*, std::size_t,
+                                      std::int32_t, std::int32_t, bool,
+                                      std::uint32_t*);
+typedef std::size_t (*DoubleRangeKernel)(const double*, std::size_t, double,
+                                         double, bool, std::uint32_t*);
+typedef std::size_t (*IntInKernel)(const std::int32_t*, std::size_t,
+                                   const std::int32_t*, std::size_t,
+                                   std::uint32_t*);
+
+/**
+ * Appends the positions first + j of the set bits j of <mask> to <out>
+ * without branching on the bits, which would be mispredicted at middling
+ * selectivities.
+ */
+inline std::size_t appendPositions(unsigned mask, const unsigned lanes,
+                                   const std::size_t first, std::uint32_t* out,
+                                   std::size_t k) {
+  for (unsigned j = 0; j < lanes; ++j) {
+    out[k] = static_cast<std::uint32_t>(first + j);
+    k += (mask >> j) & 1;
+  }
+  return k;
+}
+
+template <typename T>
+std::size_t rangeScalar(const T* values, const std::size_t first,
+                        const std::size_t count, const T low, const T high,
+                        const bool complement, std::uint32_t* out,
+                        std::size_t k) {
+  for (std::size_t i = first; i < count; ++i) {
+    const bool inside = values[i] >= low && values[i] <= high;
+    out[k] = static_cast<std::uint32_t>(i);
+    k += inside != complement;
+  }
+  return k;
+}
+
+std::size_t intRangeScalar(const std::int32_t* values, const std::size_t count,
+                           const std::int32_t low, const std::int32_t high,
+                           const bool complement, std::uint32_t* out) {
+  return rangeScalar(values, 0, count, low, high, complement, out, 0);
+}
+
+std::size_t doubleRangeScalar(const double* values, const std::size_t count,
+                              const double low, const double high,
+                              const bool complement, std::uint32_t* out) {
+  return rangeScalar(values, 0, count, low, high, complement, out, 0);
+}
+
+std::size_t inScalar(const std::int32_t* values, const std::size_t first,
+                     const std::size_t count, const std::int32_t* list,
+                     const std::size_t list_size, std::uint32_t* out,
+                     std::size_t k) {
+  for (std::size_t i = first; i < count; ++i) {
+    bool found = false;
+    for (std::size_t j = 0; j < list_size; ++j) {
+      found |= values[i] == list[j];
+    }
+    out[k] = static_cast<std::uint32_t>(i);
+    k += found;
+  }
+  return k;
+}
+
+std::size_t intInScalar(const std::int32_t* values, const std::size_t count,
+                        const std::int32_t* list, const std::size_t list_size,
+                        std::uint32_t* out) {
+  return inScalar(values, 0, count, list, list_size, out, 0);
+}
+
+#ifdef BADGERDB_X86_KERNELS
+
+__attribute__((target("sse2")))
+std::size_t intRangeSse2(const std::int32_t* values, const std::size_t count,
+                         const std::int32_t low, const std::int32_t high,
+                         const bool complement, std::uint32_t* out) {
+  const __m128i lo = _mm_set1_epi32(low);
+  const __m128i hi = _mm_set1_epi32(high);
+  const unsigned flip = complement ? 0xF : 0;
+  std::size_t k = 0;
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+    const __m128i outside = _mm_or_si128(_mm_cmpgt_epi32(lo, x),
+                                         _mm_cmpgt_epi32(x, hi));
+    const unsigned mask =
+        (~static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(outside))) & 0xF) ^ flip;
+    k = appendPositions(mask, 4, i, out, k);
+  }
+  return rangeScalar(values, i, count, low, high, complement, out, k);
+}
+
+__attribute__((target("sse2")))
+std::size_t doubleRangeSse2(const double* values, const std::size_t count,
+                            const double low, const double high,
+                            const bool complement, std::uint32_t* out) {
+  const __m128d lo = _mm_set1_pd(low);
+  const __m128d hi = _mm_set1_pd(high);
+  const unsigned flip = complement ? 0x3 : 0;
+  std::size_t k = 0;
+  std::size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    const __m128d x = _mm_loadu_pd(values + i);
+    const __m128d inside = _mm_and_pd(_mm_cmpge_pd(x, lo), _mm_cmple_pd(x, hi));
+    const unsigned mask = static_cast<unsigned>(_mm_movemask_pd(inside)) ^ flip;
+    k = appendPositions(mask, 2, i, out, k);
+  }
+  return rangeScalar(values, i, count, low, high, complement, out, k);
+}
+
+__attribute__((target("avx2")))
+std::size_t intRangeAvx2(const std::int32_t* values, const std::size_t count,
+                         const std::int32_t low, const std::int32_t high,
+                         const bool complement, std::uint32_t* out) {
+  const __m256i lo = _mm256_set1_epi32(low);
+  const __m256i hi = _mm256_set1_epi32(high);
+  const unsigned flip = complement ? 0xFF : 0;
+  std::size_t k = 0;
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+    const __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(lo, x),
+                                            _mm256_cmpgt_epi32(x, hi));
+    const unsigned mask =
+        (~static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(outside))) & 0xFF) ^ flip;
+    k = appendPositions(mask, 8, i, out, k);
+  }
+  return rangeScalar(values, i, count, low, high, complement, out, k);
+}
+
+__attribute__((target("avx2")))
+std::size_t doubleRangeAvx2(const double* values, const std::size_t count,
+                            const double low, const double high,
+                            const bool complement, std::uint32_t* out) {
+  const __m256d lo = _mm256_set1_pd(low);
+  const __m256d hi = _mm256_set1_pd(high);
+  const unsigned flip = complement ? 0xF : 0;
+  std::size_t k = 0;
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m256d x = _mm256_loadu_pd(values + i);
+    const __m256d inside = _mm256_and_pd(_mm256_cmp_pd(x, lo, _CMP_GE_OQ),
+                                         _mm256_cmp_pd(x, hi, _CMP_LE_OQ));
+    const unsigned mask = static_cast<unsigned>(_mm256_movemask_pd(inside)) ^ flip;
+    k = appendPositions(mask, 4, i, out, k);
+  }
+  return rangeScalar(values, i, count, low, high, complement, out, k);
+}
+
+__attribute__((target("avx2")))
+std::size_t intInAvx2(const std::int32_t* values, const std::size_t count,
+                      const std::int32_t* list, const std::size_t list_size,
+                      std::uint32_t* out) {
+  std::size_t k = 0;
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+    __m256i found = _mm256_setzero_si256();
+    for (std::size_t j = 0; j < list_size; ++j) {
+      found = _mm256_or_si256(found, _mm256_cmpeq_epi32(x, _mm256_set1_epi32(list[j])));
+    }
+    const unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(found));
+    k = appendPositions(mask, 8, i, out, k);
+  }
+  return inScalar(values, i, count, list, list_size, out, k);
+}
+
+#endif
+
+/**
+ * Kernels picked for this CPU.
+ */
+struct Dispatch {
+  FilterKernels::InstructionSet instruction_set;
+  IntRangeKernel int_range;
+  DoubleRangeKernel double_range;
+  IntInKernel int_in;
+
+  Dispatch()
+      : instruction_set(FilterKernels::SCALAR),
+        int_range(intRangeScalar),
+        double_range(doubleRangeScalar),
+        int_in(intInScalar) {
+#ifdef BADGERDB_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      instruction_set = FilterKernels::AVX2;
+      int_range = intRangeAvx2;
+      double_range = doubleRangeAvx2;
+      int_in = intInAvx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+      instruction_set = FilterKernels::SSE2;
+      int_range = intRangeSse2;
+      double_range = doubleRangeSse2;
+    }
+#endif
+  }
+};
+
+const Dispatch& dispatch() {
+  static const Dispatch kernels;
+  return kernels;
+}
+
+/**
+ * Keeps the rows of <selection> for which <qualifies> holds of their value.
+ */
+template <typename T, typename Predicate>
+void filterScalar(const T* values, const Predicate& qualifies,
+                  std::vector<std::uint32_t>& selection) {
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < selection.size(); ++i) {
+    selection[kept] = selection[i];
+    kept += qualifies(values[selection[i]]);
+  }
+  selection.resize(kept);
+}
+
+}
+
+FilterKernels::InstructionSet FilterKernels::instructionSet() {
+  return dispatch().instruction_set;
+}
+
+bool FilterKernels::rangeFor(const Operator op, const std::int32_t constant,
+                             std::int32_t& low, std::int32_t& high,
+                             bool& complement) {
+  const std::int32_t min = std::numeric_limits<std::int32_t>::min();
+  const std::int32_t max = std::numeric_limits<std::int32_t>::max();
+  low = min;
+  high = max;
+  complement = false;
+  switch (op) {
+    case LT:
+      if (constant == min) {
+        return false;
+      }
+      high = constant - 1;
+      break;
+    case LTE:
+      high = constant;
+      break;
+    case GTE:
+      low = constant;
+      break;
+    case GT:
+      if (constant == max) {
+        return false;
+      }
+      low = constant + 1;
+      break;
+    case EQ:
+      low = high = constant;
+      break;
+    case NE:
+      low = high = constant;
+      complement = true;
+      break;
+  }
+  return true;
+}
+
+bool FilterKernels::rangeFor(const Operator op, const double constant,
+                             double& low, double& high, bool& complement) {
+  const double infinity = std::numeric_limits<double>::infinity();
+  low = -infinity;
+  high = infinity;
+  complement = false;
+  switch (op) {
+    case LT:
+      if (constant == -infinity) {
+        return false;
+      }
+      high = std::nextafter(constant, -infinity);
+      break;
+    case LTE:
+      high = constant;
+      break;
+    case GTE:
+      low = constant;
+      break;
+    case GT:
+      if (constant == infinity) {
+        return false;
+      }
+      low = std::nextafter(constant, infinity);
+      break;
+    case EQ:
+      low = high = constant;
+      break;
+    case NE:
+      low = high = constant;
+      complement = true;
+      break;
+  }
+  // A NaN constant leaves an empty range, as no comparison with it holds.
+  return true;
+}
+
+std::size_t FilterKernels::selectIntRange(const std::int32_t* values,
+                                          const std::size_t count,
+                                          const std::int32_t low,
+                                          const std::int32_t high,
+                                          const bool complement,
+                                          std::uint32_t* out) {
+  return dispatch().int_range(values, count, low, high, complement, out);
+}
+
+std::size_t FilterKernels::selectDoubleRange(const double* values,
+                                             const std::size_t count,
+                                             const double low,
+                                             const double high,
+                                             const bool complement,
+                                             std::uint32_t* out) {
+  return dispatch().double_range(values, count, low, high, complement, out);
+}
+
+std::size_t FilterKernels::selectIntIn(const std::int32_t* values,
+                                       const std::size_t count,
+                                       const std::vector<std::int32_t>& list,
+                                       std::uint32_t* out) {
+  if (list.size() <= MAX_LINEAR_IN_LIST) {
+    return dispatch().int_in(values, count, list.data(), list.size(), out);
+  }
+  std::vector<std::int32_t> sorted(list);
+  std::sort(sorted.begin(), sorted.end());
+  std::size_t k = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    out[k] = static_cast<std::uint32_t>(i);
+    k += std::binary_search(sorted.begin(), sorted.end(), values[i]);
+  }
+  return k;
+}
+
+void FilterKernels::filterIntRange(const std::int32_t* values,
+                                   const std::int32_t low,
+                                   const std::int32_t high,
+                                   const bool complement,
+                                   std::vector<std::uint32_t>& selection) {
+  if (isDense(selection)) {
+    // Positions in a dense selection are row numbers, and are written no
+    // faster than they are read.
+    selection.resize(selectIntRange(values, selection.size(), low, high,
+                                    complement, selection.data()));
+    return;
+  }
+  filterScalar(values, [&](const std::int32_t value) {
+    return (value >= low && value <= high) != complement;
+  }, selection);
+}
+
+void FilterKernels::filterDoubleRange(const double* values, const double low,
+                                      const double high, const bool complement,
+                                      std::vector<std::uint32_t>& selection) {
+  if (isDense(selection)) {
+    selection.resize(selectDoubleRange(values, selection.size(), low, high,
+                                       complement, selection.data()));
+    return;
+  }
+  filterScalar(values, [&](const double value) {
+    return (value >= low && value <= high) != complement;
+  }, selection);
+}
+
+void FilterKernels::filterIntIn(const std::int32_t* values,
+                                const std::vector<std::int32_t>& list,
+                                std::vector<std::uint32_t>& selection) {
+  if (isDense(selection)) {
+    selection.resize(selectIntIn(values, selection.size(), list,
+                                 selection.data()));
+    return;
+  }
+  std::vector<std::int32_t> sorted(list);
+  std::sort(sorted.begin(), sorted.end());
+  filterScalar(values, [&](const std::int32_t value) {
+    return std::binary_search(sorted.begin(), sorted.end(), value);
+  }, selection);
+}
+
+}
@@ -0,0 +1,145 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Filters over arrays of INTEGER and DOUBLE values.
+ *
+ * Every comparison is reduced to a closed range [low, high], or to its
+ * complement for NE, so one kernel per type covers all operators.  Kernels
+ * come in two forms: select*() scans a dense array and writes the positions
+ * of the qualifying values, and filter*() shrinks a selection vector (see
+ * ColumnBatch) to the rows whose value qualifies.
+ *
+ * On x86 the kernels compare 8 (AVX2) or 4 (SSE2) values per instruction;
+ * the instruction set is picked once, at the first call, from what the CPU
+ * supports.  Elsewhere, and for the tail of an array, plain C++ is used.
+ * Comparisons follow IEEE rules, so NaN satisfies only NE.
+ *
+ * All methods are threadsafe.
+ */
+class FilterKernels {
+ public:
+  /**
+   * Instruction sets the kernels can be run with.
+   */
+  enum InstructionSet {
+    SCALAR = 0,
+    SSE2 = 1,
+    AVX2 = 2
+  };
+
+  /**
+   * Returns the instruction set the kernels run with on this CPU.
+   */
+  static InstructionSet instructionSet();
+
+  /**
+   * Converts <attribute op constant> into a closed range of INTEGER values.
+   *
+   * @param op          Comparison.
+   * @param constant    Value compared against.
+   * @param low         Smallest qualifying value returned in this.
+   * @param high        Largest qualifying value returned in this.
+   * @param complement  Returned true if the values outside [low, high]
+   *                    qualify instead (for NE).
+   * @return  False if no value qualifies.
+   */
+  static bool rangeFor(const Operator op, const std::int32_t constant,
+                       std::int32_t& low, std::int32_t& high, bool& complement);
+
+  /**
+   * Converts <attribute op constant> into a closed range of DOUBLE values.
+   * See the INTEGER version.
+   */
+  static bool rangeFor(const Operator op, const double constant,
+                       double& low, double& high, bool& complement);
+
+  /**
+   * Writes the positions of the values in [low, high] (outside it if
+   * <complement>) to <out>, in increasing order.
+   *
+   * @param values      Values to test.
+   * @param count       Number of values.
+   * @param low         Smallest qualifying value.
+   * @param high        Largest qualifying value.
+   * @param complement  True to select the values outside the range.
+   * @param out         Buffer of at least <count> positions.
+   * @return  Number of positions written.
+   */
+  static std::size_t selectIntRange(const std::int32_t* values,
+                                    const std::size_t count,
+                                    const std::int32_t low,
+                                    const std::int32_t high,
+                                    const bool complement, std::uint32_t* out);
+
+  /**
+   * DOUBLE version of selectIntRange().
+   */
+  static std::size_t selectDoubleRange(const double* values,
+                                       const std::size_t count,
+                                       const double low, const double high,
+                                       const bool complement,
+                                       std::uint32_t* out);
+
+  /**
+   * Writes the positions of the values that occur in <list> to <out>, in
+   * increasing order.
+   *
+   * @param values    Values to test.
+   * @param count     Number of values.
+   * @param list      Values of interest, in any order.
+   * @param out       Buffer of at least <count> positions.
+   * @return  Number of positions written.
+   */
+  static std::size_t selectIntIn(const std::int32_t* values,
+                                 const std::size_t count,
+                                 const std::vector<std::int32_t>& list,
+                                 std::uint32_t* out);
+
+  /**
+   * Keeps the rows of <selection> whose value, values[row], is in [low,
+   * high] (outside it if <complement>).
+   */
+  static void filterIntRange(const std::int32_t* values, const std::int32_t low,
+                             const std::int32_t high, const bool complement,
+                             std::vector<std::uint32_t>& selection);
+
+  /**
+   * DOUBLE version of filterIntRange().
+   */
+  static void filterDoubleRange(const double* values, const double low,
+                                const double high, const bool complement,
+                                std::vector<std::uint32_t>& selection);
+
+  /**
+   * Keeps the rows of <selection> whose value, values[row], occurs in
+   * <list>.
+   */
+  static void filterIntIn(const std::int32_t* values,
+                          const std::vector<std::int32_t>& list,
+                          std::vector<std::uint32_t>& selection);
+
+ private:
+  /**
+   * Returns true if <selection> is 0, 1, ..., n - 1, so it can be filtered
+   * with the dense kernels.
+   */
+  static bool isDense(const std::vector<std::uint32_t>& selection) {
+    return !selection.empty() && selection.back() == selection.size() - 1;
+  }
+};
+
+}
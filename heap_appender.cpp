@@ -0,0 +1,134 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "heap_appender.h"
+
+#include "exceptions/badgerdb_exception.h"
+
+namespace badgerdb {
+
+const PageId HeapAppender::EXTENT_PAGES;
+
+HeapAppender::HeapAppender(PageFile* file, BufMgr* bufMgr,
+                           const PageId extentPages)
+    : file_(file),
+      buf_mgr_(bufMgr),
+      extent_pages_(extentPages > 0 ? extentPages : 1),
+      page_open_(false),
+      tail_(Page::INVALID_NUMBER),
+      num_pages_(0) {
+  const FileHeader header = file_->readHeader();
+  first_pending_ = header.num_pages;
+  // Walk the used list once to find where new pages are linked in.
+  for (PageId page_number = header.first_used_page;
+       page_number != Page::INVALID_NUMBER;
+       page_number = file_->readPageHeader(page_number).next_page_number) {
+    tail_ = page_number;
+  }
+  pending_.reserve(extent_pages_);
+}
+
+HeapAppender::~HeapAppender() {
+  try {
+    finish();
+  } catch (const BadgerDbException&) {
+    // Destructors must not throw; finish() reports this to callers that ask.
+  }
+}
+
+void HeapAppender::addZoneMap(const std::uint16_t offset, const Datatype type) {
+  zone_maps_.push_back(std::make_pair(offset, type));
+}
+
+RecordId HeapAppender::append(const std::string& record_data) {
+  if (!page_open_) {
+    startPage();
+  } else if (!page_.hasSpaceForRecord(record_data) && page_.header_.num_slots > 0) {
+    sealPage();
+    startPage();
+  }
+  // Throws if the record is too large even for the empty page.
+  return page_.insertRecord(record_data);
+}
+
+void HeapAppender::append(const std::vector<std::string>& records,
+                          std::vector<RecordId>& rids) {
+  rids.reserve(rids.size() + records.size());
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    rids.push_back(append(records[i]));
+  }
+}
+
+void HeapAppender::finish() {
+  if (page_open_) {
+    if (page_.header_.num_slots > 0) {
+      sealPage();
+    } else {
+      // Nothing went into it; give its number back.
+      page_open_ = false;
+      --num_pages_;
+    }
+  }
+  writePending();
+}
+
+void HeapAppender::startPage() {
+  const PageId page_number = first_pending_ + pending_.size();
+  page_ = Page();
+  page_.set_page_number(page_number);
+  for (std::size_t i = 0; i < zone_maps_.size(); ++i) {
+    page_.addZoneMap(zone_maps_[i].first, zone_maps_[i].second);
+  }
+  if (!pending_.empty()) {
+    pending_.back().set_next_page_number(page_number);
+  }
+  page_open_ = true;
+  ++num_pages_;
+}
+
+void HeapAppender::sealPage() {
+  pending_.push_back(page_);
+  page_open_ = false;
+  if (pending_.size() >= extent_pages_) {
+    writePending();
+  }
+}
+
+void HeapAppender::writePending() {
+  if (pending_.empty()) {
+    return;
+  }
+  // Write the pages before linking them in, so that a crash in between
+  // leaves unreachable pages rather than a broken chain.
+  file_->writeRawPages(first_pending_, pending_.size(), pending_.data());
+
+  FileHeader header = file_->readHeader();
+  if (tail_ == Page::INVALID_NUMBER) {
+    header.first_used_page = first_pending_;
+  } else {
+    // Relink the tail in its buffer frame and write it through, since frames
+    // written back later keep the link found on disk.
+    Page* tail_page;
+    buf_mgr_->readPage(file_, tail_, tail_page);
+    tail_page->set_next_page_number(first_pending_);
+    try {
+      file_->writePage(tail_, tail_page->header_, *tail_page);
+    } catch (...) {
+      buf_mgr_->unPinPage(file_, tail_, false);
+      throw;
+    }
+    buf_mgr_->unPinPage(file_, tail_, false);
+  }
+  header.num_pages = first_pending_ + pending_.size();
+  file_->writeHeader(header);
+
+  tail_ = header.num_pages - 1;
+  first_pending_ = header.num_pages;
+  pending_.clear();
+}
+
+}
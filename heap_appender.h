@@ -0,0 +1,161 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Loads records into a PageFile heap in bulk.
+ *
+ * Records are packed into a page in memory until it has no room for the next
+ * one; the appender checks the free space itself instead of waiting for
+ * InsufficientSpaceException.  Full pages are numbered consecutively from the
+ * end of the file and held back until an extent of them is complete, which
+ * is then written with a single request, linked behind the last used page
+ * and recorded in the file header.  Free pages of the file are not reused.
+ *
+ * While an appender is open, nothing else may allocate or delete pages of
+ * the file.  New pages go straight to the file, bypassing the buffer pool;
+ * the page they are linked behind is updated through the pool, so that a
+ * copy of it held there stays current.
+ *
+ * @warning This class is not threadsafe.
+ */
+class HeapAppender {
+ public:
+  /**
+   * Default number of pages written in one request.
+   */
+  static const PageId EXTENT_PAGES = 64;
+
+  /**
+   * Starts appending to the end of a file.
+   *
+   * @param file          File to append to.
+   * @param bufMgr        Buffer manager caching pages of the file.
+   * @param extentPages   Number of full pages to collect before writing.
+   */
+  HeapAppender(PageFile* file, BufMgr* bufMgr,
+               const PageId extentPages = EXTENT_PAGES);
+
+  /**
+   * Writes out whatever has not been written yet.  Errors cannot be
+   * reported from here, so callers that need to know call finish() first.
+   */
+  ~HeapAppender();
+
+  /**
+   * Keeps a zone map for the given attribute on every page the appender
+   * starts from now on (see Page::addZoneMap).
+   *
+   * @param offset  Byte offset of the attribute in records.
+   * @param type    Datatype of the attribute.
+   */
+  void addZoneMap(const std::uint16_t offset, const Datatype type);
+
+  /**
+   * Appends a record.
+   *
+   * @param record_data   Bytes that compose the record.
+   * @return  ID the record will have in the file.
+   * @throws  InsufficientSpaceException  If the record does not fit even in
+   *                                      an empty page.
+   */
+  RecordId append(const std::string& record_data);
+
+  /**
+   * Appends records in order.
+   *
+   * @param records   Records to append.
+   * @param rids      IDs of the records, appended to this in the same order.
+   * @throws  InsufficientSpaceException  If a record does not fit even in an
+   *                                      empty page; records before it are
+   *                                      appended.
+   */
+  void append(const std::vector<std::string>& records,
+              std::vector<RecordId>& rids);
+
+  /**
+   * Writes out all records appended so far, including those of the page
+   * being filled, which is closed.  Later records start a new page.
+   */
+  void finish();
+
+  /**
+   * Returns the number of pages the appender has started.
+   */
+  PageId numPages() const { return num_pages_; }
+
+ private:
+  /**
+   * Starts a new page to fill, numbered after the pages held back.
+   */
+  void startPage();
+
+  /**
+   * Holds back the page being filled, writing out the extent if it is full.
+   */
+  void sealPage();
+
+  /**
+   * Writes the pages held back and links them into the file.
+   */
+  void writePending();
+
+  /**
+   * File being appended to.
+   */
+  PageFile* file_;
+
+  /**
+   * Buffer manager through which the last used page is relinked.
+   */
+  BufMgr* buf_mgr_;
+
+  /**
+   * Number of full pages to collect before writing.
+   */
+  PageId extent_pages_;
+
+  /**
+   * Page being filled, if <page_open_>.
+   */
+  Page page_;
+  bool page_open_;
+
+  /**
+   * Full pages not written yet, numbered from <first_pending_> on.
+   */
+  std::vector<Page> pending_;
+  PageId first_pending_;
+
+  /**
+   * Last page of the file's used list on disk, or Page::INVALID_NUMBER.
+   */
+  PageId tail_;
+
+  /**
+   * Number of pages started.
+   */
+  PageId num_pages_;
+
+  /**
+   * Attributes to keep zone maps for on new pages.
+   */
+  std::vector<std::pair<std::uint16_t, Datatype> > zone_maps_;
+};
+
+}
@@ -0,0 +1,162 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "key_codec.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace badgerdb {
+
+namespace {
+
+const std::uint64_t SIGN_BIT = std::uint64_t(1) << 63;
+
+/**
+ * Bits of the positive quiet NaN that stands for every NaN.
+ */
+const std::uint64_t QUIET_NAN = std::uint64_t(0x7ff8) << 48;
+
+void putBigEndian(std::uint64_t bits, const int bytes, char* out) {
+  for (int i = bytes - 1; i >= 0; --i) {
+    out[i] = static_cast<char>(bits & 0xff);
+    bits >>= 8;
+  }
+}
+
+std::uint64_t getBigEndian(const char* in, const int bytes) {
+  std::uint64_t bits = 0;
+  for (int i = 0; i < bytes; ++i) {
+    bits = bits << 8 | static_cast<unsigned char>(in[i]);
+  }
+  return bits;
+}
+
+}
+
+std::uint16_t KeyCodec::width(const Datatype type) {
+  switch (type) {
+    case INTEGER:
+      return sizeof(std::int32_t);
+    case DOUBLE:
+      return sizeof(double);
+    case STRING:
+      return STRINGSIZE;
+  }
+  return 0;
+}
+
+std::uint64_t KeyCodec::normalizeDouble(const double value) {
+  std::uint64_t bits = 0;
+  if (value != value) {
+    bits = QUIET_NAN;
+  } else if (value != 0) {
+    memcpy(&bits, &value, sizeof(bits));
+  }
+  return (bits & SIGN_BIT) ? ~bits : bits | SIGN_BIT;
+}
+
+void KeyCodec::encodeInt(const int value, char* out) {
+  putBigEndian(normalizeInt(value), sizeof(std::int32_t), out);
+}
+
+void KeyCodec::encodeDouble(const double value, char* out) {
+  putBigEndian(normalizeDouble(value), sizeof(double), out);
+}
+
+void KeyCodec::encodeString(const char* value, const std::size_t length,
+                            char* out) {
+  const std::size_t copied = std::min<std::size_t>(length, STRINGSIZE);
+  memcpy(out, value, copied);
+  memset(out + copied, 0, STRINGSIZE - copied);
+}
+
+int KeyCodec::decodeInt(const char* in) {
+  return static_cast<int>(
+      static_cast<std::uint32_t>(getBigEndian(in, sizeof(std::int32_t))) ^
+      0x80000000u);
+}
+
+double KeyCodec::decodeDouble(const char* in) {
+  std::uint64_t bits = getBigEndian(in, sizeof(double));
+  bits = (bits & SIGN_BIT) ? bits & ~SIGN_BIT : ~bits;
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+void KeyCodec::appendInt(std::string& key, const int value) {
+  char bytes[sizeof(std::int32_t)];
+  encodeInt(value, bytes);
+  key.append(bytes, sizeof(bytes));
+}
+
+void KeyCodec::appendDouble(std::string& key, const double value) {
+  char bytes[sizeof(double)];
+  encodeDouble(value, bytes);
+  key.append(bytes, sizeof(bytes));
+}
+
+void KeyCodec::appendString(std::string& key, const std::string& value) {
+  char bytes[STRINGSIZE];
+  encodeString(value.data(), value.length(), bytes);
+  key.append(bytes, sizeof(bytes));
+}
+
+KeyCodec::KeyCodec(const std::vector<IndexAttribute>& components)
+    : components_(components),
+      width_(0) {
+  for (std::size_t i = 0; i < components_.size(); ++i) {
+    width_ += width(components_[i].type);
+  }
+}
+
+void KeyCodec::encodeRecord(const RecordView& record, char* out) const {
+  for (std::size_t i = 0; i < components_.size(); ++i) {
+    const IndexAttribute& component = components_[i];
+    const std::uint16_t component_width = width(component.type);
+    // Gather the attribute first; records need not align it.
+    char field[STRINGSIZE > sizeof(double) ? STRINGSIZE : sizeof(double)];
+    int available = static_cast<int>(record.len) - component.offset;
+    available = std::max(0, std::min<int>(available, component_width));
+    memcpy(field, record.data + component.offset, available);
+    memset(field + available, 0, component_width - available);
+
+    switch (component.type) {
+      case INTEGER: {
+        std::int32_t value;
+        memcpy(&value, field, sizeof(value));
+        encodeInt(value, out);
+        break;
+      }
+      case DOUBLE: {
+        double value;
+        memcpy(&value, field, sizeof(value));
+        encodeDouble(value, out);
+        break;
+      }
+      case STRING:
+        encodeString(field, strnlen(field, STRINGSIZE), out);
+        break;
+    }
+    out += component_width;
+  }
+}
+
+std::string KeyCodec::lowBound(const std::string& prefix) const {
+  std::string key = prefix.substr(0, width_);
+  key.resize(width_, '\0');
+  return key;
+}
+
+std::string KeyCodec::highBound(const std::string& prefix) const {
+  std::string key = prefix.substr(0, width_);
+  key.resize(width_, '\xff');
+  return key;
+}
+
+}
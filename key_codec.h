@@ -0,0 +1,143 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Size of String key.
+ */
+const int STRINGSIZE = 10;
+
+/**
+ * @brief An attribute of the base relation, given by its byte offset in
+ * records and its type.  STRING attributes are STRINGSIZE bytes wide.
+ */
+struct IndexAttribute {
+  int offset;
+  Datatype type;
+};
+
+/**
+ * @brief Encodes keys of one or more attributes into byte strings whose
+ *        memcmp order is the order of the values, component by component.
+ *
+ * INTEGER components are written big-endian with the sign bit flipped.
+ * DOUBLE components are written big-endian with the sign bit flipped if it
+ * is clear and all bits flipped if it is set, so negative numbers sort
+ * before positive ones and larger magnitudes further out.  STRING
+ * components are the attribute up to its first zero byte, at most
+ * STRINGSIZE bytes of it, padded with zeros.  Every component has a fixed
+ * width, so encoded keys of one codec all have width() bytes and a prefix of
+ * the components is a prefix of the bytes.
+ *
+ * To scan all keys whose leading components equal some values, append the
+ * encoded values to a string and take lowBound() and highBound() of it.  To
+ * also bound the next component, append its low value before taking
+ * lowBound() and its high value before taking highBound().
+ */
+class KeyCodec {
+ public:
+  /**
+   * Returns the encoded width of a component of type <type>.
+   */
+  static std::uint16_t width(const Datatype type);
+
+  /**
+   * Returns an unsigned integer whose order is the order of the values, the
+   * number an INTEGER or DOUBLE component is the big-endian form of.  Doubles
+   * are ordered as they compare, and totally: -0.0 normalizes like 0.0, and
+   * every NaN like one quiet NaN, after infinity.
+   */
+  static std::uint32_t normalizeInt(const int value) {
+    return static_cast<std::uint32_t>(value) ^ 0x80000000u;
+  }
+  static std::uint64_t normalizeDouble(const double value);
+
+  static void encodeInt(const int value, char* out);
+  static void encodeDouble(const double value, char* out);
+
+  /**
+   * Encodes the first STRINGSIZE bytes of <value>, padding with zeros if it
+   * has fewer than that.
+   */
+  static void encodeString(const char* value, const std::size_t length,
+                           char* out);
+
+  static int decodeInt(const char* in);
+  static double decodeDouble(const char* in);
+
+  /**
+   * Appends an encoded component to <key>.
+   */
+  static void appendInt(std::string& key, const int value);
+  static void appendDouble(std::string& key, const double value);
+  static void appendString(std::string& key, const std::string& value);
+
+  /**
+   * Constructs a codec without components.
+   */
+  KeyCodec() : width_(0) {}
+
+  /**
+   * Constructs a codec for keys of the given components, most significant
+   * first.
+   */
+  explicit KeyCodec(const std::vector<IndexAttribute>& components);
+
+  /**
+   * Returns the components of keys, most significant first.
+   */
+  const std::vector<IndexAttribute>& components() const {
+    return components_;
+  }
+
+  /**
+   * Returns the number of bytes of an encoded key.
+   */
+  std::uint16_t width() const { return width_; }
+
+  /**
+   * Encodes the key of a record.  Bytes of components past the end of a
+   * short record are taken as zeros.
+   *
+   * @param record  Bytes of the record.
+   * @param out     Buffer of width() bytes receiving the key.
+   */
+  void encodeRecord(const RecordView& record, char* out) const;
+
+  /**
+   * Returns the smallest key starting with <prefix>, which holds encoded
+   * leading components.
+   */
+  std::string lowBound(const std::string& prefix) const;
+
+  /**
+   * Returns the largest key starting with <prefix>.
+   */
+  std::string highBound(const std::string& prefix) const;
+
+ private:
+  /**
+   * Components of keys, most significant first.
+   */
+  std::vector<IndexAttribute> components_;
+
+  /**
+   * Number of bytes of an encoded key.
+   */
+  std::uint16_t width_;
+};
+
+}
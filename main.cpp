@@ -6,11 +6,20 @@
  */
 
 #include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
 #include "btree.h"
 #include "page.h"
 #include "filescan.h"
 #include "page_iterator.h"
 #include "file_iterator.h"
+#include "tuple_layout.h"
+#include "heap_appender.h"
+#include "page_compressor.h"
+#include "rid_bitmap.h"
+#include "key_codec.h"
+#include "prefix_key_node.h"
 #include "exceptions/insufficient_space_exception.h"
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/file_not_found_exception.h"
@@ -19,6 +28,8 @@
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/bad_index_info_exception.h"
+#include "exceptions/bad_file_format_exception.h"
 
 
 #define checkPassFail(a, b) 																				\
@@ -54,6 +65,10 @@ typedef struct tuple {
 	char s[64];
 } RECORD;
 
+typedef TupleLayout<StaticField<int, offsetof(RECORD, i)>,
+                    StaticField<double, offsetof(RECORD, d)>,
+                    StaticField<char[64], offsetof(RECORD, s)> > RecordLayout;
+
 PageFile* file1;
 RecordId rid;
 RECORD record1;
@@ -88,6 +103,18 @@ void test1();
 void test2();
 void test3();
 void errorTests();
+void compressionTests();
+void ridBitmapTests();
+void pageSlotTests();
+void keyCodecTests();
+void compositeTests();
+void stringKeyTests();
+int compositeScan(BTreeIndex *index, const std::string& low, const std::string& high);
+void treeShapeTests();
+void postingTests();
+void packedLeafTests();
+void fileFormatTests();
+void createRelationPosting(int numRecords, int distinctKeys, int copies);
 void deleteRelation();
 
 int main(int argc, char **argv)
@@ -113,7 +140,7 @@ int main(int argc, char **argv)
 			std::cout << "leaf size:" << DOUBLEARRAYLEAFSIZE << " non-leaf size:" << DOUBLEARRAYNONLEAFSIZE << std::endl;
 			break;
 		case 3:
-			std::cout << "leaf size:" << STRINGARRAYLEAFSIZE << " non-leaf size:" << STRINGARRAYNONLEAFSIZE << std::endl;
+			std::cout << "leaf and non-leaf size: as many keys as fit, each up to " << PrefixKeyNode::MAX_KEY_LENGTH << " bytes" << std::endl;
 			break;
 	}
 
@@ -159,9 +186,8 @@ int main(int argc, char **argv)
 			{
 				fscan.scanNext(scanRid);
 				//Assuming RECORD.i is our key, lets extract the key, which we know is INTEGER and whose byte offset is also know inside the record. 
-				std::string recordStr = fscan.getRecord();
-				const char *record = recordStr.c_str();
-				int key = *((int *)(record + offsetof (RECORD, i)));
+				const char *record = fscan.getRecordView().data;
+				int key = RecordLayout::get<0>(record);
 				std::cout << "Extracted : " << key << std::endl;
 			}
 		}
@@ -177,6 +203,16 @@ int main(int argc, char **argv)
 	test1();
 	test2();
 	test3();
+	compressionTests();
+	ridBitmapTests();
+	pageSlotTests();
+	keyCodecTests();
+	compositeTests();
+	stringKeyTests();
+	treeShapeTests();
+	postingTests();
+	packedLeafTests();
+	fileFormatTests();
 	//errorTests();
 
 	delete bufMgr;
@@ -236,8 +272,7 @@ void createRelationForward()
 
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+	HeapAppender appender(file1, bufMgr);
 
   // Insert a bunch of tuples into the relation.
   for(int i = 0; i < relationSize; i++ )
@@ -247,22 +282,10 @@ void createRelationForward()
     record1.d = (double)i;
     std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
 
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
+    appender.append(new_data);
   }
 
-	file1->writePage(new_page_number, new_page);
+	appender.finish();
 }
 
 // -----------------------------------------------------------------------------
@@ -283,8 +306,7 @@ void createRelationBackward()
 
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+	HeapAppender appender(file1, bufMgr);
 
   // Insert a bunch of tuples into the relation.
   for(int i = relationSize - 1; i >= 0; i-- )
@@ -295,22 +317,10 @@ void createRelationBackward()
 
     std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
 
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
+    appender.append(new_data);
   }
 
-	file1->writePage(new_page_number, new_page);
+	appender.finish();
 }
 
 // -----------------------------------------------------------------------------
@@ -331,8 +341,7 @@ void createRelationRandom()
 
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+	HeapAppender appender(file1, bufMgr);
 
   // insert records in random order
 
@@ -355,19 +364,7 @@ void createRelationRandom()
 
     std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
 
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-      	file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
+    appender.append(new_data);
 
 		int temp = intvec[relationSize-1-i];
 		intvec[relationSize-1-i] = intvec[pos];
@@ -375,7 +372,7 @@ void createRelationRandom()
 		i++;
   }
   
-	file1->writePage(new_page_number, new_page);
+	appender.finish();
 }
 
 // -----------------------------------------------------------------------------
@@ -683,8 +680,7 @@ void errorTests()
 	
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+	HeapAppender appender(file1, bufMgr);
 
   // Insert a bunch of tuples into the relation.
 	for(int i = 0; i <10; i++ ) 
@@ -694,22 +690,10 @@ void errorTests()
     record1.d = (double)i;
     std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
 
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
+    appender.append(new_data);
   }
 
-	file1->writePage(new_page_number, new_page);
+	appender.finish();
 
   BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
 	
@@ -777,6 +761,925 @@ void errorTests()
 	deleteRelation();
 }
 
+// -----------------------------------------------------------------------------
+// compressionTests
+// -----------------------------------------------------------------------------
+
+void compressionTests()
+{
+	std::cout << "Compression tests" << std::endl;
+	std::cout << "-----------------" << std::endl;
+
+	// A page of sorted keys, which shrinks, and a page of noise, which is stored verbatim
+	Page sorted;
+	Page noise;
+	std::string keys;
+	for(int i = 0; i < 1000; i++)
+	{
+		keys.append(reinterpret_cast<const char*>(&i), sizeof(int));
+	}
+	sorted.insertRecord(keys);
+	std::string bytes(4000, ' ');
+	srand(1);
+	for(std::size_t i = 0; i < bytes.size(); i++)
+	{
+		bytes[i] = (char)(rand() & 0xff);
+	}
+	noise.insertRecord(bytes);
+
+	int mismatches = 0;
+	std::vector<char> image(PageCompressor::MAX_COMPRESSED_SIZE);
+	const Page* pages[] = {&sorted, &noise};
+	for(int i = 0; i < 2; i++)
+	{
+		const std::size_t length = PageCompressor::compress(*pages[i], &image[0]);
+		Page restored;
+		if(length > PageCompressor::MAX_COMPRESSED_SIZE || !PageCompressor::decompress(&image[0], length, &restored)
+			|| memcmp((const char*)pages[i], (const char*)&restored, Page::SIZE) != 0)
+		{
+			mismatches++;
+		}
+		if(i == 0 && length >= Page::SIZE / 2)
+		{
+			mismatches++;
+		}
+	}
+	checkPassFail(mismatches, 0)
+
+	// A compressed index answers the same scans, also after it is reopened
+	createRelationForward();
+	{
+		IndexOptions options;
+		options.compressed = true;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	}
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intScan(&index,996,GT,1001,LT), 4)
+		checkPassFail(intScan(&index,0,GTE,relationSize,LT), relationSize)
+	}
+	File::remove(intIndexName);
+	deleteRelation();
+}
+
+// -----------------------------------------------------------------------------
+// ridBitmapTests
+// -----------------------------------------------------------------------------
+
+void ridBitmapTests()
+{
+	std::cout << "RidBitmap tests" << std::endl;
+	std::cout << "---------------" << std::endl;
+
+	// Page 1 is dense in both sets, page 2 sparse in both and page 3 dense in one and sparse in the other
+	RidBitmap a, b;
+	for(SlotId s = 1; s <= 2000; s++)
+	{
+		a.add(RecordId{1, s});
+		if(s % 2 == 0)
+		{
+			b.add(RecordId{1, s});
+		}
+		a.add(RecordId{3, s});
+	}
+	const SlotId aSparse[] = {3, 7, 500};
+	const SlotId bSparse[] = {7, 9};
+	for(int i = 0; i < 3; i++)
+	{
+		a.add(RecordId{2, aSparse[i]});
+		b.add(RecordId{3, aSparse[i]});
+	}
+	for(int i = 0; i < 2; i++)
+	{
+		b.add(RecordId{2, bSparse[i]});
+	}
+	b.add(RecordId{4, 1});
+	a.add(RecordId{1, 1});
+	checkPassFail((int)a.cardinality(), 4003)
+	checkPassFail((int)b.cardinality(), 1006)
+
+	RidBitmap both = a;
+	both &= b;
+	// evens of page 1, slot 7 of page 2, the three slots of page 3
+	checkPassFail((int)both.cardinality(), 1004)
+	checkPassFail((int)both.numPages(), 3)
+	checkPassFail((int)both.contains(RecordId{2, 7}), 1)
+	checkPassFail((int)both.contains(RecordId{1, 3}), 0)
+
+	RidBitmap either = a;
+	either |= b;
+	checkPassFail((int)either.cardinality(), 4005)
+	checkPassFail((int)either.contains(RecordId{4, 1}), 1)
+
+	// Iteration is in RecordId order and agrees with the cardinality
+	std::vector<RecordId> rids;
+	either.toRids(rids);
+	int unordered = 0;
+	for(std::size_t i = 1; i < rids.size(); i++)
+	{
+		if(rids[i - 1].page_number > rids[i].page_number ||
+			(rids[i - 1].page_number == rids[i].page_number && rids[i - 1].slot_number >= rids[i].slot_number))
+		{
+			unordered++;
+		}
+	}
+	checkPassFail((int)rids.size(), (int)either.cardinality())
+	checkPassFail(unordered, 0)
+
+	// Sets from two range scans of an index intersect to the overlap of the ranges
+	createRelationForward();
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		int low = 100, mid = 200, high = 300, top = 400;
+		index.startScan(&low, GTE, &high, LT);
+		RidBitmap first = RidBitmap::fromIndexScan(&index);
+		index.endScan();
+		index.startScan(&mid, GTE, &top, LT);
+		RidBitmap second = RidBitmap::fromIndexScan(&index);
+		index.endScan();
+		first &= second;
+		checkPassFail((int)first.cardinality(), 100)
+	}
+	File::remove(intIndexName);
+	deleteRelation();
+}
+
+// -----------------------------------------------------------------------------
+// pageSlotTests
+// -----------------------------------------------------------------------------
+
+void pageSlotTests()
+{
+	std::cout << "Page slot tests" << std::endl;
+	std::cout << "---------------" << std::endl;
+
+	Page page;
+	std::vector<RecordId> rids;
+	std::vector<std::string> records;
+	std::string record(100, ' ');
+	while(page.hasSpaceForRecord(record))
+	{
+		record[0] = (char)('a' + records.size() % 26);
+		rids.push_back(page.insertRecord(record));
+		records.push_back(record);
+	}
+	const std::size_t numSlots = rids.size();
+
+	// Free every other record but the last, leaving holes too small for a bigger record
+	const std::uint16_t before = page.getFreeSpace();
+	std::size_t freed = 0;
+	for(std::size_t i = 0; i + 1 < numSlots; i += 2)
+	{
+		page.deleteRecord(rids[i]);
+		records[i].clear();
+		freed++;
+	}
+	checkPassFail((int)page.getFreeSpace(), (int)(before + freed * record.size()))
+
+	// Only a compaction makes room for it, and it takes a freed slot
+	std::string wide(150, 'w');
+	RecordId wideRid = page.insertRecord(wide);
+	checkPassFail((int)(wideRid.slot_number <= numSlots && records[wideRid.slot_number - 1].empty()), 1)
+	records[wideRid.slot_number - 1] = wide;
+
+	// The rest of the space is filled through the free slot list, without new slots
+	std::size_t reused = 0;
+	int newSlots = 0;
+	record.assign(100, 'r');
+	while(page.hasSpaceForRecord(record))
+	{
+		RecordId r = page.insertRecord(record);
+		if(r.slot_number <= numSlots && records[r.slot_number - 1].empty())
+		{
+			reused++;
+			records[r.slot_number - 1] = record;
+		}
+		else
+		{
+			newSlots++;
+		}
+	}
+	checkPassFail(newSlots, 0)
+	checkPassFail((int)(page.getFreeSpace() < record.size()), 1)
+
+	// Records that were never deleted survive the compaction unchanged
+	int mismatches = 0;
+	std::size_t used = 0;
+	for(PageIterator it = page.begin(); it != page.end(); it++)
+	{
+		RecordId r = it.getCurrentRecord();
+		if(r.slot_number > numSlots || *it != records[r.slot_number - 1])
+		{
+			mismatches++;
+		}
+		used++;
+	}
+	checkPassFail(mismatches, 0)
+	checkPassFail((int)used, (int)(numSlots - freed + 1 + reused))
+}
+
+// -----------------------------------------------------------------------------
+// keyCodecTests
+// -----------------------------------------------------------------------------
+
+void keyCodecTests()
+{
+	std::cout << "KeyCodec tests" << std::endl;
+	std::cout << "--------------" << std::endl;
+
+	// Encoded keys compare with memcmp in the order of their values
+	const double doubles[] = {-1e300, -2.5, -1.0, -1e-300, 0.0, 1e-300, 1.0, 2.5, 1e300};
+	const int ints[] = {-2147483647 - 1, -1000, -1, 0, 1, 1000, 2147483647};
+	int misordered = 0;
+	char previous[sizeof(double)];
+	char current[sizeof(double)];
+	for(std::size_t i = 0; i < sizeof(doubles) / sizeof(double); i++)
+	{
+		KeyCodec::encodeDouble(doubles[i], current);
+		if((i > 0 && memcmp(previous, current, sizeof(double)) >= 0) || KeyCodec::decodeDouble(current) != doubles[i] ||
+			std::signbit(KeyCodec::decodeDouble(current)) != std::signbit(doubles[i]))
+		{
+			misordered++;
+		}
+		memcpy(previous, current, sizeof(double));
+	}
+	for(std::size_t i = 0; i < sizeof(ints) / sizeof(int); i++)
+	{
+		KeyCodec::encodeInt(ints[i], current);
+		if((i > 0 && memcmp(previous, current, sizeof(int)) >= 0) || KeyCodec::decodeInt(current) != ints[i])
+		{
+			misordered++;
+		}
+		memcpy(previous, current, sizeof(int));
+	}
+	checkPassFail(misordered, 0)
+
+	// -0.0 encodes like 0.0, and every NaN alike, after infinity
+	char zero[sizeof(double)], negativeZero[sizeof(double)];
+	char nan[sizeof(double)], negativeNan[sizeof(double)], infinity[sizeof(double)];
+	KeyCodec::encodeDouble(0.0, zero);
+	KeyCodec::encodeDouble(-0.0, negativeZero);
+	KeyCodec::encodeDouble(std::nan(""), nan);
+	KeyCodec::encodeDouble(-std::nan(""), negativeNan);
+	KeyCodec::encodeDouble(HUGE_VAL, infinity);
+	checkPassFail(memcmp(zero, negativeZero, sizeof(double)), 0)
+	checkPassFail(memcmp(nan, negativeNan, sizeof(double)), 0)
+	checkPassFail((int)(memcmp(infinity, nan, sizeof(double)) < 0), 1)
+
+	// Composite keys order by their first component, then their second
+	std::vector<std::string> composite(5);
+	KeyCodec::appendInt(composite[0], -1);
+	KeyCodec::appendDouble(composite[0], 5.0);
+	KeyCodec::appendInt(composite[1], 0);
+	KeyCodec::appendDouble(composite[1], -3.0);
+	KeyCodec::appendInt(composite[2], 0);
+	KeyCodec::appendDouble(composite[2], -1e-300);
+	KeyCodec::appendInt(composite[3], 0);
+	KeyCodec::appendDouble(composite[3], 0.0);
+	KeyCodec::appendInt(composite[4], 1);
+	KeyCodec::appendDouble(composite[4], -1e300);
+	checkPassFail((int)std::is_sorted(composite.begin(), composite.end()), 1)
+	checkPassFail((int)composite[0].size(), (int)(sizeof(int) + sizeof(double)))
+
+	// An index orders DOUBLE keys as they are encoded, with or without posting lists: -0.0 and 0.0 are one key
+	file1 = new PageFile(relationName, true);
+	memset(record1.s, ' ', sizeof(record1.s));
+	{
+		HeapAppender appender(file1, bufMgr);
+		for(int k = 0; k < 2000; k++)
+		{
+			sprintf(record1.s, "%05d string record", k);
+			record1.i = k;
+			record1.d = k % 2 == 0 ? -0.0 : 0.0;
+			appender.append(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+		}
+		appender.finish();
+	}
+	for(int posting = 0; posting < 2; posting++)
+	{
+		IndexOptions options;
+		options.postingLists = posting == 1;
+		std::string zeroIndexName;
+		{
+			BTreeIndex index(relationName, zeroIndexName, bufMgr, offsetof(tuple,d), DOUBLE, options);
+			checkPassFail(doubleScan(&index,0.0,GTE,0.0,LTE), 2000)
+			checkPassFail(doubleScan(&index,-0.0,GTE,-0.0,LTE), 2000)
+			checkPassFail(doubleScan(&index,-0.0,GTE,1.0,LT), 2000)
+			checkPassFail(doubleScan(&index,-1.0,GT,-0.0,LT), 0)
+
+			// a NaN bounds no range
+			try
+			{
+				const double low = 0.0;
+				const double high = std::nan("");
+				index.startScan(&low, GTE, &high, LTE);
+				checkPassFail(1, 0)
+			}
+			catch(BadScanrangeException e)
+			{
+			}
+		}
+		File::remove(zeroIndexName);
+	}
+	deleteRelation();
+}
+
+// -----------------------------------------------------------------------------
+// compositeTests
+// -----------------------------------------------------------------------------
+
+void compositeTests()
+{
+	std::cout << "Composite key tests" << std::endl;
+	std::cout << "-------------------" << std::endl;
+
+	// (INTEGER, DOUBLE) keys encode to 12 bytes, more than a STRING key holds
+	std::vector<IndexAttribute> keyAttrs(2);
+	keyAttrs[0].offset = offsetof(tuple,i);
+	keyAttrs[0].type = INTEGER;
+	keyAttrs[1].offset = offsetof(tuple,d);
+	keyAttrs[1].type = DOUBLE;
+	KeyCodec codec(keyAttrs);
+	checkPassFail((int)codec.width(), 12)
+
+	createRelationForward();
+	std::string compositeIndexName;
+	for(int reopen = 0; reopen < 2; reopen++)
+	{
+		BTreeIndex index(relationName, compositeIndexName, bufMgr, keyAttrs);
+
+		// a range on the leading component
+		std::string low, high;
+		KeyCodec::appendInt(low, 25);
+		KeyCodec::appendInt(high, 40);
+		checkPassFail(compositeScan(&index, codec.lowBound(low), codec.highBound(high)), 16)
+
+		// equality on the leading component with a range on the next
+		std::string prefix;
+		KeyCodec::appendInt(prefix, 3000);
+		low = prefix;
+		high = prefix;
+		KeyCodec::appendDouble(low, 2999.5);
+		KeyCodec::appendDouble(high, 3000.0);
+		checkPassFail(compositeScan(&index, low, high), 1)
+		KeyCodec::appendDouble(prefix, 3000.5);
+		checkPassFail(compositeScan(&index, prefix, codec.highBound(prefix)), 0)
+
+		checkPassFail(compositeScan(&index, codec.lowBound(""), codec.highBound("")), relationSize)
+	}
+	File::remove(compositeIndexName);
+	deleteRelation();
+}
+
+int compositeScan(BTreeIndex * index, const std::string& low, const std::string& high)
+{
+	RecordId scanRid;
+	RecordView scanKey;
+	int numResults = 0;
+	int badKeys = 0;
+	try
+	{
+		index->startScan(low.data(), GTE, high.data(), LTE);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+
+	// every key returned is the encoding of its record's attributes, within the bounds
+	while(1)
+	{
+		try
+		{
+			index->scanNext(scanRid, scanKey);
+		}
+		catch(IndexScanCompletedException e)
+		{
+			break;
+		}
+		Page *curPage;
+		bufMgr->readPage(file1, scanRid.page_number, curPage);
+		RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+		bufMgr->unPinPage(file1, scanRid.page_number, false);
+		std::string expected;
+		KeyCodec::appendInt(expected, myRec.i);
+		KeyCodec::appendDouble(expected, myRec.d);
+		const std::string key(scanKey.data, scanKey.len);
+		if(key != expected || key < low || key > high)
+		{
+			badKeys++;
+		}
+		numResults++;
+	}
+	index->endScan();
+	checkPassFail(badKeys, 0)
+	return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// stringKeyTests
+// -----------------------------------------------------------------------------
+
+void stringKeyTests()
+{
+	std::cout << "String key tests" << std::endl;
+	std::cout << "----------------" << std::endl;
+
+	// Keys much longer than STRINGSIZE that differ only after a long shared prefix, each twice
+	const char* format = "https://www.example.com/users/%05d/profile";
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	file1 = new PageFile(relationName, true);
+	memset(record1.s, ' ', sizeof(record1.s));
+	{
+		HeapAppender appender(file1, bufMgr);
+		for(int i = 0; i < 2 * relationSize; i++)
+		{
+			sprintf(record1.s, format, i / 2);
+			record1.i = i / 2;
+			record1.d = (double)i;
+			appender.append(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+		}
+		appender.finish();
+	}
+
+	std::string urlIndexName;
+	{
+		BTreeIndex index(relationName, urlIndexName, bufMgr, offsetof(tuple,s), STRING);
+		char low[64], high[64];
+
+		// keys are held whole: a range between two of them
+		sprintf(low, format, 25);
+		sprintf(high, format, 40);
+		index.startScan(low, GT, high, LT);
+		int numResults = 0;
+		int badKeys = 0;
+		try
+		{
+			while(1)
+			{
+				RecordId scanRid;
+				RecordView scanKey;
+				index.scanNext(scanRid, scanKey);
+				Page *curPage;
+				bufMgr->readPage(file1, scanRid.page_number, curPage);
+				RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+				bufMgr->unPinPage(file1, scanRid.page_number, false);
+				if(std::string(scanKey.data, scanKey.len) != myRec.s)
+				{
+					badKeys++;
+				}
+				numResults++;
+			}
+		}
+		catch(IndexScanCompletedException e)
+		{
+		}
+		index.endScan();
+		checkPassFail(numResults, 2 * 14)
+		checkPassFail(badKeys, 0)
+
+		// every key starting with a prefix
+		index.startScan("https://www.example.com/users/001", GTE, "https://www.example.com/users/001\xff", LTE);
+		numResults = 0;
+		try
+		{
+			while(1)
+			{
+				RecordId scanRid;
+				index.scanNext(scanRid);
+				numResults++;
+			}
+		}
+		catch(IndexScanCompletedException e)
+		{
+		}
+		index.endScan();
+		checkPassFail(numResults, 2 * 100)
+
+		// a key equal to a whole one, but for the first STRINGSIZE bytes, matches nothing
+		try
+		{
+			index.startScan("https://www.example.com/", GTE, "https://www.example.com/", LTE);
+			checkPassFail(1, 0)
+		}
+		catch(NoSuchKeyFoundException e)
+		{
+		}
+	}
+
+	// the shared prefix is stored once per node, so the leaves take less than the whole keys would
+	std::ifstream indexFile(urlIndexName.c_str(), std::ios::binary | std::ios::ate);
+	const int numPages = (int)(((std::size_t)indexFile.tellg() - sizeof(FileHeader)) / Page::SIZE);
+	indexFile.close();
+	const int wholeKeyPages = 2 * relationSize * (int)(strlen(record1.s) + sizeof(RecordId)) / Page::SIZE;
+	checkPassFail((int)(numPages < wholeKeyPages), 1)
+	File::remove(urlIndexName);
+	deleteRelation();
+
+	// A run of equal long keys between two others fills a leaf, which splits inside the run
+	file1 = new PageFile(relationName, true);
+	const std::string runKey(100, 'b');
+	{
+		HeapAppender appender(file1, bufMgr);
+		appender.append(std::string("a", 2));
+		appender.append(std::string("c", 2));
+		for(int i = 0; i < 200; i++)
+		{
+			appender.append(runKey + '\0');
+		}
+		appender.finish();
+	}
+	std::string runIndexName;
+	{
+		BTreeIndex index(relationName, runIndexName, bufMgr, 0, STRING);
+		const char* lows[] = {runKey.c_str(), "a"};
+		const char* highs[] = {runKey.c_str(), "c"};
+		const int expected[] = {200, 202};
+		for(int i = 0; i < 2; i++)
+		{
+			index.startScan(lows[i], GTE, highs[i], LTE);
+			int numResults = 0;
+			try
+			{
+				while(1)
+				{
+					RecordId scanRid;
+					index.scanNext(scanRid);
+					numResults++;
+				}
+			}
+			catch(IndexScanCompletedException e)
+			{
+			}
+			index.endScan();
+			checkPassFail(numResults, expected[i])
+		}
+	}
+	File::remove(runIndexName);
+	deleteRelation();
+}
+
+// -----------------------------------------------------------------------------
+// treeShapeTests
+// -----------------------------------------------------------------------------
+
+void treeShapeTests()
+{
+	std::cout << "Tree shape tests" << std::endl;
+	std::cout << "----------------" << std::endl;
+
+	// Keys inserted in increasing order fill every leaf, instead of leaving them half empty
+	createRelationForward();
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intScan(&index,0,GTE,relationSize,LT), relationSize)
+	}
+	std::ifstream indexFile(intIndexName.c_str(), std::ios::binary | std::ios::ate);
+	const int numPages = (int)(((std::size_t)indexFile.tellg() - sizeof(FileHeader)) / Page::SIZE);
+	indexFile.close();
+	// header page, root and full leaves
+	checkPassFail(numPages, 2 + (relationSize + INTARRAYLEAFSIZE - 1) / INTARRAYLEAFSIZE)
+	File::remove(intIndexName);
+	deleteRelation();
+}
+
+// -----------------------------------------------------------------------------
+// postingTests
+// -----------------------------------------------------------------------------
+
+void postingTests()
+{
+	std::cout << "Posting list tests" << std::endl;
+	std::cout << "------------------" << std::endl;
+
+	IndexOptions options;
+	options.postingLists = true;
+
+	// Three keys of 5000 records each: every posting list spills to overflow pages
+	createRelationPosting(3 * relationSize, 3, 1);
+	std::string plainIndexName;
+	{
+		BTreeIndex index(relationName, plainIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intScan(&index,1,GTE,1,LTE), relationSize)
+	}
+	std::ifstream plainFile(plainIndexName.c_str(), std::ios::binary | std::ios::ate);
+	const int plainPages = (int)(((std::size_t)plainFile.tellg() - sizeof(FileHeader)) / Page::SIZE);
+	plainFile.close();
+	File::remove(plainIndexName);
+
+	// the same index with a posting list per key
+	std::string postingIndexName;
+	{
+		BTreeIndex index(relationName, postingIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail(intScan(&index,1,GTE,1,LTE), relationSize)
+		checkPassFail(intScan(&index,0,GTE,2,LTE), 3 * relationSize)
+		checkPassFail(intScan(&index,0,GT,2,LT), relationSize)
+		checkPassFail(intScan(&index,3,GTE,100,LTE), 0)
+	}
+	std::ifstream postingFile(postingIndexName.c_str(), std::ios::binary | std::ios::ate);
+	const int postingPages = (int)(((std::size_t)postingFile.tellg() - sizeof(FileHeader)) / Page::SIZE);
+	postingFile.close();
+	// each RecordId takes about a byte instead of a key and a whole RecordId
+	checkPassFail((int)(postingPages * 4 < plainPages), 1)
+
+	{
+		// the index keeps its posting lists when reopened without the option
+		BTreeIndex index(relationName, postingIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+		// keys come back from the leaves
+		const int lowKey = 0;
+		const int highKey = 2;
+		index.startScan(&lowKey, GTE, &highKey, LTE);
+		int badKeys = 0;
+		try
+		{
+			while(1)
+			{
+				RecordId scanRid;
+				int scanKey;
+				index.scanNext(scanRid, scanKey);
+				Page *curPage;
+				bufMgr->readPage(file1, scanRid.page_number, curPage);
+				RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+				bufMgr->unPinPage(file1, scanRid.page_number, false);
+				if(scanKey != myRec.i)
+				{
+					badKeys++;
+				}
+			}
+		}
+		catch(IndexScanCompletedException e)
+		{
+		}
+		index.endScan();
+		checkPassFail(badKeys, 0)
+
+		// every record again under a new key, last first, so each RecordId goes before those of the spilled list
+		std::vector<RecordId> rids;
+		{
+			FileScan scanner(relationName, bufMgr);
+			try
+			{
+				RecordId scanRid;
+				while(1)
+				{
+					scanner.scanNext(scanRid);
+					rids.push_back(scanRid);
+				}
+			}
+			catch(EndOfFileException e)
+			{
+			}
+		}
+		const int key = 7;
+		for(int i = (int)rids.size() - 1; i >= 0; i--)
+		{
+			index.insertEntry(&key, rids[i]);
+		}
+		// a pair already there is not added again
+		index.insertEntry(&key, rids[0]);
+		checkPassFail(intScan(&index,7,GTE,7,LTE), 3 * relationSize)
+		checkPassFail(intScan(&index,1,GTE,7,LTE), 5 * relationSize)
+	}
+	File::remove(postingIndexName);
+	deleteRelation();
+
+	// Leaves holding the lists of many keys split between keys
+	createRelationPosting(2 * relationSize, relationSize, 2);
+	{
+		BTreeIndex index(relationName, postingIndexName, bufMgr, offsetof(tuple,s), STRING, options);
+		checkPassFail(stringScan(&index,25,GT,40,LT), 2 * 14)
+		checkPassFail(stringScan(&index,0,GTE,relationSize,LT), 2 * relationSize)
+		checkPassFail(stringScan(&index,4990,GTE,relationSize,LT), 2 * 10)
+	}
+	std::ifstream splitFile(postingIndexName.c_str(), std::ios::binary | std::ios::ate);
+	const int splitPages = (int)(((std::size_t)splitFile.tellg() - sizeof(FileHeader)) / Page::SIZE);
+	splitFile.close();
+	// header page, root and more than one leaf
+	checkPassFail((int)(splitPages > 3), 1)
+	File::remove(postingIndexName);
+
+	// posting lists have no room for included attributes
+	std::vector<IndexAttribute> includedAttrs(1);
+	includedAttrs[0].offset = offsetof(tuple,d);
+	includedAttrs[0].type = DOUBLE;
+	try
+	{
+		BTreeIndex index(relationName, postingIndexName, bufMgr, offsetof(tuple,i), INTEGER, includedAttrs, options);
+		checkPassFail(1, 0)
+	}
+	catch(BadIndexInfoException e)
+	{
+	}
+	deleteRelation();
+}
+
+// -----------------------------------------------------------------------------
+// packedLeafTests
+// -----------------------------------------------------------------------------
+
+void packedLeafTests()
+{
+	std::cout << "Packed leaf tests" << std::endl;
+	std::cout << "-----------------" << std::endl;
+
+	IndexOptions options;
+	options.packedLeaves = true;
+
+	// Dense keys over clustered records pack into far fewer leaves
+	createRelationForward();
+	std::string packedIndexName;
+	{
+		BTreeIndex index(relationName, packedIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
+		checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+		checkPassFail(intScan(&index,996,GT,1001,LT), 4)
+		checkPassFail(intScan(&index,0,GT,1,LT), 0)
+		checkPassFail(intScan(&index,300,GT,400,LT), 99)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+	}
+	std::ifstream packedFile(packedIndexName.c_str(), std::ios::binary | std::ios::ate);
+	const int packedPages = (int)(((std::size_t)packedFile.tellg() - sizeof(FileHeader)) / Page::SIZE);
+	packedFile.close();
+	// header page, root and leaves of two entries for each of a LeafNodeInt
+	checkPassFail((int)(packedPages - 2 <= (relationSize / INTARRAYLEAFSIZE + 1) / 2), 1)
+	File::remove(packedIndexName);
+	deleteRelation();
+
+	// Keys in random order split leaves in the middle
+	createRelationRandom();
+	for(int reopen = 0; reopen < 2; reopen++)
+	{
+		// the index keeps its packed leaves when reopened without the option
+		BTreeIndex index(relationName, packedIndexName, bufMgr, offsetof(tuple,i), INTEGER,
+			reopen == 0 ? options : IndexOptions());
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+		checkPassFail(intScan(&index,0,GTE,relationSize,LT), relationSize)
+
+		// keys come back from the leaves, in order
+		const int lowKey = 0;
+		const int highKey = relationSize;
+		index.startScan(&lowKey, GTE, &highKey, LT);
+		int badKeys = 0;
+		int expected = 0;
+		try
+		{
+			while(1)
+			{
+				RecordId scanRid;
+				int scanKey;
+				index.scanNext(scanRid, scanKey);
+				Page *curPage;
+				bufMgr->readPage(file1, scanRid.page_number, curPage);
+				RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+				bufMgr->unPinPage(file1, scanRid.page_number, false);
+				if(scanKey != myRec.i || scanKey != expected)
+				{
+					badKeys++;
+				}
+				expected++;
+			}
+		}
+		catch(IndexScanCompletedException e)
+		{
+		}
+		index.endScan();
+		checkPassFail(badKeys, 0)
+	}
+	File::remove(packedIndexName);
+
+	// packed leaves hold INTEGER keys only
+	try
+	{
+		BTreeIndex index(relationName, packedIndexName, bufMgr, offsetof(tuple,d), DOUBLE, options);
+		checkPassFail(1, 0)
+	}
+	catch(BadIndexInfoException e)
+	{
+	}
+	deleteRelation();
+
+	// A leaf of equal keys split by a distant key keeps every entry, though its halves pack at different widths
+	file1 = new PageFile(relationName, true);
+	memset(record1.s, ' ', sizeof(record1.s));
+	{
+		HeapAppender appender(file1, bufMgr);
+		for(int k = 0; k < 3002; k++)
+		{
+			record1.i = k < 3000 ? 7 : (k == 3000 ? 2000000000 : 1999999999);
+			record1.d = (double)record1.i;
+			sprintf(record1.s, "%05d string record", k);
+			appender.append(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+		}
+		appender.finish();
+	}
+	{
+		BTreeIndex index(relationName, packedIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail(intScan(&index,7,GTE,7,LTE), 3000)
+		checkPassFail(intScan(&index,1999999999,GTE,2000000000,LTE), 2)
+	}
+	File::remove(packedIndexName);
+	deleteRelation();
+}
+
+// -----------------------------------------------------------------------------
+// fileFormatTests
+// -----------------------------------------------------------------------------
+
+void fileFormatTests()
+{
+	std::cout << "File format tests" << std::endl;
+	std::cout << "-----------------" << std::endl;
+
+	// An unversioned file, with the 16-byte header and one page, and a file of a later version are refused
+	const std::string formatFileName = "relA.format";
+	try
+	{
+		File::remove(formatFileName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	const PageId unversioned[4] = {2, 1, 0, 0};
+	FileHeader later = {FILE_MAGIC, FILE_FORMAT_VERSION + 1, 1, 0, 0, 0, 0};
+	const std::string headers[2] = {
+		std::string(reinterpret_cast<const char*>(unversioned), sizeof(unversioned)) + std::string(Page::SIZE, '\0'),
+		std::string(reinterpret_cast<const char*>(&later), sizeof(later))};
+	for(int i = 0; i < 2; i++)
+	{
+		{
+			std::ofstream out(formatFileName.c_str(), std::ios::binary);
+			out.write(headers[i].data(), headers[i].size());
+		}
+		int refused = 0;
+		try
+		{
+			PageFile file = PageFile::open(formatFileName);
+		}
+		catch(BadFileFormatException e)
+		{
+			refused++;
+		}
+		checkPassFail(refused, 1)
+		checkPassFail(File::isOpen(formatFileName), false)
+		File::remove(formatFileName);
+	}
+
+	// Files of the current version open as before
+	PageId pageNumber;
+	{
+		PageFile file = PageFile::create(formatFileName);
+		Page page = file.allocatePage(pageNumber);
+		page.insertRecord("versioned");
+		file.writePage(pageNumber, page);
+	}
+	{
+		PageFile file = PageFile::open(formatFileName);
+		const RecordId recordId = {pageNumber, 1};
+		checkPassFail(file.readPage(pageNumber).getRecord(recordId), "versioned")
+	}
+	File::remove(formatFileName);
+}
+
+// -----------------------------------------------------------------------------
+// createRelationPosting
+// -----------------------------------------------------------------------------
+
+void createRelationPosting(int numRecords, int distinctKeys, int copies)
+{
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	file1 = new PageFile(relationName, true);
+	memset(record1.s, ' ', sizeof(record1.s));
+	{
+		HeapAppender appender(file1, bufMgr);
+		for(int k = 0; k < numRecords; k++)
+		{
+			const int key = (k / copies) % distinctKeys;
+			sprintf(record1.s, "%05d string record", key);
+			record1.i = key;
+			record1.d = (double)key;
+			appender.append(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+		}
+		appender.finish();
+	}
+}
+
 void deleteRelation()
 {
 	if(file1)
@@ -0,0 +1,334 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "packed_int_leaf.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "filter_kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BADGERDB_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Bytes after the packed arrays, so that extracting the last value may read
+ * a whole word past it.
+ */
+const std::size_t SLACK = 8;
+
+/**
+ * Widest delta the AVX2 unpacker handles: a value plus its shift within a
+ * byte must fit the 32 bits gathered.
+ */
+const unsigned MAX_GATHER_BITS = 25;
+
+/**
+ * Returns the number of bits needed for values up to <value>.
+ */
+unsigned bitsFor(std::uint32_t value) {
+  unsigned bits = 0;
+  while (value != 0) {
+    ++bits;
+    value >>= 1;
+  }
+  return bits;
+}
+
+/**
+ * Returns the number of bytes of <count> packed values of <bits> bits,
+ * rounded up to whole 32-bit words.
+ */
+std::size_t packedBytes(const std::size_t count, const unsigned bits) {
+  return (count * bits + 31) / 32 * 4;
+}
+
+std::size_t leafSize(const std::size_t count, const unsigned key_bits,
+                     const unsigned page_bits) {
+  return sizeof(PackedIntLeafHeader) + packedBytes(count, key_bits) +
+         packedBytes(count, page_bits) + count * sizeof(SlotId) + SLACK;
+}
+
+std::uint32_t lowBits(const unsigned bits) {
+  return bits == 32 ? 0xffffffffu : (std::uint32_t(1) << bits) - 1;
+}
+
+/**
+ * Returns packed value i of <bits> bits.  Bits are numbered from the least
+ * significant of the first byte.
+ */
+inline std::uint32_t extract(const char* data, const std::size_t i,
+                             const unsigned bits) {
+  if (bits == 0) {
+    return 0;
+  }
+  const std::size_t bit = i * bits;
+  std::uint64_t word;
+  memcpy(&word, data + bit / 32 * 4, sizeof(word));
+  return static_cast<std::uint32_t>(word >> (bit % 32)) & lowBits(bits);
+}
+
+/**
+ * Packs <count> values of <bits> bits at <data>.  Like extract(), this
+ * accesses whole 64-bit words, so it may read and rewrite, unchanged, up to
+ * SLACK bytes past the packed values.
+ */
+void packValues(const std::uint32_t* values, const std::size_t count,
+                const unsigned bits, char* data) {
+  memset(data, 0, packedBytes(count, bits));
+  if (bits == 0) {
+    return;
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    const std::size_t bit = i * bits;
+    char* word_data = data + bit / 32 * 4;
+    std::uint64_t word;
+    memcpy(&word, word_data, sizeof(word));
+    word |= static_cast<std::uint64_t>(values[i]) << (bit % 32);
+    memcpy(word_data, &word, sizeof(word));
+  }
+}
+
+typedef void (*UnpackKernel)(const char*, std::size_t, unsigned,
+                             std::uint32_t, std::uint32_t*);
+
+/**
+ * Writes base + value i to out[i] for the <count> values at <data>.
+ */
+void unpackScalar(const char* data, const std::size_t count,
+                  const unsigned bits, const std::uint32_t base,
+                  std::uint32_t* out) {
+  for (std::size_t i = 0; i < count; ++i) {
+    out[i] = base + extract(data, i, bits);
+  }
+}
+
+#ifdef BADGERDB_X86_KERNELS
+
+__attribute__((target("avx2")))
+void unpackAvx2(const char* data, const std::size_t count, const unsigned bits,
+                const std::uint32_t base, std::uint32_t* out) {
+  if (bits == 0 || bits > MAX_GATHER_BITS) {
+    unpackScalar(data, count, bits, base, out);
+    return;
+  }
+  const __m256i lane_bits = _mm256_mullo_epi32(
+      _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(bits));
+  const __m256i mask = _mm256_set1_epi32(lowBits(bits));
+  const __m256i seven = _mm256_set1_epi32(7);
+  const __m256i offset = _mm256_set1_epi32(base);
+  std::size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    // Gather the 4 bytes holding each value, then shift it down.
+    const __m256i bit =
+        _mm256_add_epi32(_mm256_set1_epi32(i * bits), lane_bits);
+    const __m256i bytes = _mm256_i32gather_epi32(
+        reinterpret_cast<const int*>(data), _mm256_srli_epi32(bit, 3), 1);
+    const __m256i values = _mm256_and_si256(
+        _mm256_srlv_epi32(bytes, _mm256_and_si256(bit, seven)), mask);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                        _mm256_add_epi32(values, offset));
+  }
+  for (; i < count; ++i) {
+    out[i] = base + extract(data, i, bits);
+  }
+}
+
+#endif
+
+UnpackKernel unpackKernel() {
+#ifdef BADGERDB_X86_KERNELS
+  if (FilterKernels::instructionSet() == FilterKernels::AVX2) {
+    return unpackAvx2;
+  }
+#endif
+  return unpackScalar;
+}
+
+}
+
+std::size_t PackedIntLeaf::packedSize(const std::int32_t* keys,
+                                      const RecordId* rids,
+                                      const std::size_t count) {
+  if (count == 0) {
+    return leafSize(0, 0, 0);
+  }
+  PageId low = rids[0].page_number;
+  PageId high = rids[0].page_number;
+  for (std::size_t i = 1; i < count; ++i) {
+    low = std::min(low, rids[i].page_number);
+    high = std::max(high, rids[i].page_number);
+  }
+  const std::uint32_t key_range =
+      static_cast<std::uint32_t>(keys[count - 1]) -
+      static_cast<std::uint32_t>(keys[0]);
+  return leafSize(count, bitsFor(key_range), bitsFor(high - low));
+}
+
+std::size_t PackedIntLeaf::pack(const std::int32_t* keys, const RecordId* rids,
+                                const std::size_t count,
+                                const PageId right_sibling) {
+  // Take entries while they fit; the size only grows with each one.
+  std::size_t fit = 0;
+  PageId low = 0;
+  PageId high = 0;
+  unsigned key_bits = 0;
+  unsigned page_bits = 0;
+  for (std::size_t i = 0; i < count && i < 0xffff; ++i) {
+    const PageId next_low = i == 0 ? rids[i].page_number
+                                   : std::min(low, rids[i].page_number);
+    const PageId next_high = i == 0 ? rids[i].page_number
+                                    : std::max(high, rids[i].page_number);
+    const unsigned next_key_bits = bitsFor(
+        static_cast<std::uint32_t>(keys[i]) -
+        static_cast<std::uint32_t>(keys[0]));
+    const unsigned next_page_bits = bitsFor(next_high - next_low);
+    if (leafSize(i + 1, next_key_bits, next_page_bits) > Page::SIZE) {
+      break;
+    }
+    low = next_low;
+    high = next_high;
+    key_bits = next_key_bits;
+    page_bits = next_page_bits;
+    fit = i + 1;
+  }
+
+  PackedIntLeafHeader* leaf = header();
+  leaf->count = fit;
+  leaf->key_bits = key_bits;
+  leaf->page_bits = page_bits;
+  leaf->key_base = fit > 0 ? keys[0] : 0;
+  leaf->page_base = low;
+  leaf->right_sibling = right_sibling;
+
+  std::vector<std::uint32_t> deltas(fit);
+  for (std::size_t i = 0; i < fit; ++i) {
+    deltas[i] = static_cast<std::uint32_t>(keys[i]) -
+                static_cast<std::uint32_t>(leaf->key_base);
+  }
+  packValues(deltas.data(), fit, key_bits, keyData());
+  for (std::size_t i = 0; i < fit; ++i) {
+    deltas[i] = rids[i].page_number - low;
+  }
+  packValues(deltas.data(), fit, page_bits, pageData());
+  char* slots = slotData();
+  for (std::size_t i = 0; i < fit; ++i) {
+    memcpy(slots + i * sizeof(SlotId), &rids[i].slot_number, sizeof(SlotId));
+  }
+  return fit;
+}
+
+char* PackedIntLeaf::keyData() const {
+  return reinterpret_cast<char*>(page_) + sizeof(PackedIntLeafHeader);
+}
+
+char* PackedIntLeaf::pageData() const {
+  return keyData() + packedBytes(count(), header()->key_bits);
+}
+
+char* PackedIntLeaf::slotData() const {
+  return pageData() + packedBytes(count(), header()->page_bits);
+}
+
+std::uint32_t PackedIntLeaf::keyDelta(const std::uint16_t i) const {
+  return extract(keyData(), i, header()->key_bits);
+}
+
+std::int32_t PackedIntLeaf::key(const std::uint16_t i) const {
+  return static_cast<std::int32_t>(
+      static_cast<std::uint32_t>(header()->key_base) + keyDelta(i));
+}
+
+RecordId PackedIntLeaf::rid(const std::uint16_t i) const {
+  RecordId rid;
+  rid.page_number =
+      header()->page_base + extract(pageData(), i, header()->page_bits);
+  memcpy(&rid.slot_number, slotData() + i * sizeof(SlotId), sizeof(SlotId));
+  return rid;
+}
+
+std::uint16_t PackedIntLeaf::lowerBound(const std::int32_t key) const {
+  if (count() == 0 || key <= header()->key_base) {
+    return 0;
+  }
+  // Compare differences from the base, so that probes need not add it.
+  const std::uint32_t delta = static_cast<std::uint32_t>(key) -
+                              static_cast<std::uint32_t>(header()->key_base);
+  std::uint16_t low = 0;
+  std::uint16_t high = count();
+  while (low < high) {
+    const std::uint16_t mid = low + (high - low) / 2;
+    if (keyDelta(mid) < delta) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+std::uint16_t PackedIntLeaf::upperBound(const std::int32_t key) const {
+  if (count() == 0 || key < header()->key_base) {
+    return 0;
+  }
+  const std::uint32_t delta = static_cast<std::uint32_t>(key) -
+                              static_cast<std::uint32_t>(header()->key_base);
+  std::uint16_t low = 0;
+  std::uint16_t high = count();
+  while (low < high) {
+    const std::uint16_t mid = low + (high - low) / 2;
+    if (keyDelta(mid) <= delta) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+void PackedIntLeaf::unpackKeys(std::int32_t* keys) const {
+  static const UnpackKernel unpack = unpackKernel();
+  unpack(keyData(), count(), header()->key_bits,
+         static_cast<std::uint32_t>(header()->key_base),
+         reinterpret_cast<std::uint32_t*>(keys));
+}
+
+void PackedIntLeaf::unpackRids(RecordId* rids) const {
+  static const UnpackKernel unpack = unpackKernel();
+  std::vector<std::uint32_t> pages(count());
+  unpack(pageData(), count(), header()->page_bits, header()->page_base,
+         pages.data());
+  const char* slots = slotData();
+  for (std::uint16_t i = 0; i < count(); ++i) {
+    rids[i].page_number = pages[i];
+    memcpy(&rids[i].slot_number, slots + i * sizeof(SlotId), sizeof(SlotId));
+  }
+}
+
+bool PackedIntLeaf::insert(const std::int32_t key, const RecordId& rid) {
+  const std::uint16_t position = upperBound(key);
+  std::vector<std::int32_t> keys(count());
+  std::vector<RecordId> rids(count());
+  unpackKeys(keys.data());
+  unpackRids(rids.data());
+  keys.insert(keys.begin() + position, key);
+  rids.insert(rids.begin() + position, rid);
+  if (packedSize(keys.data(), rids.data(), keys.size()) > Page::SIZE ||
+      keys.size() > 0xffff) {
+    return false;
+  }
+  pack(keys.data(), rids.data(), keys.size(), rightSibling());
+  return true;
+}
+
+}
@@ -0,0 +1,181 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Header of a PackedIntLeaf, at the start of the page.
+ */
+struct PackedIntLeafHeader {
+  /**
+   * Number of entries in the leaf.
+   */
+  std::uint16_t count;
+
+  /**
+   * Bits of each packed key and page number delta.
+   */
+  std::uint8_t key_bits;
+  std::uint8_t page_bits;
+
+  /**
+   * Smallest key, which the packed deltas are added to.
+   */
+  std::int32_t key_base;
+
+  /**
+   * Smallest page number of the RecordIds.
+   */
+  PageId page_base;
+
+  /**
+   * Page number of the leaf on the right side.
+   */
+  PageId right_sibling;
+};
+
+/**
+ * @brief Accessor for a B+Tree leaf of INTEGER keys compressed by frame of
+ *        reference.
+ *
+ * A LeafNodeInt spends 4 bytes on every key and 8 on every RecordId, though
+ * neighboring keys, and the page numbers of their records, usually differ by
+ * little.  This leaf stores the smallest key and page number once and each
+ * entry as its differences from them, bit-packed at the width the largest
+ * difference needs, followed by the slot numbers.  A leaf of dense keys over
+ * clustered records packs two to three times as many entries as a
+ * LeafNodeInt, which makes trees shorter and range scans read fewer pages.
+ *
+ * Keys are searched in packed form, each probe extracting one difference,
+ * so a lookup does not decode the leaf.  Scans decode all keys or RecordIds
+ * at once with unpackKeys() and unpackRids(), 8 per instruction with AVX2
+ * where the CPU has it (see FilterKernels::instructionSet()).
+ *
+ * Packed leaves suit bulk loading and read-mostly indexes: an insert
+ * decodes and repacks the whole leaf.
+ *
+ * Like the other B+Tree nodes, a PackedIntLeaf takes up the whole of its
+ * Page, header included.  It refers to a Page owned by someone else, such as
+ * a buffer pool frame, and must not outlive it.
+ *
+ * @warning This class is not threadsafe.
+ */
+class PackedIntLeaf {
+ public:
+  /**
+   * Constructs an accessor for the given page.
+   *
+   * @param page  Page to access.
+   */
+  explicit PackedIntLeaf(Page* page) : page_(page) {}
+
+  /**
+   * Returns the number of bytes a leaf of the given entries takes.
+   *
+   * @param keys    Keys, in increasing order.
+   * @param rids    RecordIds of the keys.
+   * @param count   Number of entries.
+   */
+  static std::size_t packedSize(const std::int32_t* keys, const RecordId* rids,
+                                const std::size_t count);
+
+  /**
+   * Formats the page as a leaf of as many of the given entries as fit.
+   *
+   * @param keys    Keys, in increasing order.
+   * @param rids    RecordIds of the keys.
+   * @param count   Number of entries.
+   * @param right_sibling   Right sibling of the leaf.
+   * @return  Number of entries packed, from the first.
+   */
+  std::size_t pack(const std::int32_t* keys, const RecordId* rids,
+                   const std::size_t count, const PageId right_sibling);
+
+  std::uint16_t count() const { return header()->count; }
+
+  /**
+   * Returns a key, extracted from its packed form.
+   *
+   * @param i   Number of the entry, from 0 in key order.
+   */
+  std::int32_t key(const std::uint16_t i) const;
+
+  /**
+   * Returns a RecordId, extracted from its packed form.
+   */
+  RecordId rid(const std::uint16_t i) const;
+
+  /**
+   * Returns the number of the first key not less than <key>, or count().
+   */
+  std::uint16_t lowerBound(const std::int32_t key) const;
+
+  /**
+   * Returns the number of the first key greater than <key>, or count().
+   */
+  std::uint16_t upperBound(const std::int32_t key) const;
+
+  /**
+   * Decodes all keys into <keys>, which receives count() of them.
+   */
+  void unpackKeys(std::int32_t* keys) const;
+
+  /**
+   * Decodes all RecordIds into <rids>, which receives count() of them.
+   */
+  void unpackRids(RecordId* rids) const;
+
+  /**
+   * Returns the right sibling of the leaf.
+   */
+  PageId rightSibling() const { return header()->right_sibling; }
+  void setRightSibling(const PageId page_number) {
+    header()->right_sibling = page_number;
+  }
+
+  /**
+   * Inserts an entry after any equal keys by unpacking and repacking the
+   * leaf.
+   *
+   * @return  False, leaving the leaf as it was, if the entries no longer fit.
+   */
+  bool insert(const std::int32_t key, const RecordId& rid);
+
+ private:
+  PackedIntLeafHeader* header() const {
+    return reinterpret_cast<PackedIntLeafHeader*>(page_);
+  }
+
+  /**
+   * Return the packed key deltas, the packed page number deltas and the
+   * slot numbers, which follow the header in that order.
+   */
+  char* keyData() const;
+  char* pageData() const;
+  char* slotData() const;
+
+  /**
+   * Returns the difference of key i from the smallest.
+   */
+  std::uint32_t keyDelta(const std::uint16_t i) const;
+
+  /**
+   * Page being accessed.
+   */
+  Page* page_;
+};
+
+}
@@ -5,7 +5,9 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
 #include <cassert>
+#include <vector>
 
 #include <iostream>
 #include "exceptions/insufficient_space_exception.h"
@@ -14,10 +16,46 @@
 #include "exceptions/slot_in_use_exception.h"
 #include "page_iterator.h"
 #include "page.h"
+#include "pax_page.h"
 #include "string.h"
 
 namespace badgerdb {
 
+namespace {
+
+/**
+ * Widens <zone_map> to cover the attribute value in the given record.
+ * Records too short to hold the attribute are ignored.
+ */
+void widenZoneMap(ZoneMap& zone_map, const char* record_data,
+                  const std::size_t length) {
+  double value;
+  if (zone_map.type == INTEGER) {
+    int int_value;
+    if (zone_map.offset + sizeof(int_value) > length) {
+      return;
+    }
+    memcpy(&int_value, record_data + zone_map.offset, sizeof(int_value));
+    value = int_value;
+  } else {
+    if (zone_map.offset + sizeof(value) > length) {
+      return;
+    }
+    memcpy(&value, record_data + zone_map.offset, sizeof(value));
+  }
+
+  if (zone_map.state == ZONE_MAP_EMPTY) {
+    zone_map.min = value;
+    zone_map.max = value;
+    zone_map.state = ZONE_MAP_VALID;
+  } else {
+    zone_map.min = std::min(zone_map.min, value);
+    zone_map.max = std::max(zone_map.max, value);
+  }
+}
+
+}
+
 Page::Page() {
   initialize();
 }
@@ -27,6 +65,10 @@ void Page::initialize() {
   header_.free_space_upper_bound = DATA_SIZE;
   header_.num_slots = 0;
   header_.num_free_slots = 0;
+  header_.first_free_slot = INVALID_SLOT;
+  header_.fragmented_bytes = 0;
+  header_.layout = SLOTTED_LAYOUT;
+  memset(header_.zone_maps, 0, sizeof(header_.zone_maps));
   header_.current_page_number = INVALID_NUMBER;
   header_.next_page_number = INVALID_NUMBER;
   //data_.assign(DATA_SIZE, char());
@@ -44,11 +86,15 @@ RecordId Page::insertRecord(const std::string& record_data) {
 }
 
 std::string Page::getRecord(const RecordId& record_id) const {
+  const RecordView record = getRecordView(record_id);
+  return std::string(record.data, record.len);
+}
+
+RecordView Page::getRecordView(const RecordId& record_id) const {
   validateRecordId(record_id);
   const PageSlot& slot = getSlot(record_id.slot_number);
-	std::string retStr = std::string(data_, DATA_SIZE).substr(slot.item_offset, slot.item_length);
-
-	return retStr;
+  const RecordView record = {&data_[slot.item_offset], slot.item_length};
+  return record;
 }
 
 void Page::updateRecord(const RecordId& record_id,
@@ -77,61 +123,40 @@ void Page::deleteRecord(const RecordId& record_id,
   validateRecordId(record_id);
   PageSlot* slot = getSlot(record_id.slot_number);
 
-	for(int i = 0; i < slot->item_length; i++)
-		data_[i + slot->item_offset] = '\0';
-
-  //data_.replace(slot->item_offset, slot->item_length, slot->item_length, '\0');
-
-  // Compact the data by removing the hole left by this record (if necessary).
-  std::uint16_t move_offset = slot->item_offset; 
-  std::size_t move_bytes = 0;
-  for (SlotId i = 1; i <= header_.num_slots; ++i) {
-    PageSlot* other_slot = getSlot(i);
-    if (other_slot->used && other_slot->item_offset < slot->item_offset) {
-      if (other_slot->item_offset < move_offset) {
-        move_offset = other_slot->item_offset;
-      }
-      move_bytes += other_slot->item_length;
-      // Update the slot for the other data to reflect the soon-to-be-new
-      // location.
-      other_slot->item_offset += slot->item_length;
-    }
-  }
-  // If we have data to move, shift it to the right.
-  if (move_bytes > 0) {
-    const std::string& data_to_move = std::string(data_, DATA_SIZE).substr(move_offset, move_bytes);
-
-		for(std::uint16_t i = 0; i < move_bytes; i++)
-			data_[i + move_offset + slot->item_length] = data_to_move[i];
-
-    //data_.replace(move_offset + slot->item_length, move_bytes, data_to_move);
+  // Leave the data where it is; an insert that runs short of contiguous space
+  // compacts the page.  A record right at the free space boundary can be
+  // given back straight away.
+  if (slot->item_offset == header_.free_space_upper_bound) {
+    header_.free_space_upper_bound += slot->item_length;
+  } else {
+    header_.fragmented_bytes += slot->item_length;
   }
-  header_.free_space_upper_bound += slot->item_length;
 
   // Mark slot as unused.
   slot->used = false;
-  slot->item_offset = 0;
   slot->item_length = 0;
   ++header_.num_free_slots;
 
   if (allow_slot_compaction && record_id.slot_number == header_.num_slots) {
     // Last slot in the list, so we need to free any unused slots that are at
     // the end of the slot list.
-    int num_slots_to_delete = 1;
-    for (SlotId i = 1; i < header_.num_slots; ++i) {
-      // Traverse list backwards, looking for unused slots.
-      const PageSlot* other_slot = getSlot(header_.num_slots - i);
-      if (!other_slot->used) {
-        ++num_slots_to_delete;
-      } else {
-        // Stop at the first used slot we find, since we can't move used slots
-        // without affecting record IDs.
-        break;
-      }
+    SlotId num_slots_to_delete = 1;
+    while (num_slots_to_delete < header_.num_slots &&
+           !getSlot(header_.num_slots - num_slots_to_delete)->used) {
+      // Stop at the first used slot we find, since we can't move used slots
+      // without affecting record IDs.
+      ++num_slots_to_delete;
     }
     header_.num_slots -= num_slots_to_delete;
     header_.num_free_slots -= num_slots_to_delete;
     header_.free_space_lower_bound -= sizeof(PageSlot) * num_slots_to_delete;
+    if (num_slots_to_delete > 1) {
+      // Some of the freed slots were on the free slot list.
+      rebuildFreeSlotList();
+    }
+  } else {
+    slot->item_offset = header_.first_free_slot;
+    header_.first_free_slot = record_id.slot_number;
   }
 }
 
@@ -152,27 +177,25 @@ const PageSlot& Page::getSlot(const SlotId slot_number) const {
 }
 
 SlotId Page::getAvailableSlot() {
-  SlotId slot_number = INVALID_SLOT;
-  if (header_.num_free_slots > 0) {
-    // Have an allocated but unused slot that we can reuse.
-    for (SlotId i = 1; i <= header_.num_slots; ++i) {
-      const PageSlot* slot = getSlot(i);
-      if (!slot->used) {
-        // We don't decrement the number of free slots until someone actually
-        // puts data in the slot.
-        slot_number = i;
-        break;
-      }
-    }
-  } else {
+  if (header_.first_free_slot == INVALID_SLOT) {
     // Have to allocate a new slot.
-    slot_number = header_.num_slots + 1;
+    if (header_.free_space_upper_bound - header_.free_space_lower_bound <
+        static_cast<int>(sizeof(PageSlot))) {
+      compact();
+    }
+    const SlotId slot_number = header_.num_slots + 1;
     ++header_.num_slots;
     ++header_.num_free_slots;
     header_.free_space_lower_bound = sizeof(PageSlot) * header_.num_slots;
+    PageSlot* slot = getSlot(slot_number);
+    slot->used = false;
+    slot->item_length = 0;
+    slot->item_offset = INVALID_SLOT;
+    header_.first_free_slot = slot_number;
   }
-  assert(slot_number != INVALID_SLOT);
-  return static_cast<SlotId>(slot_number);
+  // We don't take the slot off the free list until someone actually puts
+  // data in it.
+  return header_.first_free_slot;
 }
 
 void Page::insertRecordInSlot(const SlotId slot_number,
@@ -185,17 +208,119 @@ void Page::insertRecordInSlot(const SlotId slot_number,
   if (slot->used) {
     throw SlotInUseException(page_number(), slot_number);
   }
+  unlinkFreeSlot(slot_number);
   const int record_length = record_data.length();
+  if (record_length > header_.free_space_upper_bound -
+                      header_.free_space_lower_bound) {
+    compact();
+  }
   slot->used = true;
   slot->item_length = record_length;
   slot->item_offset = header_.free_space_upper_bound - record_length;
   header_.free_space_upper_bound = slot->item_offset;
   --header_.num_free_slots;
 
-	for(int i = 0; i < slot->item_length; i++)
-		data_[i + slot->item_offset] = record_data[i];
+  memcpy(&data_[slot->item_offset], record_data.data(), record_length);
+  updateZoneMaps(record_data.data(), record_length);
+}
+
+bool Page::addZoneMap(const std::uint16_t offset, const Datatype type) {
+  if (type != INTEGER && type != DOUBLE) {
+    return false;
+  }
+  ZoneMap* zone_map = NULL;
+  for (std::size_t i = 0; i < MAX_ZONE_MAPS; ++i) {
+    if (header_.zone_maps[i].state == ZONE_MAP_UNUSED) {
+      zone_map = &header_.zone_maps[i];
+      break;
+    }
+  }
+  if (zone_map == NULL) {
+    return false;
+  }
+  zone_map->offset = offset;
+  zone_map->type = type;
+  zone_map->state = ZONE_MAP_EMPTY;
+
+  if (layout() == PAX_LAYOUT) {
+    PaxPage pax_page(this);
+    std::string row;
+    for (SlotId i = pax_page.getNextUsedSlot(INVALID_SLOT); i != INVALID_SLOT;
+         i = pax_page.getNextUsedSlot(i)) {
+      row = pax_page.getRecord({page_number(), i});
+      widenZoneMap(*zone_map, row.data(), row.length());
+    }
+  } else {
+    for (SlotId i = 1; i <= header_.num_slots; ++i) {
+      const PageSlot* slot = getSlot(i);
+      if (slot->used) {
+        widenZoneMap(*zone_map, &data_[slot->item_offset], slot->item_length);
+      }
+    }
+  }
+  return true;
+}
 
-  //data_.replace(slot->item_offset, slot->item_length, record_data);
+void Page::updateZoneMaps(const char* record_data, const std::size_t length) {
+  for (std::size_t i = 0; i < MAX_ZONE_MAPS; ++i) {
+    if (header_.zone_maps[i].state != ZONE_MAP_UNUSED) {
+      widenZoneMap(header_.zone_maps[i], record_data, length);
+    }
+  }
+}
+
+void Page::compact() {
+  // Slide records towards the end of the page starting with the one nearest
+  // to it, so every record moves up over space that is already free.
+  std::vector<SlotId> used_slots;
+  for (SlotId i = 1; i <= header_.num_slots; ++i) {
+    if (getSlot(i)->used) {
+      used_slots.push_back(i);
+    }
+  }
+  std::sort(used_slots.begin(), used_slots.end(),
+            [this](const SlotId a, const SlotId b) {
+              return getSlot(a)->item_offset > getSlot(b)->item_offset;
+            });
+
+  std::uint16_t upper_bound = DATA_SIZE;
+  for (std::size_t i = 0; i < used_slots.size(); ++i) {
+    PageSlot* slot = getSlot(used_slots[i]);
+    upper_bound -= slot->item_length;
+    if (upper_bound != slot->item_offset) {
+      memmove(&data_[upper_bound], &data_[slot->item_offset], slot->item_length);
+      slot->item_offset = upper_bound;
+    }
+  }
+  header_.free_space_upper_bound = upper_bound;
+  header_.fragmented_bytes = 0;
+}
+
+void Page::unlinkFreeSlot(const SlotId slot_number) {
+  const SlotId next_free_slot = getSlot(slot_number)->item_offset;
+  if (header_.first_free_slot == slot_number) {
+    header_.first_free_slot = next_free_slot;
+    return;
+  }
+  for (SlotId i = header_.first_free_slot; i != INVALID_SLOT;
+       i = getSlot(i)->item_offset) {
+    PageSlot* slot = getSlot(i);
+    if (slot->item_offset == slot_number) {
+      slot->item_offset = next_free_slot;
+      return;
+    }
+  }
+}
+
+void Page::rebuildFreeSlotList() {
+  header_.first_free_slot = INVALID_SLOT;
+  for (SlotId i = header_.num_slots; i != INVALID_SLOT; --i) {
+    PageSlot* slot = getSlot(i);
+    if (!slot->used) {
+      slot->item_offset = header_.first_free_slot;
+      header_.first_free_slot = i;
+    }
+  }
 }
 
 void Page::validateRecordId(const RecordId& record_id) const {
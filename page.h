@@ -17,11 +17,67 @@
 
 namespace badgerdb {
 
+/**
+ * @brief How records are laid out in the data area of a page.
+ */
+enum PageLayout {
+  SLOTTED_LAYOUT = 0,  /* Variable-length records addressed through slots */
+  PAX_LAYOUT = 1       /* Fixed-width rows stored column by column; see PaxPage */
+};
+
+/**
+ * Number of record attributes a page can keep a zone map for.
+ */
+const std::size_t MAX_ZONE_MAPS = 2;
+
+/**
+ * @brief State of a zone map.
+ */
+enum ZoneMapState {
+  ZONE_MAP_UNUSED = 0,  /* No attribute declared */
+  ZONE_MAP_EMPTY = 1,   /* Attribute declared, no record seen yet */
+  ZONE_MAP_VALID = 2    /* min and max cover every record on the page */
+};
+
+/**
+ * @brief Smallest and largest value of one record attribute on a page.
+ *
+ * Inserts and updates widen the range; deletes leave it as it is, so it may
+ * be wider than the records currently on the page, but never narrower.
+ */
+struct ZoneMap {
+  /**
+   * Byte offset of the attribute in every record.
+   */
+  std::uint16_t offset;
+
+  /**
+   * Datatype of the attribute, INTEGER or DOUBLE.
+   */
+  std::uint8_t type;
+
+  /**
+   * ZoneMapState of this zone map.
+   */
+  std::uint8_t state;
+
+  /**
+   * Smallest value of the attribute.
+   */
+  double min;
+
+  /**
+   * Largest value of the attribute.
+   */
+  double max;
+};
+
 /**
  * @brief Header metadata in a page.
  *
  * Header metadata in each page which tracks where space has been used and
- * contains a pointer to the next page in the file.
+ * contains a pointer to the next page in the file.  Its layout is part of the
+ * on-disk format named by FILE_FORMAT_VERSION in file.h.
  */
 struct PageHeader {
   /**
@@ -48,6 +104,24 @@ struct PageHeader {
    */
   SlotId num_free_slots;
 
+  /**
+   * First slot of the list of slots allocated but not in use, or
+   * Page::INVALID_SLOT if there are none.  The list is threaded through the
+   * item_offset field of the unused slots.
+   */
+  SlotId first_free_slot;
+
+  /**
+   * Bytes of deleted records that lie between live records.  They count as
+   * free space but are only reclaimed when the page is compacted.
+   */
+  std::uint16_t fragmented_bytes;
+
+  /**
+   * PageLayout of the data area.
+   */
+  std::uint16_t layout;
+
   /**
    * Number of the page within the file.
    */
@@ -58,6 +132,33 @@ struct PageHeader {
    */
   PageId next_page_number;
 
+  /**
+   * Value ranges of the attributes declared with Page::addZoneMap().
+   */
+  ZoneMap zone_maps[MAX_ZONE_MAPS];
+
+  /**
+   * Returns true if the zone map of the attribute at <offset> shows that no
+   * record on the page has a value in [low, high].  Pages without a zone map
+   * for the attribute are never ruled out.
+   *
+   * @param offset  Byte offset of the attribute in records.
+   * @param low     Smallest value of interest.
+   * @param high    Largest value of interest.
+   * @return  True if the page holds no record of interest.
+   */
+  bool rulesOut(const std::uint16_t offset, const double low,
+                const double high) const {
+    for (std::size_t i = 0; i < MAX_ZONE_MAPS; ++i) {
+      const ZoneMap& zone_map = zone_maps[i];
+      if (zone_map.state != ZONE_MAP_UNUSED && zone_map.offset == offset) {
+        return zone_map.state == ZONE_MAP_EMPTY ||
+            zone_map.max < low || zone_map.min > high;
+      }
+    }
+    return false;
+  }
+
   /**
    * Returns true if this page header is equal to the other.
    *
@@ -83,7 +184,8 @@ struct PageSlot {
   bool used;
 
   /**
-   * Offset of the data item in the page.
+   * Offset of the data item in the page.  For unused slots, the number of the
+   * next unused slot instead.
    */
   std::uint16_t item_offset;
 
@@ -93,6 +195,25 @@ struct PageSlot {
   std::uint16_t item_length;
 };
 
+/**
+ * @brief Read-only reference to the bytes of a record inside a page.
+ *
+ * The view points straight into the page it was taken from, so it is only
+ * valid while that page stays in memory (for buffer pool frames, while the
+ * page is pinned) and is not modified.
+ */
+struct RecordView {
+  /**
+   * First byte of the record.
+   */
+  const char* data;
+
+  /**
+   * Length of the record in bytes.
+   */
+  std::uint16_t len;
+};
+
 class PageIterator;
 
 /**
@@ -113,6 +234,12 @@ class Page {
    */
   static const std::size_t SIZE = 8192;
 
+  /**
+   * Alignment in bytes of memory buffers, file offsets and transfer sizes when
+   * a file is opened for direct I/O.
+   */
+  static const std::size_t IO_ALIGNMENT = 4096;
+
   /**
    * Size of page free space area in bytes.
    */
@@ -151,6 +278,15 @@ class Page {
    */
   std::string getRecord(const RecordId& record_id) const;
 
+  /**
+   * Returns a view of the record with the given ID, without copying it.
+   *
+   * @see RecordView
+   * @param record_id  ID of the record to return.
+   * @return  View of the record's bytes on this page.
+   */
+  RecordView getRecordView(const RecordId& record_id) const;
+
   /**
    * Updates the record with the given ID, replacing its data with a new
    * version.  This is equivalent to deleting the old record and inserting a
@@ -162,9 +298,10 @@ class Page {
   void updateRecord(const RecordId& record_id, const std::string& record_data);
 
   /**
-   * Deletes the record with the given ID.  Page is compacted upon delete to
-   * ensure that data of all records is contiguous.  Slot array is compacted if
-   * the slot deleted is at the end of the slot array.
+   * Deletes the record with the given ID.  The space of the record is not
+   * reclaimed until an insert needs it; the page is then compacted so that
+   * the data of all records is contiguous.  Slot array is compacted if the
+   * slot deleted is at the end of the slot array.
    *
    * @param record_id   ID of the record to delete.
    */
@@ -179,12 +316,14 @@ class Page {
   bool hasSpaceForRecord(const std::string& record_data) const;
 
   /**
-   * Returns this page's free space in bytes.
+   * Returns this page's free space in bytes, including space of deleted
+   * records that has not been compacted yet.
    *
    * @return  Free space in bytes.
    */
   std::uint16_t getFreeSpace() const { return header_.free_space_upper_bound -
-                                              header_.free_space_lower_bound; }
+                                              header_.free_space_lower_bound +
+                                              header_.fragmented_bytes; }
 
   /**
    * Returns this page's number in its file.
@@ -200,6 +339,39 @@ class Page {
    */
   PageId next_page_number() const { return header_.next_page_number; }
 
+  /**
+   * Returns how records are laid out on this page.  The record methods of
+   * this class apply to slotted pages only; PAX pages are accessed through
+   * PaxPage.
+   *
+   * @return  Layout of the page.
+   */
+  PageLayout layout() const { return static_cast<PageLayout>(header_.layout); }
+
+  /**
+   * Starts keeping the smallest and largest value of the attribute at
+   * <offset> of every record, for scans to skip the page by.  Records
+   * already on the page are summarized right away.
+   *
+   * @param offset  Byte offset of the attribute in records.
+   * @param type    Datatype of the attribute; only INTEGER and DOUBLE are
+   *                supported.
+   * @return  False if the type is not supported or the page already keeps
+   *          MAX_ZONE_MAPS zone maps.
+   */
+  bool addZoneMap(const std::uint16_t offset, const Datatype type);
+
+  /**
+   * Returns true if this page's zone maps show that it holds no record whose
+   * attribute at <offset> is in [low, high].
+   *
+   * @see PageHeader::rulesOut
+   */
+  bool rulesOut(const std::uint16_t offset, const double low,
+                const double high) const {
+    return header_.rulesOut(offset, low, high);
+  }
+
   /**
    * Returns an iterator at the first record in the page.
    *
@@ -240,10 +412,9 @@ class Page {
   }
 
   /**
-   * Deletes the record with the given ID.  Page is compacted upon delete to
-   * ensure that data of all records is contiguous.  Slot array is compacted if
-   * the slot deleted is at the end of the slot array and
-   * <allow_slot_compaction> is set.
+   * Deletes the record with the given ID, leaving its space to be reclaimed
+   * by a later compaction.  Slot array is compacted if the slot deleted is at
+   * the end of the slot array and <allow_slot_compaction> is set.
    *
    * @param record_id             ID of the record to delete.
    * @param allow_slot_compaction If true, the slot array will be compacted if
@@ -273,8 +444,9 @@ class Page {
   const PageSlot& getSlot(const SlotId slot_number) const;
 
   /**
-   * Returns the slot number of an available slot.  If no slots are available
-   * to be reused, allocates a new slot.  Updates available slot count in the
+   * Returns the slot number of an available slot, taken from the head of the
+   * free slot list.  If no slots are available to be reused, allocates a new
+   * slot and puts it on the list.  Updates available slot count in the
    * header metadata, but does not mark returned slot as used.  If a new slot is
    * allocated, updates the free space lower bound.
    *
@@ -290,7 +462,8 @@ class Page {
 
   /**
    * Inserts record data into the given slot.  The slot should not be currently
-   * in use.  <slot_number> must be less than <header_.num_slots>.
+   * in use.  <slot_number> must be less than <header_.num_slots>.  Compacts
+   * the page first if the free space is not contiguous enough for the record.
    *
    * Callers are responsible for making sure there is enough space to hold the
    * record before calling this method.
@@ -304,6 +477,32 @@ class Page {
   void insertRecordInSlot(const SlotId slot_number,
                           const std::string& record_data);
 
+  /**
+   * Widens the zone maps of the page to cover the given record.
+   *
+   * @param record_data   Bytes that compose the record.
+   * @param length        Length of the record.
+   */
+  void updateZoneMaps(const char* record_data, const std::size_t length);
+
+  /**
+   * Moves the data of all records up against the end of the page, turning
+   * the space of deleted records back into contiguous free space.
+   */
+  void compact();
+
+  /**
+   * Removes the given unused slot from the free slot list.
+   *
+   * @param slot_number   Number of slot to remove.
+   */
+  void unlinkFreeSlot(const SlotId slot_number);
+
+  /**
+   * Rebuilds the free slot list from the unused slots in the slot array.
+   */
+  void rebuildFreeSlotList();
+
   /**
    * Throws an exception if the given record ID is not valid for this page
    * (i.e., it has the right page number and the slot it references is in use).
@@ -337,11 +536,18 @@ class Page {
   friend class PageFile;
   friend class BlobFile;
   friend class PageIterator;
+  friend class PaxPage;
+  friend class HeapAppender;
 };
 
 static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
 static_assert(Page::DATA_SIZE > 0,
               "Page must have some space to hold data.");
+static_assert(sizeof(Page) == Page::SIZE && Page::SIZE % Page::IO_ALIGNMENT == 0,
+              "Page must be a whole number of direct I/O blocks.");
+static_assert(sizeof(PageHeader) == 72,
+              "Changing PageHeader changes the on-disk format; bump "
+              "FILE_FORMAT_VERSION.");
 
 }
@@ -0,0 +1,280 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "page_compressor.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * log2 of the number of entries in the LZ match finder's hash table.
+ */
+const int HASH_BITS = 12;
+
+/**
+ * Farthest back an LZ match may reach (offsets are stored in two bytes).
+ */
+const std::size_t MAX_OFFSET = 0xFFFF;
+
+/**
+ * Bytes at the end of the input that are always emitted as literals, so the
+ * match finder never reads past the end.
+ */
+const std::size_t TAIL_LITERALS = 12;
+
+std::uint32_t loadWord(const char* p) {
+  std::uint32_t word;
+  memcpy(&word, p, sizeof(word));
+  return word;
+}
+
+void storeWord(char* p, const std::uint32_t word) {
+  memcpy(p, &word, sizeof(word));
+}
+
+std::size_t zeroBytes(const std::uint32_t word) {
+  return ((word & 0xFF) == 0) + ((word & 0xFF00) == 0) +
+      ((word & 0xFF0000) == 0) + ((word & 0xFF000000) == 0);
+}
+
+/**
+ * Appends a length continuation (runs of 255 closed by a smaller byte).
+ */
+void putLength(char* out, std::size_t& op, std::size_t value) {
+  while (value >= 255) {
+    out[op++] = static_cast<char>(255);
+    value -= 255;
+  }
+  out[op++] = static_cast<char>(value);
+}
+
+/**
+ * Reads a length continuation, adding it to <value>.
+ */
+bool getLength(const char* in, std::size_t& ip, const std::size_t length,
+               std::size_t& value) {
+  unsigned char byte;
+  do {
+    if (ip >= length) {
+      return false;
+    }
+    byte = static_cast<unsigned char>(in[ip++]);
+    value += byte;
+  } while (byte == 255);
+  return true;
+}
+
+}
+
+const std::size_t PageCompressor::MAX_COMPRESSED_SIZE;
+
+std::size_t PageCompressor::compress(const Page& page, char* out) {
+  const char* bytes = reinterpret_cast<const char*>(&page);
+  char deltas[Page::SIZE];
+  const std::uint32_t strides = encodeDeltas(bytes, deltas);
+
+  // Header is the method byte plus the stride mask; anything not strictly
+  // smaller than a raw copy is not worth decoding.
+  const std::size_t header = 1 + sizeof(strides);
+  const std::size_t lz_size = compressLz(deltas, Page::SIZE, out + header,
+                                         MAX_COMPRESSED_SIZE - header - 1);
+  if (lz_size > 0) {
+    out[0] = DELTA_LZ;
+    memcpy(out + 1, &strides, sizeof(strides));
+    return header + lz_size;
+  }
+  out[0] = RAW;
+  memcpy(out + 1, bytes, Page::SIZE);
+  return MAX_COMPRESSED_SIZE;
+}
+
+bool PageCompressor::decompress(const char* in, const std::size_t length,
+                                Page* page) {
+  char* bytes = reinterpret_cast<char*>(page);
+  if (length == MAX_COMPRESSED_SIZE && in[0] == RAW) {
+    memcpy(bytes, in + 1, Page::SIZE);
+    return true;
+  }
+  std::uint32_t strides;
+  const std::size_t header = 1 + sizeof(strides);
+  if (length <= header || in[0] != DELTA_LZ) {
+    return false;
+  }
+  memcpy(&strides, in + 1, sizeof(strides));
+  if (!decompressLz(in + header, length - header, bytes, Page::SIZE)) {
+    return false;
+  }
+  decodeDeltas(bytes, strides);
+  return true;
+}
+
+std::uint32_t PageCompressor::encodeDeltas(const char* in, char* out) {
+  const std::size_t words_per_chunk = CHUNK_SIZE / sizeof(std::uint32_t);
+  std::uint32_t strides = 0;
+  for (std::size_t chunk = 0; chunk < NUM_CHUNKS; ++chunk) {
+    const std::size_t first = chunk * words_per_chunk;
+    // Stride 0 keeps the words as they are; 1 suits sorted keys, 2 suits
+    // arrays of 8-byte record ids.
+    std::size_t zeros[3] = {0, 0, 0};
+    for (std::size_t i = first; i < first + words_per_chunk; ++i) {
+      const std::uint32_t word = loadWord(in + i * 4);
+      zeros[0] += zeroBytes(word);
+      for (std::size_t stride = 1; stride <= 2; ++stride) {
+        const std::uint32_t base = i >= stride ? loadWord(in + (i - stride) * 4) : 0;
+        zeros[stride] += zeroBytes(word - base);
+      }
+    }
+    std::size_t best = 0;
+    for (std::size_t stride = 1; stride <= 2; ++stride) {
+      if (zeros[stride] > zeros[best]) {
+        best = stride;
+      }
+    }
+
+    strides |= static_cast<std::uint32_t>(best) << (2 * chunk);
+    for (std::size_t i = first; i < first + words_per_chunk; ++i) {
+      const std::uint32_t word = loadWord(in + i * 4);
+      const std::uint32_t base =
+          best > 0 && i >= best ? loadWord(in + (i - best) * 4) : 0;
+      storeWord(out + i * 4, word - base);
+    }
+  }
+  return strides;
+}
+
+void PageCompressor::decodeDeltas(char* data, const std::uint32_t strides) {
+  const std::size_t words_per_chunk = CHUNK_SIZE / sizeof(std::uint32_t);
+  for (std::size_t chunk = 0; chunk < NUM_CHUNKS; ++chunk) {
+    const std::size_t stride = (strides >> (2 * chunk)) & 3;
+    if (stride == 0) {
+      continue;
+    }
+    // Earlier words are already restored, so each delta is added to the
+    // original value it was taken against.
+    const std::size_t first = chunk * words_per_chunk;
+    for (std::size_t i = std::max(first, stride); i < first + words_per_chunk;
+         ++i) {
+      storeWord(data + i * 4,
+                loadWord(data + i * 4) + loadWord(data + (i - stride) * 4));
+    }
+  }
+}
+
+std::size_t PageCompressor::compressLz(const char* in, const std::size_t length,
+                                       char* out, const std::size_t capacity) {
+  int table[1 << HASH_BITS];
+  std::fill(table, table + (1 << HASH_BITS), -1);
+
+  std::size_t ip = 0;
+  std::size_t anchor = 0;
+  std::size_t op = 0;
+  const std::size_t match_limit = length > TAIL_LITERALS ? length - TAIL_LITERALS : 0;
+  while (ip < match_limit) {
+    const std::uint32_t sequence = loadWord(in + ip);
+    const std::uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+    const int candidate = table[hash];
+    table[hash] = static_cast<int>(ip);
+    if (candidate < 0 || ip - candidate > MAX_OFFSET ||
+        loadWord(in + candidate) != sequence) {
+      ++ip;
+      continue;
+    }
+    const std::size_t ref = candidate;
+    std::size_t match = MIN_MATCH;
+    while (ip + match < length && in[ref + match] == in[ip + match]) {
+      ++match;
+    }
+
+    // Token, literal length, literals, offset and match length, each length
+    // taking one extra byte per 255.
+    const std::size_t literals = ip - anchor;
+    if (op + 1 + literals + literals / 255 + 1 + 2 + match / 255 + 1 > capacity) {
+      return 0;
+    }
+    const std::size_t token = op++;
+    out[token] = static_cast<char>(std::min<std::size_t>(literals, 15) << 4);
+    if (literals >= 15) {
+      putLength(out, op, literals - 15);
+    }
+    memcpy(out + op, in + anchor, literals);
+    op += literals;
+    const std::size_t offset = ip - ref;
+    out[op++] = static_cast<char>(offset & 0xFF);
+    out[op++] = static_cast<char>(offset >> 8);
+    const std::size_t match_code = match - MIN_MATCH;
+    out[token] |= static_cast<char>(std::min<std::size_t>(match_code, 15));
+    if (match_code >= 15) {
+      putLength(out, op, match_code - 15);
+    }
+
+    ip += match;
+    anchor = ip;
+  }
+
+  // The last sequence is literals only; the decoder stops when it runs out
+  // of input right after them.
+  const std::size_t literals = length - anchor;
+  if (op + 1 + literals + literals / 255 + 1 > capacity) {
+    return 0;
+  }
+  const std::size_t token = op++;
+  out[token] = static_cast<char>(std::min<std::size_t>(literals, 15) << 4);
+  if (literals >= 15) {
+    putLength(out, op, literals - 15);
+  }
+  memcpy(out + op, in + anchor, literals);
+  op += literals;
+  return op;
+}
+
+bool PageCompressor::decompressLz(const char* in, const std::size_t length,
+                                  char* out, const std::size_t capacity) {
+  std::size_t ip = 0;
+  std::size_t op = 0;
+  while (ip < length) {
+    const unsigned char token = static_cast<unsigned char>(in[ip++]);
+    std::size_t literals = token >> 4;
+    if (literals == 15 && !getLength(in, ip, length, literals)) {
+      return false;
+    }
+    if (ip + literals > length || op + literals > capacity) {
+      return false;
+    }
+    memcpy(out + op, in + ip, literals);
+    ip += literals;
+    op += literals;
+    if (ip == length) {
+      break;
+    }
+
+    if (ip + 2 > length) {
+      return false;
+    }
+    const std::size_t offset = static_cast<unsigned char>(in[ip]) |
+        (static_cast<std::size_t>(static_cast<unsigned char>(in[ip + 1])) << 8);
+    ip += 2;
+    std::size_t match = token & 15;
+    if (match == 15 && !getLength(in, ip, length, match)) {
+      return false;
+    }
+    match += MIN_MATCH;
+    if (offset == 0 || offset > op || op + match > capacity) {
+      return false;
+    }
+    // Matches may overlap their own output, so copy byte by byte.
+    for (std::size_t i = 0; i < match; ++i, ++op) {
+      out[op] = out[op - offset];
+    }
+  }
+  return op == capacity;
+}
+
+}
@@ -0,0 +1,125 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Lossless codec for whole pages, used by compressed BlobFiles.
+ *
+ * Index pages are mostly arrays of integers: sorted keys, record ids whose
+ * page numbers repeat, and unused tails of zeros.  The page is first viewed
+ * as 32-bit words and, separately for every CHUNK_SIZE bytes, each word is
+ * replaced by its difference from the word one or two positions before it
+ * (whichever leaves more zero bytes), which turns sorted keys and strided
+ * record ids into runs of small values.  The result is then compressed with
+ * a byte-oriented LZ77 pass in the style of LZ4.  Pages that do not shrink
+ * are stored verbatim.
+ *
+ * All methods are threadsafe.
+ */
+class PageCompressor {
+ public:
+  /**
+   * Largest number of bytes compress() may produce for one page.
+   */
+  static const std::size_t MAX_COMPRESSED_SIZE = 1 + Page::SIZE;
+
+  /**
+   * Compresses a page.
+   *
+   * @param page  Page to compress.
+   * @param out   Buffer of at least MAX_COMPRESSED_SIZE bytes receiving the
+   *              compressed image.
+   * @return  Number of bytes of the compressed image.
+   */
+  static std::size_t compress(const Page& page, char* out);
+
+  /**
+   * Restores a page from its compressed image.
+   *
+   * @param in      Compressed image produced by compress().
+   * @param length  Number of bytes of the image.
+   * @param page    Page to restore into.
+   * @return  False if the image is corrupt.
+   */
+  static bool decompress(const char* in, const std::size_t length, Page* page);
+
+ private:
+  /**
+   * Bytes covered by one choice of delta stride.
+   */
+  static const std::size_t CHUNK_SIZE = 512;
+
+  /**
+   * Number of chunks in a page; each takes two bits of the stride mask.
+   */
+  static const std::size_t NUM_CHUNKS = Page::SIZE / CHUNK_SIZE;
+
+  /**
+   * Shortest match the LZ pass encodes.
+   */
+  static const std::size_t MIN_MATCH = 4;
+
+  /**
+   * How the rest of a compressed image is encoded, stored in its first byte.
+   */
+  enum Method {
+    RAW = 0,      /* Page bytes stored verbatim */
+    DELTA_LZ = 1  /* Stride mask followed by LZ-compressed deltas */
+  };
+
+  /**
+   * Replaces the words of a page by their deltas, choosing a stride for
+   * every chunk.
+   *
+   * @param in      Page bytes.
+   * @param out     Buffer of Page::SIZE bytes receiving the deltas.
+   * @return  Stride of every chunk, two bits per chunk.
+   */
+  static std::uint32_t encodeDeltas(const char* in, char* out);
+
+  /**
+   * Undoes encodeDeltas() in place.
+   *
+   * @param data    Deltas, replaced by the page bytes.
+   * @param strides Stride mask returned by encodeDeltas().
+   */
+  static void decodeDeltas(char* data, const std::uint32_t strides);
+
+  /**
+   * LZ-compresses <length> bytes.
+   *
+   * @param in        Bytes to compress.
+   * @param length    Number of bytes to compress.
+   * @param out       Buffer receiving the compressed stream.
+   * @param capacity  Size of <out>.
+   * @return  Size of the compressed stream, or 0 if it does not fit.
+   */
+  static std::size_t compressLz(const char* in, const std::size_t length,
+                                char* out, const std::size_t capacity);
+
+  /**
+   * Expands a stream produced by compressLz().
+   *
+   * @param in        Compressed stream.
+   * @param length    Size of the compressed stream.
+   * @param out       Buffer receiving the bytes.
+   * @param capacity  Number of bytes the stream must expand to.
+   * @return  False if the stream is corrupt.
+   */
+  static bool decompressLz(const char* in, const std::size_t length,
+                           char* out, const std::size_t capacity);
+};
+
+}
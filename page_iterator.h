@@ -10,6 +10,7 @@
 #include <cassert>
 #include "file.h"
 #include "page.h"
+#include "pax_page.h"
 #include "types.h"
 
 namespace badgerdb {
@@ -18,7 +19,7 @@ namespace badgerdb {
  * @brief Iterator for iterating over the records in a page.
  *
  * This class provides a forward-only iterator that iterates over all the
- * records stored in a Page.
+ * records stored in a Page, whether slotted or in PAX layout.
  */
 class PageIterator {
  public:
@@ -98,9 +99,22 @@ class PageIterator {
    * @return  Record in page.
    */
 	inline std::string operator*() const {
+		if (PaxPage::isPax(*page_))
+			return PaxPage(page_).getRecord(current_record_);
 		return page_->getRecord(current_record_); 
 	}
 
+  /**
+   * Returns a view of the current record in the page, without copying it.
+   * Only slotted pages store records contiguously; use PaxPage to read rows
+   * of PAX pages.
+   *
+   * @return  View of record in page.
+   */
+	inline RecordView getRecordView() const {
+		return page_->getRecordView(current_record_);
+	}
+
   /**
    * Returns the next used slot in the page after the given slot or
    * Page::INVALID_SLOT if no slots are used after the given slot.
@@ -109,6 +123,9 @@ class PageIterator {
    * @return  Next used slot after given slot or Page::INVALID_SLOT.
    */
   SlotId getNextUsedSlot(const SlotId start) const {
+    if (PaxPage::isPax(*page_)) {
+      return PaxPage(page_).getNextUsedSlot(start);
+    }
     SlotId slot_number = Page::INVALID_SLOT;
     for (SlotId i = start + 1; i <= page_->header_.num_slots; ++i) {
       const PageSlot* slot = page_->getSlot(i);
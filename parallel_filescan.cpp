@@ -0,0 +1,203 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+#include <thread>
+#include "parallel_filescan.h"
+#include "file_iterator.h"
+#include "page_iterator.h"
+#include "pax_page.h"
+#include "exceptions/badgerdb_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Most pages a worker pins at once when reading a run of consecutive pages.
+ */
+const PageId MAX_RUN_PAGES = 8;
+
+}
+
+const PageId ParallelFileScan::MORSEL_PAGES;
+
+ParallelFileScan::ParallelFileScan(const std::string &name, BufMgr *bufferMgr,
+                                   unsigned workers, PageId pagesPerMorsel)
+  : failed(false)
+{
+  file = new PageFile(name, false);	//dont create new file
+  bufMgr = bufferMgr;
+  numWorkers = workers > 0 ? workers : std::thread::hardware_concurrency();
+  if (numWorkers == 0)
+    numWorkers = 1;
+  morselPages = std::max<PageId>(pagesPerMorsel, 1);
+
+  // The chain is a linked list, so it is split once here rather than by the
+  // workers.
+  for (FileIterator iter = file->begin(); iter != file->end(); iter++)
+    pageNumbers.push_back(iter.getCurrentPageNumber());
+
+  for (unsigned i = 0; i < numWorkers; i++)
+    queues.push_back(std::unique_ptr<MorselQueue>(new MorselQueue()));
+}
+
+ParallelFileScan::~ParallelFileScan()
+{
+  // a destructor must not throw, so errors of the final flush are dropped
+  try
+  {
+    bufMgr->flushFile(file);
+  }
+  catch(const BadgerDbException& e)
+  {
+  }
+  delete file;
+}
+
+void ParallelFileScan::scan(const RecordSink& sink)
+{
+  std::size_t next = 0;
+  for (std::size_t i = 0; next < pageNumbers.size(); i++)
+  {
+    const Morsel morsel = {next, std::min(next + morselPages, pageNumbers.size())};
+    queues[i % numWorkers]->morsels.push_back(morsel);
+    next = morsel.last;
+  }
+  failed = false;
+  error = std::exception_ptr();
+
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < numWorkers; i++)
+    threads.push_back(std::thread(&ParallelFileScan::runWorker, this, i, std::cref(sink)));
+  // the calling thread is worker 0
+  runWorker(0, sink);
+  for (std::size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+
+  if (error)
+    std::rethrow_exception(error);
+}
+
+bool ParallelFileScan::nextMorsel(const unsigned worker, Morsel& morsel)
+{
+  if (failed)
+    return false;
+  {
+    MorselQueue& own = *queues[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.morsels.empty())
+    {
+      morsel = own.morsels.front();
+      own.morsels.pop_front();
+      return true;
+    }
+  }
+  // Steal from the back, away from where the owner is working.
+  for (unsigned i = 1; i < numWorkers; i++)
+  {
+    MorselQueue& victim = *queues[(worker + i) % numWorkers];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.morsels.empty())
+    {
+      morsel = victim.morsels.back();
+      victim.morsels.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ParallelFileScan::runWorker(const unsigned worker, const RecordSink& sink)
+{
+  std::string rowBuffer;
+  try
+  {
+    Morsel morsel;
+    while (nextMorsel(worker, morsel))
+      scanMorsel(worker, morsel, sink, rowBuffer);
+  }
+  catch(...)
+  {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    if (!error)
+      error = std::current_exception();
+    failed = true;
+  }
+
+  // leave nothing behind for a later scan if this one was cut short
+  MorselQueue& own = *queues[worker];
+  std::lock_guard<std::mutex> lock(own.mutex);
+  own.morsels.clear();
+}
+
+void ParallelFileScan::scanMorsel(const unsigned worker, const Morsel& morsel,
+                                  const RecordSink& sink, std::string& rowBuffer)
+{
+  std::size_t i = morsel.first;
+  while (i < morsel.last && !failed)
+  {
+    const PageId first = pageNumbers[i];
+    PageId count = 1;
+    while (count < MAX_RUN_PAGES && i + count < morsel.last &&
+           pageNumbers[i + count] == first + count)
+      count++;
+
+    Page* pages[MAX_RUN_PAGES];
+    try
+    {
+      bufMgr->readPageRange(file, first, count, pages);
+    }
+    catch(const BadgerDbException& e)
+    {
+      // a crowded buffer pool; read just this one
+      count = 1;
+      bufMgr->readPage(file, first, pages[0]);
+    }
+
+    PageId done = 0;
+    try
+    {
+      for (; done < count; done++)
+      {
+        scanPage(worker, pages[done], sink, rowBuffer);
+        bufMgr->unPinPage(file, first + done, false);
+      }
+    }
+    catch(...)
+    {
+      for (; done < count; done++)
+        bufMgr->unPinPage(file, first + done, false);
+      throw;
+    }
+    i += count;
+  }
+}
+
+void ParallelFileScan::scanPage(const unsigned worker, Page* page,
+                                const RecordSink& sink, std::string& rowBuffer)
+{
+  if (PaxPage::isPax(*page))
+  {
+    PaxPage paxPage(page);
+    rowBuffer.resize(paxPage.tupleSize());
+    for (SlotId slot = paxPage.getNextUsedSlot(Page::INVALID_SLOT);
+         slot != Page::INVALID_SLOT; slot = paxPage.getNextUsedSlot(slot))
+    {
+      const RecordId rid = {page->page_number(), slot};
+      paxPage.copyRecord(rid, &rowBuffer[0]);
+      const RecordView record = {rowBuffer.data(),
+                                 static_cast<std::uint16_t>(rowBuffer.size())};
+      sink(worker, rid, record);
+    }
+    return;
+  }
+  for (PageIterator iter = page->begin(); iter != page->end(); iter++)
+    sink(worker, iter.getCurrentRecord(), iter.getRecordView());
+}
+
+}
@@ -0,0 +1,180 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "page.h"
+#include "buffer.h"
+#include "file.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Scans all records of a relation with several threads.
+ *
+ * The page chain of the relation is walked once, up front, and the pages are
+ * cut into morsels of consecutive chain positions.  Morsels are dealt out
+ * round-robin to one queue per worker thread.  A worker takes morsels from
+ * the front of its own queue and, once that is empty, steals from the back
+ * of the others, so workers finishing early help with the rest.  Each worker
+ * pins only the pages of the morsel it is working on.
+ *
+ * Records are handed to a sink together with the number of the worker that
+ * found them, so callers can keep a result per worker and merge them at the
+ * end, or push into a queue of their own.  Records are not returned in any
+ * particular order.
+ *
+ * The relation must not be modified during scan().
+ */
+class ParallelFileScan
+{
+ public:
+  /**
+   * Receives the records of a scan: the number of the calling worker, the
+   * record's id and a view of the record, valid until the sink returns.
+   * Called concurrently by different workers.
+   */
+  typedef std::function<void(unsigned, const RecordId&, const RecordView&)> RecordSink;
+
+  /**
+   * Default number of pages in a morsel.
+   */
+  static const PageId MORSEL_PAGES = 16;
+
+  /**
+   * Opens the relation and splits its pages into morsels.
+   *
+   * @param name        Name of the relation's file.
+   * @param bufMgr      Buffer manager to read pages through.
+   * @param numWorkers  Number of worker threads, 0 for one per core.
+   * @param morselPages Number of pages in a morsel.
+   */
+  ParallelFileScan(const std::string &name, BufMgr *bufMgr,
+                   unsigned numWorkers = 0,
+                   PageId morselPages = MORSEL_PAGES);
+
+  ~ParallelFileScan();
+
+  /**
+   * Scans all records of the relation, calling <sink> for each, and returns
+   * when all workers are done.  If the sink or a worker throws, the other
+   * workers stop after their current page and the first exception is
+   * rethrown here.
+   *
+   * @param sink  Receives the records.
+   */
+  void scan(const RecordSink& sink);
+
+  /**
+   * Returns the number of worker threads.
+   */
+  unsigned getNumWorkers() const { return numWorkers; }
+
+  /**
+   * Returns the number of pages of the relation.
+   */
+  std::size_t getNumPages() const { return pageNumbers.size(); }
+
+ private:
+  /**
+   * Range [first, last) of positions in pageNumbers.
+   */
+  struct Morsel
+  {
+    std::size_t first;
+    std::size_t last;
+  };
+
+  /**
+   * Morsels still to be scanned, owned by one worker.
+   */
+  struct MorselQueue
+  {
+    std::mutex mutex;
+    std::deque<Morsel> morsels;
+  };
+
+  /**
+   * Takes the next morsel for a worker, from its own queue or stolen from
+   * another.
+   *
+   * @param worker  Number of the worker.
+   * @param morsel  Morsel returned in this.
+   * @return  False if there is no work left.
+   */
+  bool nextMorsel(const unsigned worker, Morsel& morsel);
+
+  /**
+   * Body of a worker thread: scans morsels until none are left.
+   */
+  void runWorker(const unsigned worker, const RecordSink& sink);
+
+  /**
+   * Scans the pages of one morsel, reading runs of consecutive page numbers
+   * in one request.
+   */
+  void scanMorsel(const unsigned worker, const Morsel& morsel,
+                  const RecordSink& sink, std::string& rowBuffer);
+
+  /**
+   * Passes all records of a pinned page to the sink.
+   */
+  void scanPage(const unsigned worker, Page* page, const RecordSink& sink,
+                std::string& rowBuffer);
+
+  /**
+   * File which is being scanned.
+   */
+  PageFile      *file;
+
+  /**
+   * Buffer Manager instance used to read pages into the buffer pool.
+   */
+  BufMgr        *bufMgr;
+
+  /**
+   * Number of worker threads.
+   */
+  unsigned      numWorkers;
+
+  /**
+   * Number of pages in a morsel.
+   */
+  PageId        morselPages;
+
+  /**
+   * Numbers of the relation's pages, in chain order.
+   */
+  std::vector<PageId> pageNumbers;
+
+  /**
+   * Work queue of every worker.
+   */
+  std::vector<std::unique_ptr<MorselQueue> > queues;
+
+  /**
+   * Set once a worker failed, so the others stop.
+   */
+  std::atomic<bool> failed;
+
+  /**
+   * First exception thrown by a worker, and the mutex guarding it.
+   */
+  std::exception_ptr error;
+  std::mutex    errorMutex;
+};
+
+}
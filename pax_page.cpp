@@ -0,0 +1,227 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "pax_page.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "exceptions/insufficient_space_exception.h"
+#include "exceptions/invalid_record_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Rounds <n> up to a multiple of 8, so every mini-column starts aligned for
+ * any attribute type.
+ */
+std::size_t align8(const std::size_t n) {
+  return (n + 7) & ~static_cast<std::size_t>(7);
+}
+
+/**
+ * Returns the bytes a PAX page for <schema> needs to hold <capacity> rows.
+ */
+std::size_t paxLayoutSize(const PaxSchema& schema, const std::size_t capacity) {
+  std::size_t size = align8(sizeof(PaxPageHeader) +
+                            schema.numAttributes() * sizeof(PaxColumn));
+  size += align8((capacity + 7) / 8);
+  for (std::uint16_t i = 0; i < schema.numAttributes(); ++i) {
+    size += align8(schema.width(i) * capacity);
+  }
+  return size;
+}
+
+}
+
+void PaxPage::initialize(const PaxSchema& schema) {
+  std::size_t capacity = schema.tupleSize() == 0 ? 0 :
+      Page::DATA_SIZE / schema.tupleSize();
+  while (capacity > 0 && paxLayoutSize(schema, capacity) > Page::DATA_SIZE) {
+    --capacity;
+  }
+  if (capacity == 0) {
+    throw InsufficientSpaceException(page_->page_number(), schema.tupleSize(),
+                                     Page::DATA_SIZE);
+  }
+
+  // Slotted inserts must not touch the page, so it reports no free space.
+  PageHeader& page_header = page_->header_;
+  page_header.layout = PAX_LAYOUT;
+  page_header.free_space_lower_bound = Page::DATA_SIZE;
+  page_header.free_space_upper_bound = Page::DATA_SIZE;
+  page_header.num_slots = 0;
+  page_header.num_free_slots = 0;
+  page_header.first_free_slot = Page::INVALID_SLOT;
+  page_header.fragmented_bytes = 0;
+  for (std::size_t i = 0; i < MAX_ZONE_MAPS; ++i) {
+    if (page_header.zone_maps[i].state == ZONE_MAP_VALID) {
+      page_header.zone_maps[i].state = ZONE_MAP_EMPTY;
+    }
+  }
+  memset(page_->data_, 0, Page::DATA_SIZE);
+
+  PaxPageHeader& pax_header = header();
+  pax_header.num_attributes = schema.numAttributes();
+  pax_header.capacity = capacity;
+  pax_header.num_rows = 0;
+  pax_header.num_free_rows = 0;
+  pax_header.tuple_size = schema.tupleSize();
+  std::size_t offset = align8(sizeof(PaxPageHeader) +
+                              schema.numAttributes() * sizeof(PaxColumn));
+  pax_header.bitmap_offset = offset;
+  offset += align8((capacity + 7) / 8);
+  for (std::uint16_t i = 0; i < schema.numAttributes(); ++i) {
+    column(i).width = schema.width(i);
+    column(i).offset = offset;
+    offset += align8(schema.width(i) * capacity);
+  }
+}
+
+RecordId PaxPage::insertRecord(const std::string& record_data) {
+  PaxPageHeader& pax_header = header();
+  if (record_data.length() > pax_header.tuple_size) {
+    throw InsufficientSpaceException(page_->page_number(), record_data.length(),
+                                     pax_header.tuple_size);
+  }
+  if (!hasSpaceForRecord()) {
+    throw InsufficientSpaceException(page_->page_number(), record_data.length(),
+                                     0 /* space_available */);
+  }
+
+  std::uint16_t row = pax_header.num_rows;
+  if (pax_header.num_free_rows > 0) {
+    // Reuse the first hole left by a delete.
+    for (row = 0; row < pax_header.num_rows; ++row) {
+      if (!isUsed(row + 1)) {
+        break;
+      }
+    }
+    --pax_header.num_free_rows;
+  } else {
+    ++pax_header.num_rows;
+  }
+  bitmap()[row / 8] |= 1 << (row % 8);
+  writeRow(row, record_data);
+  page_->updateZoneMaps(record_data.data(), record_data.length());
+  return {page_->page_number(), static_cast<SlotId>(row + 1)};
+}
+
+std::string PaxPage::getRecord(const RecordId& record_id) const {
+  std::string record(header().tuple_size, '\0');
+  copyRecord(record_id, &record[0]);
+  return record;
+}
+
+void PaxPage::copyRecord(const RecordId& record_id, char* out) const {
+  validateRecordId(record_id);
+  const std::uint16_t row = record_id.slot_number - 1;
+  for (std::uint16_t i = 0; i < header().num_attributes; ++i) {
+    const PaxColumn& col = column(i);
+    memcpy(out, page_->data_ + col.offset + row * col.width, col.width);
+    out += col.width;
+  }
+}
+
+void PaxPage::updateRecord(const RecordId& record_id,
+                           const std::string& record_data) {
+  validateRecordId(record_id);
+  if (record_data.length() > header().tuple_size) {
+    throw InsufficientSpaceException(page_->page_number(), record_data.length(),
+                                     header().tuple_size);
+  }
+  writeRow(record_id.slot_number - 1, record_data);
+  page_->updateZoneMaps(record_data.data(), record_data.length());
+}
+
+void PaxPage::deleteRecord(const RecordId& record_id) {
+  validateRecordId(record_id);
+  PaxPageHeader& pax_header = header();
+  const std::uint16_t row = record_id.slot_number - 1;
+  bitmap()[row / 8] &= ~(1 << (row % 8));
+  ++pax_header.num_free_rows;
+
+  // Give back the unused rows at the end, as slotted pages do with slots.
+  while (pax_header.num_rows > 0 && !isUsed(pax_header.num_rows)) {
+    --pax_header.num_rows;
+    --pax_header.num_free_rows;
+  }
+}
+
+bool PaxPage::hasSpaceForRecord() const {
+  const PaxPageHeader& pax_header = header();
+  return pax_header.num_free_rows > 0 ||
+      pax_header.num_rows < pax_header.capacity;
+}
+
+bool PaxPage::isUsed(const SlotId slot_number) const {
+  if (slot_number == Page::INVALID_SLOT || slot_number > header().num_rows) {
+    return false;
+  }
+  const std::uint16_t row = slot_number - 1;
+  return (bitmap()[row / 8] >> (row % 8)) & 1;
+}
+
+SlotId PaxPage::getNextUsedSlot(const SlotId start) const {
+  for (SlotId i = start + 1; i <= header().num_rows; ++i) {
+    if (isUsed(i)) {
+      return i;
+    }
+  }
+  return Page::INVALID_SLOT;
+}
+
+const char* PaxPage::getField(const RecordId& record_id,
+                              const std::uint16_t offset,
+                              const std::uint16_t length) const {
+  const std::uint16_t row = record_id.slot_number - 1;
+  std::size_t start = 0;
+  for (std::uint16_t i = 0; i < header().num_attributes; ++i) {
+    const PaxColumn& col = column(i);
+    if (offset < start + col.width) {
+      if (offset + length > start + col.width) {
+        return NULL;
+      }
+      return page_->data_ + col.offset + row * col.width + (offset - start);
+    }
+    start += col.width;
+  }
+  return NULL;
+}
+
+ColumnView PaxPage::getColumnView(const std::uint16_t attr) const {
+  const PaxColumn& col = column(attr);
+  const ColumnView view = {page_->data_ + col.offset, col.width,
+                           header().num_rows, bitmap()};
+  return view;
+}
+
+void PaxPage::validateRecordId(const RecordId& record_id) const {
+  if (record_id.page_number != page_->page_number() ||
+      !isUsed(record_id.slot_number)) {
+    throw InvalidRecordException(record_id, page_->page_number());
+  }
+}
+
+void PaxPage::writeRow(const std::uint16_t row, const std::string& record_data) {
+  std::size_t position = 0;
+  for (std::uint16_t i = 0; i < header().num_attributes; ++i) {
+    const PaxColumn& col = column(i);
+    char* value = page_->data_ + col.offset + row * col.width;
+    const std::size_t length = position < record_data.length() ?
+        std::min<std::size_t>(col.width, record_data.length() - position) : 0;
+    if (length > 0) {
+      memcpy(value, record_data.data() + position, length);
+    }
+    memset(value + length, 0, col.width - length);
+    position += col.width;
+  }
+}
+
+}
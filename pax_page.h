@@ -0,0 +1,341 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Widths of the attributes of a fixed-width relation, in the order
+ *        they appear in a tuple.
+ */
+class PaxSchema {
+ public:
+  /**
+   * Constructs a schema.
+   *
+   * @param widths  Width in bytes of every attribute.
+   */
+  explicit PaxSchema(const std::vector<std::uint16_t>& widths)
+      : widths_(widths), tuple_size_(0) {
+    for (std::size_t i = 0; i < widths_.size(); ++i) {
+      tuple_size_ += widths_[i];
+    }
+  }
+
+  /**
+   * Returns the number of attributes.
+   */
+  std::uint16_t numAttributes() const { return widths_.size(); }
+
+  /**
+   * Returns the width in bytes of the given attribute.
+   *
+   * @param attr  Number of attribute, starting at 0.
+   */
+  std::uint16_t width(const std::uint16_t attr) const { return widths_[attr]; }
+
+  /**
+   * Returns the size in bytes of a whole tuple.
+   */
+  std::uint16_t tupleSize() const { return tuple_size_; }
+
+ private:
+  /**
+   * Width in bytes of every attribute.
+   */
+  std::vector<std::uint16_t> widths_;
+
+  /**
+   * Sum of <widths_>.
+   */
+  std::uint16_t tuple_size_;
+};
+
+/**
+ * @brief Values of one attribute for all rows of a PAX page.
+ *
+ * The value of row slot s (1-based, as in RecordId) starts at
+ * data + (s - 1) * stride.  Slots whose bit in <present> is clear hold no
+ * record.  Like RecordView, this points into the page.
+ */
+struct ColumnView {
+  /**
+   * Value of the first row slot.
+   */
+  const char* data;
+
+  /**
+   * Distance in bytes between values of consecutive row slots.
+   */
+  std::uint16_t stride;
+
+  /**
+   * Number of row slots, used or not.
+   */
+  SlotId count;
+
+  /**
+   * Presence bitmap, bit (s - 1) set if row slot s holds a record.
+   */
+  const std::uint8_t* present;
+};
+
+/**
+ * @brief Header of a PAX page, at the start of its data area.
+ */
+struct PaxPageHeader {
+  /**
+   * Number of attributes; a PaxColumn for each follows the header.
+   */
+  std::uint16_t num_attributes;
+
+  /**
+   * Number of rows the page can hold.
+   */
+  std::uint16_t capacity;
+
+  /**
+   * Number of row slots allocated, used or not.
+   */
+  std::uint16_t num_rows;
+
+  /**
+   * Number of row slots allocated but not in use.
+   */
+  std::uint16_t num_free_rows;
+
+  /**
+   * Offset of the presence bitmap in the data area.
+   */
+  std::uint16_t bitmap_offset;
+
+  /**
+   * Size in bytes of a whole tuple.
+   */
+  std::uint16_t tuple_size;
+};
+
+/**
+ * @brief Location of one mini-column of a PAX page.
+ */
+struct PaxColumn {
+  /**
+   * Width in bytes of the attribute.
+   */
+  std::uint16_t width;
+
+  /**
+   * Offset of the attribute's first value in the data area.
+   */
+  std::uint16_t offset;
+};
+
+/**
+ * @brief Accessor for a page holding fixed-width tuples in PAX layout.
+ *
+ * Within a PAX page each attribute is stored in a mini-column of its own, so
+ * the values of one attribute for all rows of the page are contiguous, while
+ * the page as a whole still holds complete tuples and lives in an ordinary
+ * PageFile.  The layout is described in the page itself, so pages can be read
+ * without knowing the schema.  Rows are identified by RecordIds like slotted
+ * records, with row slots numbered from 1.
+ *
+ * A PaxPage refers to a Page owned by someone else, such as a buffer pool
+ * frame, and must not outlive it.
+ *
+ * @warning This class is not threadsafe.
+ */
+class PaxPage {
+ public:
+  /**
+   * Constructs an accessor for the given page.
+   *
+   * @param page  Page to access.
+   */
+  explicit PaxPage(Page* page) : page_(page) {}
+
+  /**
+   * Formats the page as an empty PAX page for tuples of the given schema.
+   * The page number and next page pointer are kept.
+   *
+   * @param schema  Attributes of the tuples.
+   * @throws  InsufficientSpaceException  If not even one tuple fits in a page.
+   */
+  void initialize(const PaxSchema& schema);
+
+  /**
+   * Returns true if the given page is in PAX layout.
+   *
+   * @param page  Page to check.
+   */
+  static bool isPax(const Page& page) { return page.layout() == PAX_LAYOUT; }
+
+  /**
+   * Inserts a new tuple into the page.  Shorter records are padded with
+   * zeros.
+   *
+   * @param record_data  Bytes that compose the tuple.
+   * @return  ID of the newly inserted record.
+   * @throws  InsufficientSpaceException  If the page is full or the record
+   *                                      is longer than a tuple.
+   */
+  RecordId insertRecord(const std::string& record_data);
+
+  /**
+   * Returns a copy of the tuple with the given ID.
+   *
+   * @param record_id  ID of the record to return.
+   * @return  The tuple.
+   * @throws  InvalidRecordException  If the ID does not refer to a row of
+   *                                  this page.
+   */
+  std::string getRecord(const RecordId& record_id) const;
+
+  /**
+   * Copies the tuple with the given ID into <out>, which must hold tupleSize()
+   * bytes.
+   *
+   * @param record_id  ID of the record to copy.
+   * @param out        Buffer receiving the tuple.
+   * @throws  InvalidRecordException  If the ID does not refer to a row of
+   *                                  this page.
+   */
+  void copyRecord(const RecordId& record_id, char* out) const;
+
+  /**
+   * Replaces the tuple with the given ID.
+   *
+   * @param record_id   ID of record to update.
+   * @param record_data Updated bytes that compose the tuple.
+   * @throws  InvalidRecordException      If the ID does not refer to a row
+   *                                      of this page.
+   * @throws  InsufficientSpaceException  If the record is longer than a
+   *                                      tuple.
+   */
+  void updateRecord(const RecordId& record_id, const std::string& record_data);
+
+  /**
+   * Deletes the tuple with the given ID.
+   *
+   * @param record_id   ID of the record to delete.
+   * @throws  InvalidRecordException  If the ID does not refer to a row of
+   *                                  this page.
+   */
+  void deleteRecord(const RecordId& record_id);
+
+  /**
+   * Returns true if the page has room for another tuple.
+   */
+  bool hasSpaceForRecord() const;
+
+  /**
+   * Returns true if the given row slot holds a record.
+   *
+   * @param slot_number   Row slot, starting at 1.
+   */
+  bool isUsed(const SlotId slot_number) const;
+
+  /**
+   * Returns the next used row slot after the given one, or Page::INVALID_SLOT
+   * if there is none.
+   *
+   * @param start   Slot to start search at.
+   */
+  SlotId getNextUsedSlot(const SlotId start) const;
+
+  /**
+   * Returns a pointer to the <length> bytes at <offset> of the tuple in the
+   * given row slot, which must be in use, if they lie within a single
+   * attribute.
+   *
+   * @param record_id   ID of the record.
+   * @param offset      Byte offset in the tuple.
+   * @param length      Number of bytes.
+   * @return  Pointer into the page, or NULL if the bytes span attributes.
+   */
+  const char* getField(const RecordId& record_id, const std::uint16_t offset,
+                       const std::uint16_t length) const;
+
+  /**
+   * Returns the values of an attribute for all row slots of the page.
+   *
+   * @param attr  Number of attribute, starting at 0.
+   * @return  View of the attribute's mini-column.
+   */
+  ColumnView getColumnView(const std::uint16_t attr) const;
+
+  /**
+   * Returns the number of attributes of the tuples on the page.
+   */
+  std::uint16_t numAttributes() const { return header().num_attributes; }
+
+  /**
+   * Returns the size in bytes of a tuple.
+   */
+  std::uint16_t tupleSize() const { return header().tuple_size; }
+
+  /**
+   * Returns the number of tuples the page can hold.
+   */
+  std::uint16_t capacity() const { return header().capacity; }
+
+ private:
+  /**
+   * Returns the PAX header at the start of the data area.
+   */
+  PaxPageHeader& header() const {
+    return *reinterpret_cast<PaxPageHeader*>(page_->data_);
+  }
+
+  /**
+   * Returns the location of an attribute's mini-column.
+   *
+   * @param attr  Number of attribute, starting at 0.
+   */
+  PaxColumn& column(const std::uint16_t attr) const {
+    return reinterpret_cast<PaxColumn*>(page_->data_ + sizeof(PaxPageHeader))[attr];
+  }
+
+  /**
+   * Returns the presence bitmap.
+   */
+  std::uint8_t* bitmap() const {
+    return reinterpret_cast<std::uint8_t*>(page_->data_ + header().bitmap_offset);
+  }
+
+  /**
+   * Throws an exception if the given record ID does not refer to a used row
+   * of this page.
+   *
+   * @param record_id   Record ID to validate.
+   * @throws  InvalidRecordException  If the ID is not valid.
+   */
+  void validateRecordId(const RecordId& record_id) const;
+
+  /**
+   * Spreads a tuple over the mini-columns at the given row.
+   *
+   * @param row           Row index, starting at 0.
+   * @param record_data   Bytes that compose the tuple.
+   */
+  void writeRow(const std::uint16_t row, const std::string& record_data);
+
+  /**
+   * Page being accessed.
+   */
+  Page* page_;
+};
+
+}
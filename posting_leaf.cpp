@@ -0,0 +1,521 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "posting_leaf.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "exceptions/insufficient_space_exception.h"
+
+namespace badgerdb {
+
+const std::uint16_t PostingLeaf::MAX_KEY_LENGTH;
+const std::uint16_t PostingLeaf::MAX_INLINE_LIST;
+
+namespace {
+
+/**
+ * Bytes of an overflow page available to encoded RecordIds.
+ */
+const std::size_t OVERFLOW_CAPACITY =
+    Page::SIZE - sizeof(PostingOverflowHeader);
+
+/**
+ * Longest varint encoding of the difference between two RecordIds.
+ */
+const std::size_t MAX_VARINT_LENGTH = 10;
+
+/**
+ * Maps a RecordId to an integer of the same order.
+ */
+std::uint64_t ridValue(const RecordId& rid) {
+  return static_cast<std::uint64_t>(rid.page_number) << 16 | rid.slot_number;
+}
+
+bool ridLess(const RecordId& a, const RecordId& b) {
+  return ridValue(a) < ridValue(b);
+}
+
+std::size_t putVarint(std::uint64_t value, char* out) {
+  std::size_t length = 0;
+  while (value >= 0x80) {
+    out[length++] = static_cast<char>(value | 0x80);
+    value >>= 7;
+  }
+  out[length++] = static_cast<char>(value);
+  return length;
+}
+
+/**
+ * Encodes <rid> relative to <previous>, which sorts before it.
+ */
+std::size_t putRid(const RecordId& rid, const RecordId& previous, char* out) {
+  return putVarint(ridValue(rid) - ridValue(previous), out);
+}
+
+RecordId firstRid() {
+  RecordId rid;
+  rid.page_number = 0;
+  rid.slot_number = 0;
+  return rid;
+}
+
+PostingOverflowHeader* overflowHeader(Page* page) {
+  return reinterpret_cast<PostingOverflowHeader*>(page);
+}
+
+char* overflowData(Page* page) {
+  return reinterpret_cast<char*>(page) + sizeof(PostingOverflowHeader);
+}
+
+/**
+ * Stores the first and last page of a spilled posting list.
+ */
+std::string chainList(const PageId first, const PageId last) {
+  std::string list(2 * sizeof(PageId), '\0');
+  memcpy(&list[0], &first, sizeof(first));
+  memcpy(&list[sizeof(PageId)], &last, sizeof(last));
+  return list;
+}
+
+void readChain(const std::string& list, PageId& first, PageId& last) {
+  memcpy(&first, list.data(), sizeof(first));
+  memcpy(&last, list.data() + sizeof(PageId), sizeof(last));
+}
+
+}
+
+void PostingLeaf::encodeRids(const std::vector<RecordId>& rids,
+                             RecordId previous, std::string& out) {
+  char varint[MAX_VARINT_LENGTH];
+  for (std::size_t i = 0; i < rids.size(); ++i) {
+    out.append(varint, putRid(rids[i], previous, varint));
+    previous = rids[i];
+  }
+}
+
+void PostingLeaf::decodeRids(const char* in, const std::size_t length,
+                             RecordId previous, std::vector<RecordId>& rids) {
+  std::uint64_t value = ridValue(previous);
+  std::size_t i = 0;
+  while (i < length) {
+    std::uint64_t delta = 0;
+    int shift = 0;
+    unsigned char byte;
+    do {
+      byte = static_cast<unsigned char>(in[i++]);
+      delta |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+    value += delta;
+    RecordId rid;
+    rid.page_number = static_cast<PageId>(value >> 16);
+    rid.slot_number = static_cast<SlotId>(value & 0xffff);
+    rids.push_back(rid);
+  }
+}
+
+void PostingLeaf::initialize(const PageId right_sibling) {
+  PostingLeafHeader* leaf = header();
+  leaf->num_keys = 0;
+  leaf->heap_begin = Page::SIZE;
+  leaf->fragmented = 0;
+  leaf->right_sibling = right_sibling;
+}
+
+PostingSlot PostingLeaf::slot(const std::uint16_t i) const {
+  PostingSlot slot;
+  memcpy(&slot, &slots()[i], sizeof(slot));
+  return slot;
+}
+
+std::string PostingLeaf::key(const std::uint16_t i) const {
+  const PostingSlot entry = slot(i);
+  return std::string(bytes() + entry.offset, entry.key_length);
+}
+
+int PostingLeaf::compare(const std::uint16_t i, const std::string& key) const {
+  const PostingSlot entry = slot(i);
+  const int cmp = memcmp(bytes() + entry.offset, key.data(),
+                         std::min<std::size_t>(entry.key_length, key.length()));
+  if (cmp != 0) {
+    return cmp;
+  }
+  return (entry.key_length > key.length()) - (entry.key_length < key.length());
+}
+
+std::uint16_t PostingLeaf::lowerBound(const std::string& key) const {
+  std::uint16_t low = 0;
+  std::uint16_t high = numKeys();
+  while (low < high) {
+    const std::uint16_t mid = low + (high - low) / 2;
+    if (compare(mid, key) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+std::uint32_t PostingLeaf::count(const std::uint16_t i) const {
+  return slot(i).count;
+}
+
+bool PostingLeaf::isSpilled(const std::uint16_t i) const {
+  return slot(i).spilled != 0;
+}
+
+void PostingLeaf::rids(const std::uint16_t i,
+                       std::vector<RecordId>& rids) const {
+  Entry entry;
+  readEntry(i, entry);
+  if (!entry.spilled) {
+    decodeRids(entry.list.data(), entry.list.length(), firstRid(), rids);
+    return;
+  }
+
+  rids.reserve(rids.size() + entry.count);
+  PageId page_number;
+  PageId last;
+  readChain(entry.list, page_number, last);
+  while (page_number != Page::INVALID_NUMBER) {
+    Page* page;
+    buf_mgr_->readPage(file_, page_number, page);
+    const PostingOverflowHeader* overflow = overflowHeader(page);
+    decodeRids(overflowData(page), overflow->length, firstRid(), rids);
+    const PageId next = overflow->next;
+    buf_mgr_->unPinPage(file_, page_number, false);
+    page_number = next;
+  }
+}
+
+std::uint16_t PostingLeaf::freeSpace() const {
+  const std::size_t slots_end =
+      sizeof(PostingLeafHeader) + numKeys() * sizeof(PostingSlot);
+  return header()->heap_begin - slots_end + header()->fragmented;
+}
+
+bool PostingLeaf::insert(const std::string& key, const RecordId& rid) {
+  if (key.length() > MAX_KEY_LENGTH) {
+    throw InsufficientSpaceException(Page::INVALID_NUMBER, key.length(),
+                                     MAX_KEY_LENGTH);
+  }
+
+  const std::uint16_t i = lowerBound(key);
+  Entry entry;
+  if (i == numKeys() || compare(i, key) != 0) {
+    entry.key = key;
+    entry.spilled = 0;
+    entry.count = 1;
+    encodeRids(std::vector<RecordId>(1, rid), firstRid(), entry.list);
+    return writeEntry(i, entry, false);
+  }
+
+  // Spilling shrinks the entry, and the chain's page numbers take the same
+  // room, so only a list growing in the leaf can fail to fit.
+  readEntry(i, entry);
+  return !addRid(entry, rid) || writeEntry(i, entry, true);
+}
+
+bool PostingLeaf::addRid(Entry& entry, const RecordId& rid) {
+  if (entry.spilled) {
+    if (!insertSpilled(entry, rid)) {
+      return false;
+    }
+    ++entry.count;
+    return true;
+  }
+
+  std::vector<RecordId> list;
+  list.reserve(entry.count + 1);
+  decodeRids(entry.list.data(), entry.list.length(), firstRid(), list);
+  std::vector<RecordId>::iterator position =
+      std::lower_bound(list.begin(), list.end(), rid, ridLess);
+  if (position != list.end() && *position == rid) {
+    return false;
+  }
+  list.insert(position, rid);
+
+  std::string encoded;
+  encodeRids(list, firstRid(), encoded);
+  if (encoded.length() <= MAX_INLINE_LIST) {
+    entry.list.swap(encoded);
+    ++entry.count;
+    return true;
+  }
+
+  PageId first;
+  PageId last;
+  spill(list, first, last);
+  entry.list = chainList(first, last);
+  entry.spilled = 1;
+  ++entry.count;
+  return true;
+}
+
+void PostingLeaf::readEntry(const std::uint16_t i, Entry& entry) const {
+  const PostingSlot slot_i = slot(i);
+  const char* data = bytes() + slot_i.offset;
+  entry.key.assign(data, slot_i.key_length);
+  entry.list.assign(data + slot_i.key_length, slot_i.list_length);
+  entry.spilled = slot_i.spilled;
+  entry.count = slot_i.count;
+}
+
+bool PostingLeaf::writeEntry(const std::uint16_t i, const Entry& entry,
+                             const bool replace) {
+  const std::size_t size = entry.key.length() + entry.list.length();
+  PostingSlot new_slot;
+  new_slot.key_length = entry.key.length();
+  new_slot.list_length = entry.list.length();
+  new_slot.spilled = entry.spilled;
+  new_slot.count = entry.count;
+
+  PostingLeafHeader* leaf = header();
+  std::size_t reclaimed = 0;
+  if (replace) {
+    const PostingSlot old_slot = slot(i);
+    reclaimed = old_slot.key_length + old_slot.list_length;
+    if (size <= reclaimed) {
+      new_slot.offset = old_slot.offset;
+      memcpy(bytes() + new_slot.offset, entry.key.data(), entry.key.length());
+      memcpy(bytes() + new_slot.offset + entry.key.length(),
+             entry.list.data(), entry.list.length());
+      leaf->fragmented += reclaimed - size;
+      memcpy(&slots()[i], &new_slot, sizeof(new_slot));
+      return true;
+    }
+  }
+
+  const std::size_t slot_growth = replace ? 0 : sizeof(PostingSlot);
+  if (size + slot_growth > freeSpace() + reclaimed) {
+    return false;
+  }
+
+  if (replace) {
+    // Drop the old copy so that a compaction does not keep it.
+    PostingSlot old_slot = slot(i);
+    old_slot.key_length = 0;
+    old_slot.list_length = 0;
+    memcpy(&slots()[i], &old_slot, sizeof(old_slot));
+    leaf->fragmented += reclaimed;
+  }
+  const std::size_t slots_end = sizeof(PostingLeafHeader) +
+                                numKeys() * sizeof(PostingSlot) + slot_growth;
+  if (leaf->heap_begin < slots_end + size) {
+    compact();
+  }
+
+  leaf->heap_begin -= size;
+  new_slot.offset = leaf->heap_begin;
+  memcpy(bytes() + new_slot.offset, entry.key.data(), entry.key.length());
+  memcpy(bytes() + new_slot.offset + entry.key.length(), entry.list.data(),
+         entry.list.length());
+  if (!replace) {
+    PostingSlot* leaf_slots = slots();
+    memmove(leaf_slots + i + 1, leaf_slots + i,
+            (leaf->num_keys - i) * sizeof(PostingSlot));
+    ++leaf->num_keys;
+  }
+  memcpy(&slots()[i], &new_slot, sizeof(new_slot));
+  return true;
+}
+
+void PostingLeaf::compact() {
+  char copy[Page::SIZE];
+  memcpy(copy, bytes(), Page::SIZE);
+
+  PostingLeafHeader* leaf = header();
+  leaf->heap_begin = Page::SIZE;
+  leaf->fragmented = 0;
+  for (std::uint16_t i = 0; i < numKeys(); ++i) {
+    PostingSlot slot_i = slot(i);
+    const std::size_t size = slot_i.key_length + slot_i.list_length;
+    leaf->heap_begin -= size;
+    memcpy(bytes() + leaf->heap_begin, copy + slot_i.offset, size);
+    slot_i.offset = leaf->heap_begin;
+    memcpy(&slots()[i], &slot_i, sizeof(slot_i));
+  }
+}
+
+std::string PostingLeaf::split(PostingLeaf& right,
+                               const PageId right_page_number,
+                               const std::string& key, const RecordId& rid) {
+  std::vector<Entry> entries(numKeys());
+  for (std::uint16_t i = 0; i < numKeys(); ++i) {
+    readEntry(i, entries[i]);
+  }
+  const std::uint16_t position = lowerBound(key);
+  if (position < numKeys() && compare(position, key) == 0) {
+    addRid(entries[position], rid);
+  } else {
+    Entry entry;
+    entry.key = key;
+    entry.spilled = 0;
+    entry.count = 1;
+    encodeRids(std::vector<RecordId>(1, rid), firstRid(), entry.list);
+    entries.insert(entries.begin() + position, entry);
+  }
+
+  // Split where the first half takes about half the space.  Each half then
+  // takes at most half of a full leaf and one entry, which always fits.
+  std::size_t total = 0;
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    total += sizeof(PostingSlot) + entries[i].key.length() +
+             entries[i].list.length();
+  }
+  std::size_t middle = 0;
+  std::size_t used = 0;
+  while (middle < entries.size() - 1 && (middle == 0 || 2 * used < total)) {
+    used += sizeof(PostingSlot) + entries[middle].key.length() +
+            entries[middle].list.length();
+    ++middle;
+  }
+
+  right.initialize(rightSibling());
+  for (std::size_t i = middle; i < entries.size(); ++i) {
+    right.writeEntry(i - middle, entries[i], false);
+  }
+  initialize(right_page_number);
+  for (std::size_t i = 0; i < middle; ++i) {
+    writeEntry(i, entries[i], false);
+  }
+  return entries[middle].key;
+}
+
+std::size_t PostingLeaf::fillOverflow(Page* page,
+                                      const std::vector<RecordId>& rids,
+                                      const std::size_t begin,
+                                      const std::size_t end) {
+  PostingOverflowHeader* overflow = overflowHeader(page);
+  char* data = overflowData(page);
+  std::size_t length = 0;
+  RecordId previous = firstRid();
+  std::size_t i = begin;
+  for (; i < end; ++i) {
+    char varint[MAX_VARINT_LENGTH];
+    const std::size_t varint_length = putRid(rids[i], previous, varint);
+    if (length + varint_length > OVERFLOW_CAPACITY) {
+      break;
+    }
+    memcpy(data + length, varint, varint_length);
+    length += varint_length;
+    previous = rids[i];
+  }
+  overflow->count = i - begin;
+  overflow->length = length;
+  overflow->last = previous;
+  return i;
+}
+
+void PostingLeaf::spill(const std::vector<RecordId>& rids, PageId& first,
+                        PageId& last) {
+  first = Page::INVALID_NUMBER;
+  Page* previous = NULL;
+  std::size_t begin = 0;
+  while (begin < rids.size()) {
+    PageId page_number;
+    Page* page;
+    buf_mgr_->allocPage(file_, page_number, page);
+    overflowHeader(page)->next = Page::INVALID_NUMBER;
+    begin = fillOverflow(page, rids, begin, rids.size());
+    if (previous == NULL) {
+      first = page_number;
+    } else {
+      overflowHeader(previous)->next = page_number;
+      buf_mgr_->unPinPage(file_, last, true);
+    }
+    previous = page;
+    last = page_number;
+  }
+  buf_mgr_->unPinPage(file_, last, true);
+}
+
+bool PostingLeaf::insertSpilled(Entry& entry, const RecordId& rid) {
+  PageId first;
+  PageId last;
+  readChain(entry.list, first, last);
+
+  // Appends go to the end of the chain without walking it.
+  Page* page;
+  buf_mgr_->readPage(file_, last, page);
+  PostingOverflowHeader* overflow = overflowHeader(page);
+  if (ridLess(overflow->last, rid)) {
+    char varint[MAX_VARINT_LENGTH];
+    const std::size_t varint_length = putRid(rid, overflow->last, varint);
+    if (overflow->length + varint_length <= OVERFLOW_CAPACITY) {
+      memcpy(overflowData(page) + overflow->length, varint, varint_length);
+      overflow->length += varint_length;
+      ++overflow->count;
+      overflow->last = rid;
+    } else {
+      PageId new_page_number;
+      Page* new_page;
+      buf_mgr_->allocPage(file_, new_page_number, new_page);
+      overflowHeader(new_page)->next = Page::INVALID_NUMBER;
+      fillOverflow(new_page, std::vector<RecordId>(1, rid), 0, 1);
+      overflow->next = new_page_number;
+      buf_mgr_->unPinPage(file_, new_page_number, true);
+      entry.list = chainList(first, new_page_number);
+    }
+    buf_mgr_->unPinPage(file_, last, true);
+    return true;
+  }
+  buf_mgr_->unPinPage(file_, last, false);
+
+  // Otherwise merge into the first page whose last RecordId is not smaller.
+  PageId page_number = first;
+  while (true) {
+    buf_mgr_->readPage(file_, page_number, page);
+    overflow = overflowHeader(page);
+    if (!ridLess(overflow->last, rid)) {
+      break;
+    }
+    const PageId next = overflow->next;
+    buf_mgr_->unPinPage(file_, page_number, false);
+    page_number = next;
+  }
+
+  std::vector<RecordId> rids;
+  rids.reserve(overflow->count + 1);
+  decodeRids(overflowData(page), overflow->length, firstRid(), rids);
+  std::vector<RecordId>::iterator position =
+      std::lower_bound(rids.begin(), rids.end(), rid, ridLess);
+  if (*position == rid) {
+    buf_mgr_->unPinPage(file_, page_number, false);
+    return false;
+  }
+  rids.insert(position, rid);
+  const PageId new_page_number = writeOverflow(page, rids);
+  if (page_number == last && new_page_number != Page::INVALID_NUMBER) {
+    entry.list = chainList(first, new_page_number);
+  }
+  buf_mgr_->unPinPage(file_, page_number, true);
+  return true;
+}
+
+PageId PostingLeaf::writeOverflow(Page* page,
+                                  const std::vector<RecordId>& rids) {
+  if (fillOverflow(page, rids, 0, rids.size()) == rids.size()) {
+    return Page::INVALID_NUMBER;
+  }
+
+  const std::size_t middle = rids.size() / 2;
+  fillOverflow(page, rids, 0, middle);
+  PageId new_page_number;
+  Page* new_page;
+  buf_mgr_->allocPage(file_, new_page_number, new_page);
+  overflowHeader(new_page)->next = overflowHeader(page)->next;
+  fillOverflow(new_page, rids, middle, rids.size());
+  overflowHeader(page)->next = new_page_number;
+  buf_mgr_->unPinPage(file_, new_page_number, true);
+  return new_page_number;
+}
+
+}
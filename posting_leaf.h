@@ -0,0 +1,353 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Header of a PostingLeaf, at the start of the page.
+ */
+struct PostingLeafHeader {
+  /**
+   * Number of distinct keys in the leaf.
+   */
+  std::uint16_t num_keys;
+
+  /**
+   * Offset of the first byte of the entry heap, which grows down from the
+   * end of the page.
+   */
+  std::uint16_t heap_begin;
+
+  /**
+   * Bytes of the heap left unused by entries that were moved or shrunk.
+   */
+  std::uint16_t fragmented;
+
+  /**
+   * Right sibling of the leaf.
+   */
+  PageId right_sibling;
+};
+
+/**
+ * @brief Position of one distinct key of a PostingLeaf, in the slot array
+ *        after the header.
+ */
+struct PostingSlot {
+  /**
+   * Offset of the entry in the page: the key, then its posting list.
+   */
+  std::uint16_t offset;
+
+  std::uint16_t key_length;
+
+  /**
+   * Bytes of the posting list after the key: the encoded list, or the first
+   * and last overflow page numbers of a spilled list.
+   */
+  std::uint16_t list_length;
+
+  /**
+   * 1 if the posting list is on overflow pages.
+   */
+  std::uint16_t spilled;
+
+  /**
+   * Number of RecordIds in the posting list.
+   */
+  std::uint32_t count;
+};
+
+/**
+ * @brief Header of a posting list overflow page.
+ */
+struct PostingOverflowHeader {
+  /**
+   * Next page of the posting list, or Page::INVALID_NUMBER.
+   */
+  PageId next;
+
+  /**
+   * Number of RecordIds on this page.
+   */
+  std::uint16_t count;
+
+  /**
+   * Bytes of encoded RecordIds after the header.
+   */
+  std::uint16_t length;
+
+  /**
+   * Largest RecordId on this page.
+   */
+  RecordId last;
+};
+
+/**
+ * @brief Accessor for a B+Tree leaf that stores each distinct key once,
+ *        followed by a posting list of the RecordIds having that key.
+ *
+ * Keys are byte strings, such as those of a KeyCodec, of up to
+ * MAX_KEY_LENGTH bytes, ordered like memcmp with shorter keys first on a
+ * tie.  A posting list is sorted by page, then slot, and encoded as the
+ * varint differences between consecutive RecordIds, so the rids of one key
+ * clustered on a few heap pages take a byte or two each.  The slot array
+ * after the header is sorted by key and grows up while entries are
+ * appended to a heap growing down from the end of the page.
+ *
+ * Once the list of a key would take more than MAX_INLINE_LIST bytes, it
+ * spills to a chain of overflow pages of the index file, each encoding its
+ * part of the list on its own, and the leaf keeps only the first and last
+ * page numbers of the chain.  RecordIds past the end of the list are
+ * appended to the last page; others are merged into the page covering them,
+ * which is split when full.  A leaf therefore holds at least
+ * Page::SIZE / (MAX_KEY_LENGTH + MAX_INLINE_LIST) distinct keys however
+ * skewed they are, and a low-cardinality index is mostly encoded RecordIds.
+ *
+ * Like the other B+Tree nodes, a PostingLeaf takes up the whole of its Page,
+ * header included.  It refers to a Page owned by someone else, such as a
+ * buffer pool frame, and must not outlive it.
+ *
+ * @warning This class is not threadsafe.
+ */
+class PostingLeaf {
+ public:
+  /**
+   * Length of the longest key accepted.
+   */
+  static const std::uint16_t MAX_KEY_LENGTH = 256;
+
+  /**
+   * Length of the longest posting list kept in the leaf.
+   */
+  static const std::uint16_t MAX_INLINE_LIST = 1024;
+
+  /**
+   * Constructs an accessor for the given page.
+   *
+   * @param page    Page to access.
+   * @param file    Index file, holding overflow pages.
+   * @param bufMgr  Buffer manager through which overflow pages are read and
+   *                allocated.
+   */
+  PostingLeaf(Page* page, File* file, BufMgr* bufMgr)
+      : page_(page), file_(file), buf_mgr_(bufMgr) {}
+
+  /**
+   * Formats the page as an empty leaf.
+   *
+   * @param right_sibling   Right sibling of the leaf.
+   */
+  void initialize(const PageId right_sibling);
+
+  std::uint16_t numKeys() const { return header()->num_keys; }
+
+  /**
+   * Returns a copy of a key.
+   *
+   * @param i   Number of the key, from 0 in key order.
+   */
+  std::string key(const std::uint16_t i) const;
+
+  /**
+   * Returns the number of the first key not sorting before <key>, or
+   * numKeys() if there is none.
+   */
+  std::uint16_t lowerBound(const std::string& key) const;
+
+  /**
+   * Returns the number of RecordIds having key i.
+   */
+  std::uint32_t count(const std::uint16_t i) const;
+
+  /**
+   * Returns whether the posting list of key i is on overflow pages.
+   */
+  bool isSpilled(const std::uint16_t i) const;
+
+  /**
+   * Appends the RecordIds having key i to <rids>, in page, then slot order.
+   */
+  void rids(const std::uint16_t i, std::vector<RecordId>& rids) const;
+
+  /**
+   * Returns the right sibling of the leaf.
+   */
+  PageId rightSibling() const { return header()->right_sibling; }
+  void setRightSibling(const PageId page_number) {
+    header()->right_sibling = page_number;
+  }
+
+  /**
+   * Returns the number of bytes not used by the leaf, counting those a
+   * compaction would recover.
+   */
+  std::uint16_t freeSpace() const;
+
+  /**
+   * Adds a RecordId to the posting list of a key, adding the key if it is
+   * new.  Adding a pair the leaf already holds does nothing.
+   *
+   * @return  False, leaving the leaf as it was, if it has no room.
+   * @throws  InsufficientSpaceException  If the key is longer than
+   *                                      MAX_KEY_LENGTH.
+   */
+  bool insert(const std::string& key, const RecordId& rid);
+
+  /**
+   * Adds the RecordId insert() had no room for, then moves the upper half of
+   * the keys, by space, with their posting lists to an empty page, which
+   * becomes the right sibling.  Overflow pages stay with their key.
+   *
+   * @param right   Leaf on an empty page, formatted by this.
+   * @param right_page_number   Number of that page.
+   * @return  First key of the new leaf, to insert into the parent.
+   */
+  std::string split(PostingLeaf& right, const PageId right_page_number,
+                    const std::string& key, const RecordId& rid);
+
+  /**
+   * Appends the varint encoding of <rids>, sorted and without duplicates, to
+   * <out>.  The first RecordId is encoded relative to <previous>.
+   */
+  static void encodeRids(const std::vector<RecordId>& rids, RecordId previous,
+                         std::string& out);
+
+  /**
+   * Decodes the RecordIds encoded in the <length> bytes at <in> and appends
+   * them to <rids>.  The first is relative to <previous>.
+   */
+  static void decodeRids(const char* in, const std::size_t length,
+                         RecordId previous, std::vector<RecordId>& rids);
+
+ private:
+  /**
+   * @brief An entry copied out of the leaf while it is rewritten.
+   */
+  struct Entry {
+    std::string key;
+    std::string list;
+    std::uint16_t spilled;
+    std::uint32_t count;
+  };
+
+  PostingLeafHeader* header() const {
+    return reinterpret_cast<PostingLeafHeader*>(bytes());
+  }
+
+  char* bytes() const { return reinterpret_cast<char*>(page_); }
+
+  PostingSlot* slots() const {
+    return reinterpret_cast<PostingSlot*>(bytes() + sizeof(PostingLeafHeader));
+  }
+
+  PostingSlot slot(const std::uint16_t i) const;
+
+  /**
+   * Compares key i to <key>, like memcmp.
+   */
+  int compare(const std::uint16_t i, const std::string& key) const;
+
+  /**
+   * Copies out entry i.
+   */
+  void readEntry(const std::uint16_t i, Entry& entry) const;
+
+  /**
+   * Writes <entry> as entry i, replacing the one there if <replace> or
+   * inserting a new one before it otherwise.
+   *
+   * @return  False, leaving the leaf as it was, if it does not fit.
+   */
+  bool writeEntry(const std::uint16_t i, const Entry& entry,
+                  const bool replace);
+
+  /**
+   * Rewrites the heap without the unused bytes.
+   */
+  void compact();
+
+  /**
+   * Writes <rids> to a new chain of overflow pages.
+   *
+   * @param first   Receives the first page of the chain.
+   * @param last    Receives the last page of the chain.
+   */
+  void spill(const std::vector<RecordId>& rids, PageId& first, PageId& last);
+
+  /**
+   * Adds <rid> to the posting list of <entry>, spilling the list once its
+   * encoding would outgrow MAX_INLINE_LIST.
+   *
+   * @return  False if the list already held <rid>.
+   */
+  bool addRid(Entry& entry, const RecordId& rid);
+
+  /**
+   * Adds <rid> to the spilled posting list of <entry>, updating the last
+   * page it records if the chain grows at its end.
+   *
+   * @return  False if the list already held <rid>.
+   */
+  bool insertSpilled(Entry& entry, const RecordId& rid);
+
+  /**
+   * Rewrites overflow page <page> to hold <rids>, moving the upper half to a
+   * new page after it if they do not fit.
+   *
+   * @return  Number of the new page, or Page::INVALID_NUMBER.
+   */
+  PageId writeOverflow(Page* page, const std::vector<RecordId>& rids);
+
+  /**
+   * Encodes as many of rids [begin, end) as fit on overflow page <page>,
+   * replacing its list but not its link.
+   *
+   * @return  Index of the first RecordId not written.
+   */
+  static std::size_t fillOverflow(Page* page,
+                                  const std::vector<RecordId>& rids,
+                                  const std::size_t begin,
+                                  const std::size_t end);
+
+  /**
+   * Page being accessed.
+   */
+  Page* page_;
+
+  /**
+   * Index file holding the overflow pages.
+   */
+  File* file_;
+
+  /**
+   * Buffer manager for overflow pages.
+   */
+  BufMgr* buf_mgr_;
+};
+
+static_assert(sizeof(PostingLeafHeader) + 2 * (sizeof(PostingSlot) +
+                  PostingLeaf::MAX_KEY_LENGTH + PostingLeaf::MAX_INLINE_LIST)
+                  <= Page::SIZE,
+              "A leaf must hold two keys with posting lists of maximum length.");
+static_assert(sizeof(PostingLeafHeader) + 3 * (sizeof(PostingSlot) +
+                  PostingLeaf::MAX_KEY_LENGTH + PostingLeaf::MAX_INLINE_LIST)
+                  <= Page::SIZE,
+              "A half of a split leaf must have room for an entry more.");
+
+}
@@ -0,0 +1,412 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "prefix_key_node.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "exceptions/insufficient_space_exception.h"
+
+namespace badgerdb {
+
+const std::uint16_t PrefixKeyNode::MAX_KEY_LENGTH;
+
+namespace {
+
+/**
+ * Compares byte strings like memcmp, shorter first on a tie.
+ */
+int compareBytes(const char* a, const std::size_t a_length,
+                 const char* b, const std::size_t b_length) {
+  const int cmp = memcmp(a, b, std::min(a_length, b_length));
+  if (cmp != 0) {
+    return cmp;
+  }
+  return (a_length > b_length) - (a_length < b_length);
+}
+
+/**
+ * Returns the length of the longest common prefix of two strings.
+ */
+std::size_t commonPrefix(const std::string& a, const std::string& b) {
+  const std::size_t length = std::min(a.length(), b.length());
+  std::size_t i = 0;
+  while (i < length && a[i] == b[i]) {
+    ++i;
+  }
+  return i;
+}
+
+}
+
+void PrefixKeyNode::initialize(const std::uint16_t level, const PageId link,
+                               const std::uint16_t payload_size) {
+  PrefixKeyNodeHeader* node = header();
+  node->num_keys = 0;
+  node->prefix_length = 0;
+  node->heap_begin = Page::SIZE;
+  node->level = level;
+  node->payload_size = level == 0 ? payload_size : 0;
+  node->link = link;
+}
+
+std::string PrefixKeyNode::prefix() const {
+  return std::string(bytes() + sizeof(PrefixKeyNodeHeader),
+                     header()->prefix_length);
+}
+
+const PrefixKeySlot* PrefixKeyNode::slots() const {
+  return reinterpret_cast<const PrefixKeySlot*>(
+      bytes() + sizeof(PrefixKeyNodeHeader) + header()->prefix_length);
+}
+
+PrefixKeySlot* PrefixKeyNode::slots() {
+  return reinterpret_cast<PrefixKeySlot*>(
+      bytes() + sizeof(PrefixKeyNodeHeader) + header()->prefix_length);
+}
+
+std::uint16_t PrefixKeyNode::valueSize() const {
+  return isLeaf() ? sizeof(RecordId) + header()->payload_size
+                  : sizeof(PageId);
+}
+
+std::string PrefixKeyNode::leafValue(const RecordId& rid,
+                                     const char* payload) const {
+  std::string value(reinterpret_cast<const char*>(&rid), sizeof(rid));
+  if (payload != NULL) {
+    value.append(payload, header()->payload_size);
+  } else {
+    value.resize(valueSize(), '\0');
+  }
+  return value;
+}
+
+std::string PrefixKeyNode::key(const std::uint16_t i) const {
+  PrefixKeySlot slot;
+  memcpy(&slot, &slots()[i], sizeof(slot));
+  std::string key = prefix();
+  key.append(bytes() + slot.offset + valueSize(), slot.suffix_length);
+  return key;
+}
+
+int PrefixKeyNode::compare(const std::uint16_t i, const std::string& key) const {
+  const std::uint16_t prefix_length = header()->prefix_length;
+  const char* node_prefix = bytes() + sizeof(PrefixKeyNodeHeader);
+  if (key.length() < prefix_length) {
+    const int cmp = memcmp(node_prefix, key.data(), key.length());
+    return cmp != 0 ? cmp : 1;
+  }
+  const int cmp = memcmp(node_prefix, key.data(), prefix_length);
+  if (cmp != 0) {
+    return cmp;
+  }
+  PrefixKeySlot slot;
+  memcpy(&slot, &slots()[i], sizeof(slot));
+  return compareBytes(bytes() + slot.offset + valueSize(), slot.suffix_length,
+                      key.data() + prefix_length,
+                      key.length() - prefix_length);
+}
+
+std::uint16_t PrefixKeyNode::lowerBound(const std::string& key) const {
+  std::uint16_t low = 0;
+  std::uint16_t high = numKeys();
+  while (low < high) {
+    const std::uint16_t mid = low + (high - low) / 2;
+    if (compare(mid, key) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+std::uint16_t PrefixKeyNode::upperBound(const std::string& key) const {
+  std::uint16_t low = 0;
+  std::uint16_t high = numKeys();
+  while (low < high) {
+    const std::uint16_t mid = low + (high - low) / 2;
+    if (compare(mid, key) <= 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+RecordId PrefixKeyNode::rid(const std::uint16_t i) const {
+  PrefixKeySlot slot;
+  memcpy(&slot, &slots()[i], sizeof(slot));
+  RecordId rid;
+  memcpy(&rid, bytes() + slot.offset, sizeof(rid));
+  return rid;
+}
+
+char* PrefixKeyNode::payload(const std::uint16_t i) const {
+  PrefixKeySlot slot;
+  memcpy(&slot, &slots()[i], sizeof(slot));
+  return bytes() + slot.offset + sizeof(RecordId);
+}
+
+PageId PrefixKeyNode::child(const std::uint16_t i) const {
+  if (i == 0) {
+    return header()->link;
+  }
+  PrefixKeySlot slot;
+  memcpy(&slot, &slots()[i - 1], sizeof(slot));
+  PageId child;
+  memcpy(&child, bytes() + slot.offset, sizeof(child));
+  return child;
+}
+
+std::uint16_t PrefixKeyNode::freeSpace() const {
+  const std::size_t slots_end = sizeof(PrefixKeyNodeHeader) +
+                                header()->prefix_length +
+                                numKeys() * sizeof(PrefixKeySlot);
+  return header()->heap_begin - slots_end;
+}
+
+bool PrefixKeyNode::insert(const std::string& key, const RecordId& rid,
+                           const char* payload) {
+  return insertEntry(upperBound(key), key, leafValue(rid, payload));
+}
+
+bool PrefixKeyNode::insert(const std::uint16_t position,
+                           const std::string& key, const PageId child) {
+  return insertEntry(position, key,
+                     std::string(reinterpret_cast<const char*>(&child),
+                                 sizeof(child)));
+}
+
+bool PrefixKeyNode::insertEntry(const std::uint16_t position,
+                                const std::string& key,
+                                const std::string& value) {
+  if (key.length() > MAX_KEY_LENGTH) {
+    throw InsufficientSpaceException(Page::INVALID_NUMBER, key.length(),
+                                     MAX_KEY_LENGTH);
+  }
+  const std::uint16_t prefix_length = header()->prefix_length;
+
+  if (numKeys() == 0 || key.length() < prefix_length ||
+      memcmp(key.data(), bytes() + sizeof(PrefixKeyNodeHeader),
+             prefix_length) != 0) {
+    // The key does not share the prefix; rewrite with a shorter one.  The
+    // first key of a node is all prefix, so a node filled by appends, rather
+    // than by a split, still finds the prefix its keys share.
+    std::vector<Entry> entries;
+    readEntries(0, numKeys(), entries);
+    Entry entry;
+    entry.key = key;
+    entry.value = value;
+    entries.insert(entries.begin() + position, entry);
+    return rebuild(entries);
+  }
+
+  const std::uint16_t suffix_length = key.length() - prefix_length;
+  const std::size_t needed =
+      sizeof(PrefixKeySlot) + valueSize() + suffix_length;
+  if (needed > freeSpace()) {
+    return false;
+  }
+
+  PrefixKeyNodeHeader* node = header();
+  node->heap_begin -= valueSize() + suffix_length;
+  memcpy(bytes() + node->heap_begin, value.data(), valueSize());
+  memcpy(bytes() + node->heap_begin + valueSize(),
+         key.data() + prefix_length, suffix_length);
+
+  PrefixKeySlot* node_slots = slots();
+  memmove(node_slots + position + 1, node_slots + position,
+          (node->num_keys - position) * sizeof(PrefixKeySlot));
+  PrefixKeySlot slot;
+  slot.offset = node->heap_begin;
+  slot.suffix_length = suffix_length;
+  memcpy(&node_slots[position], &slot, sizeof(slot));
+  ++node->num_keys;
+  return true;
+}
+
+void PrefixKeyNode::readEntries(const std::uint16_t first,
+                                const std::uint16_t last,
+                                std::vector<Entry>& entries) const {
+  entries.reserve(entries.size() + last - first);
+  for (std::uint16_t i = first; i < last; ++i) {
+    PrefixKeySlot slot;
+    memcpy(&slot, &slots()[i], sizeof(slot));
+    Entry entry;
+    entry.key = key(i);
+    entry.value.assign(bytes() + slot.offset, valueSize());
+    entries.push_back(entry);
+  }
+}
+
+std::size_t PrefixKeyNode::rebuiltSize(const std::vector<Entry>& entries,
+                                       const std::size_t first,
+                                       const std::size_t last) const {
+  const std::size_t prefix_length =
+      first == last ? 0
+                    : commonPrefix(entries[first].key, entries[last - 1].key);
+  std::size_t needed = sizeof(PrefixKeyNodeHeader) + prefix_length;
+  for (std::size_t i = first; i < last; ++i) {
+    needed += sizeof(PrefixKeySlot) + valueSize() +
+              entries[i].key.length() - prefix_length;
+  }
+  return needed;
+}
+
+bool PrefixKeyNode::rebuild(const std::vector<Entry>& entries) {
+  if (rebuiltSize(entries, 0, entries.size()) > Page::SIZE) {
+    return false;
+  }
+  const std::size_t prefix_length =
+      entries.empty() ? 0
+                      : commonPrefix(entries.front().key, entries.back().key);
+
+  const std::uint16_t value_size = valueSize();
+  PrefixKeyNodeHeader* node = header();
+  node->num_keys = 0;
+  node->prefix_length = prefix_length;
+  node->heap_begin = Page::SIZE;
+  if (!entries.empty()) {
+    memcpy(bytes() + sizeof(PrefixKeyNodeHeader), entries.front().key.data(),
+           prefix_length);
+  }
+  PrefixKeySlot* node_slots = slots();
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    const std::uint16_t suffix_length =
+        entries[i].key.length() - prefix_length;
+    node->heap_begin -= value_size + suffix_length;
+    memcpy(bytes() + node->heap_begin, entries[i].value.data(), value_size);
+    memcpy(bytes() + node->heap_begin + value_size,
+           entries[i].key.data() + prefix_length, suffix_length);
+    PrefixKeySlot slot;
+    slot.offset = node->heap_begin;
+    slot.suffix_length = suffix_length;
+    memcpy(&node_slots[i], &slot, sizeof(slot));
+  }
+  node->num_keys = entries.size();
+  return true;
+}
+
+std::string PrefixKeyNode::split(PrefixKeyNode& right,
+                                 const PageId right_page_number,
+                                 const bool append) {
+  std::vector<Entry> entries;
+  readEntries(0, numKeys(), entries);
+  return split(entries, right, right_page_number, append);
+}
+
+std::string PrefixKeyNode::split(PrefixKeyNode& right,
+                                 const PageId right_page_number,
+                                 const std::string& key, const RecordId& rid,
+                                 const char* payload) {
+  if (key.length() > MAX_KEY_LENGTH) {
+    throw InsufficientSpaceException(Page::INVALID_NUMBER, key.length(),
+                                     MAX_KEY_LENGTH);
+  }
+  std::vector<Entry> entries;
+  readEntries(0, numKeys(), entries);
+  Entry entry;
+  entry.key = key;
+  entry.value = leafValue(rid, payload);
+  entries.insert(entries.begin() + upperBound(key), entry);
+  return split(entries, right, right_page_number, false);
+}
+
+std::string PrefixKeyNode::split(const std::vector<Entry>& entries,
+                                 PrefixKeyNode& right,
+                                 const PageId right_page_number,
+                                 const bool append) {
+  const std::size_t count = entries.size();
+
+  // Split where the first half takes about half the space.
+  std::size_t total = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    total += entries[i].key.length();
+  }
+  std::size_t middle = 0;
+  std::size_t used = 0;
+  while (middle < count - 1 && (middle == 0 || 2 * used < total)) {
+    used += entries[middle].key.length();
+    ++middle;
+  }
+  if (append) {
+    middle = count - 1;
+  }
+
+  std::string up;
+  if (isLeaf()) {
+    // The halves grow, and their prefixes shrink, as they take more entries,
+    // so those split points at which both fit form a range.
+    std::size_t low = 1;
+    std::size_t high = count - 1;
+    while (low < high) {
+      const std::size_t point = (low + high) / 2;
+      if (rebuiltSize(entries, point, count) <= Page::SIZE) {
+        high = point;
+      } else {
+        low = point + 1;
+      }
+    }
+    const std::size_t first_fit = low;
+    high = count - 1;
+    while (low < high) {
+      const std::size_t point = (low + high + 1) / 2;
+      if (rebuiltSize(entries, 0, point) <= Page::SIZE) {
+        low = point;
+      } else {
+        high = point - 1;
+      }
+    }
+    const std::size_t last_fit = low;
+    middle = std::min(std::max(middle, first_fit), last_fit);
+
+    // Move the split off a run of equal keys, to whichever end is closer.
+    std::size_t before = middle;
+    std::size_t after = middle;
+    while (before > first_fit &&
+           entries[before - 1].key == entries[before].key) {
+      --before;
+    }
+    while (after < last_fit && entries[after - 1].key == entries[after].key) {
+      ++after;
+    }
+    const bool before_ok = entries[before - 1].key != entries[before].key;
+    const bool after_ok = entries[after - 1].key != entries[after].key;
+    if (before_ok && (!after_ok || middle - before <= after - middle)) {
+      middle = before;
+    } else if (after_ok) {
+      middle = after;
+    }
+
+    right.initialize(0, rightSibling(), header()->payload_size);
+    setRightSibling(right_page_number);
+    right.rebuild(std::vector<Entry>(entries.begin() + middle, entries.end()));
+    up = entries[middle - 1].key < entries[middle].key
+             ? separator(entries[middle - 1].key, entries[middle].key)
+             : entries[middle].key;
+  } else {
+    // The middle key moves up; its child becomes the new node's leftmost.
+    PageId leftmost;
+    memcpy(&leftmost, entries[middle].value.data(), sizeof(leftmost));
+    right.initialize(level(), leftmost);
+    right.rebuild(
+        std::vector<Entry>(entries.begin() + middle + 1, entries.end()));
+    up = entries[middle].key;
+  }
+  rebuild(std::vector<Entry>(entries.begin(), entries.begin() + middle));
+  return up;
+}
+
+std::string PrefixKeyNode::separator(const std::string& left,
+                                     const std::string& right) {
+  return right.substr(0, commonPrefix(left, right) + 1);
+}
+
+}
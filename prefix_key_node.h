@@ -0,0 +1,330 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Header of a PrefixKeyNode, at the start of the page.
+ */
+struct PrefixKeyNodeHeader {
+  /**
+   * Number of keys in the node.
+   */
+  std::uint16_t num_keys;
+
+  /**
+   * Length of the prefix all keys share, stored once after the header.
+   */
+  std::uint16_t prefix_length;
+
+  /**
+   * Offset of the first byte of the entry heap, which grows down from the
+   * end of the page.
+   */
+  std::uint16_t heap_begin;
+
+  /**
+   * 0 for a leaf; for an interior node, 1 plus the level of its children.
+   */
+  std::uint16_t level;
+
+  /**
+   * Bytes stored after the RecordId of every leaf entry, such as the included
+   * attributes of a covering index.
+   */
+  std::uint16_t payload_size;
+
+  /**
+   * Right sibling of a leaf, or leftmost child of an interior node.
+   */
+  PageId link;
+};
+
+/**
+ * @brief Position of one entry of a PrefixKeyNode, in the slot array after
+ *        the prefix.
+ */
+struct PrefixKeySlot {
+  /**
+   * Offset of the entry in the page: its value, then the key's suffix.  The
+   * value of a leaf entry is its RecordId and payload.
+   */
+  std::uint16_t offset;
+
+  /**
+   * Length of the key without the node's prefix.
+   */
+  std::uint16_t suffix_length;
+};
+
+/**
+ * @brief Accessor for a B+Tree node holding variable-length keys.
+ *
+ * Keys are kept whole, however long, up to MAX_KEY_LENGTH bytes, and are
+ * ordered like memcmp with shorter keys first on a tie.  The bytes all keys
+ * of the node start with are stored once; each entry keeps only its suffix,
+ * so keys sharing long prefixes, like URLs or paths, take a fraction of
+ * their length.  The slot array after the prefix is sorted by key and grows
+ * up while entries are appended to a heap growing down from the end of the
+ * page.  A leaf entry holds a RecordId and an interior entry the PageId of
+ * the child to the right of its key; the header links a leaf to its right
+ * sibling and an interior node to its leftmost child.
+ *
+ * When a leaf is split, the key passed up to the parent is the shortest
+ * string separating the two halves (see separator()), not a whole key.
+ * Leaves are split between different keys where possible; only a leaf
+ * whose halves would not fit otherwise, such as one full of a single key,
+ * leaves equal keys on both sides of its separator.
+ *
+ * Like the other B+Tree nodes, a PrefixKeyNode takes up the whole of its
+ * Page, header included.  It refers to a Page owned by someone else, such as
+ * a buffer pool frame, and must not outlive it.
+ *
+ * @warning This class is not threadsafe.
+ */
+class PrefixKeyNode {
+ public:
+  /**
+   * Length of the longest key accepted, so that any node holds a few.
+   */
+  static const std::uint16_t MAX_KEY_LENGTH = 1024;
+
+  /**
+   * Constructs an accessor for the given page.
+   *
+   * @param page  Page to access.
+   */
+  explicit PrefixKeyNode(Page* page) : page_(page) {}
+
+  /**
+   * Formats the page as an empty node.
+   *
+   * @param level   0 for a leaf, 1 plus the level of the children for an
+   *                interior node.
+   * @param link    Right sibling of a leaf or leftmost child of an interior
+   *                node.
+   * @param payload_size    Bytes stored with every leaf entry.
+   */
+  void initialize(const std::uint16_t level, const PageId link,
+                  const std::uint16_t payload_size = 0);
+
+  bool isLeaf() const { return header()->level == 0; }
+
+  std::uint16_t level() const { return header()->level; }
+
+  std::uint16_t numKeys() const { return header()->num_keys; }
+
+  /**
+   * Returns the prefix all keys of the node share.
+   */
+  std::string prefix() const;
+
+  /**
+   * Returns a copy of a key.
+   *
+   * @param i   Number of the key, from 0 in key order.
+   */
+  std::string key(const std::uint16_t i) const;
+
+  /**
+   * Compares a key of the node to <key> without copying it.
+   *
+   * @return  Negative, zero or positive as key(i) sorts before, with or after
+   *          <key>.
+   */
+  int compare(const std::uint16_t i, const std::string& key) const;
+
+  /**
+   * Returns the number of the first key not sorting before <key>, or
+   * numKeys() if there is none.
+   */
+  std::uint16_t lowerBound(const std::string& key) const;
+
+  /**
+   * Returns the number of the first key sorting after <key>, or numKeys().
+   */
+  std::uint16_t upperBound(const std::string& key) const;
+
+  /**
+   * Returns the RecordId of a leaf entry.
+   */
+  RecordId rid(const std::uint16_t i) const;
+
+  /**
+   * Returns the payload of a leaf entry, of the payload_size the leaf was
+   * formatted with.
+   */
+  char* payload(const std::uint16_t i) const;
+
+  /**
+   * Returns a child of an interior node: child(0) is the leftmost, and
+   * child(i + 1) the one to the right of key i.
+   */
+  PageId child(const std::uint16_t i) const;
+
+  /**
+   * Returns the child of an interior node to descend into for <key>: the
+   * leftmost one that can hold it, so a scan from there meets every equal
+   * key by following right siblings.
+   */
+  PageId childFor(const std::string& key) const {
+    return child(lowerBound(key));
+  }
+
+  /**
+   * Returns the right sibling of a leaf.
+   */
+  PageId rightSibling() const { return header()->link; }
+  void setRightSibling(const PageId page_number) { header()->link = page_number; }
+
+  /**
+   * Returns the number of bytes not used by the node.
+   */
+  std::uint16_t freeSpace() const;
+
+  /**
+   * Inserts an entry into a leaf, after any equal keys.
+   *
+   * @param payload   payload_size bytes to store with the entry, or NULL for
+   *                  zeros.
+   * @return  False, leaving the node as it was, if the entry does not fit.
+   * @throws  InsufficientSpaceException  If the key is longer than
+   *                                      MAX_KEY_LENGTH.
+   */
+  bool insert(const std::string& key, const RecordId& rid,
+              const char* payload = NULL);
+
+  /**
+   * Inserts a separator into an interior node as key <position>, with the
+   * child holding keys not sorting before it to its right.  The caller gives
+   * the position because separators may repeat: a child split off child(i)
+   * goes right after it even if its separator equals key i.
+   *
+   * @return  False, leaving the node as it was, if the entry does not fit.
+   * @throws  InsufficientSpaceException  If the key is longer than
+   *                                      MAX_KEY_LENGTH.
+   */
+  bool insert(const std::uint16_t position, const std::string& key,
+              const PageId child);
+
+  /**
+   * Moves the upper half of the entries, by space, to an empty page, which
+   * becomes the right sibling of a leaf.  Both nodes recompute their prefix.
+   *
+   * @param right   Node on an empty page, formatted by this.
+   * @param right_page_number   Number of that page, linked from a leaf.
+   * @param append  True to move only the last entry instead, for a node
+   *                on the right edge of an index that keys are appended to.
+   * @return  Key to insert into the parent with the new node as child: the
+   *          shortest separator for leaves, the middle key, which moves up,
+   *          for interior nodes.
+   */
+  std::string split(PrefixKeyNode& right, const PageId right_page_number,
+                    const bool append = false);
+
+  /**
+   * Splits a full leaf as split() does, adding first the entry insert() had
+   * no room for, so that the halves are chosen with it and both fit.
+   *
+   * @throws  InsufficientSpaceException  If the key is longer than
+   *                                      MAX_KEY_LENGTH.
+   */
+  std::string split(PrefixKeyNode& right, const PageId right_page_number,
+                    const std::string& key, const RecordId& rid,
+                    const char* payload = NULL);
+
+  /**
+   * Returns the shortest string s with left < s <= right, for right > left.
+   */
+  static std::string separator(const std::string& left,
+                               const std::string& right);
+
+ private:
+  /**
+   * @brief An entry copied out of the node while it is rewritten.
+   */
+  struct Entry {
+    std::string key;
+    std::string value;
+  };
+
+  PrefixKeyNodeHeader* header() const {
+    return reinterpret_cast<PrefixKeyNodeHeader*>(bytes());
+  }
+
+  char* bytes() const { return reinterpret_cast<char*>(page_); }
+
+  const PrefixKeySlot* slots() const;
+  PrefixKeySlot* slots();
+
+  /**
+   * Returns the size of the value of an entry.
+   */
+  std::uint16_t valueSize() const;
+
+  /**
+   * Returns the value of a leaf entry: the RecordId, then <payload>, or zeros
+   * if it is NULL.
+   */
+  std::string leafValue(const RecordId& rid, const char* payload) const;
+
+  /**
+   * Inserts an entry whose value is <value>, of valueSize() bytes, as entry
+   * <position>.
+   */
+  bool insertEntry(const std::uint16_t position, const std::string& key,
+                   const std::string& value);
+
+  /**
+   * Copies out the entries [first, last).
+   */
+  void readEntries(const std::uint16_t first, const std::uint16_t last,
+                   std::vector<Entry>& entries) const;
+
+  /**
+   * Returns the bytes a node holding entries [first, last) of <entries>, with
+   * the longest prefix they share, takes.
+   */
+  std::size_t rebuiltSize(const std::vector<Entry>& entries,
+                          const std::size_t first,
+                          const std::size_t last) const;
+
+  /**
+   * Rewrites the node to hold exactly <entries>, sorted by key, with the
+   * longest prefix they share.
+   *
+   * @return  False, leaving the node as it was, if they do not fit.
+   */
+  bool rebuild(const std::vector<Entry>& entries);
+
+  /**
+   * Splits the node as the public split() does, dividing <entries> between
+   * it and <right> in place of the entries it holds.
+   */
+  std::string split(const std::vector<Entry>& entries, PrefixKeyNode& right,
+                    const PageId right_page_number, const bool append);
+
+  /**
+   * Page being accessed.
+   */
+  Page* page_;
+};
+
+static_assert(sizeof(PrefixKeyNodeHeader) + 2 * (PrefixKeyNode::MAX_KEY_LENGTH
+                  + sizeof(PrefixKeySlot) + sizeof(RecordId)) <= Page::SIZE,
+              "A node must hold two entries with keys of maximum length.");
+
+}
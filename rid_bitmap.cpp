@@ -0,0 +1,281 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "rid_bitmap.h"
+
+#include <algorithm>
+#include <iterator>
+#include "btree.h"
+#include "exceptions/index_scan_completed_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+const std::size_t WORD_BITS = 64;
+
+std::size_t popcount(const std::uint64_t word) {
+  return __builtin_popcountll(word);
+}
+
+}
+
+RidBitmap RidBitmap::fromIndexScan(BTreeIndex* index) {
+  RidBitmap bitmap;
+  try {
+    while (true) {
+      RecordId rid;
+      index->scanNext(rid);
+      bitmap.add(rid);
+    }
+  } catch (const IndexScanCompletedException& e) {
+  }
+  return bitmap;
+}
+
+void RidBitmap::add(const RecordId& rid) {
+  SlotSet& slots = pages_[rid.page_number];
+  const std::size_t before = slots.count;
+  slots.add(rid.slot_number);
+  cardinality_ += slots.count - before;
+}
+
+bool RidBitmap::contains(const RecordId& rid) const {
+  const std::map<PageId, SlotSet>::const_iterator it =
+      pages_.find(rid.page_number);
+  return it != pages_.end() && it->second.contains(rid.slot_number);
+}
+
+void RidBitmap::clear() {
+  pages_.clear();
+  cardinality_ = 0;
+}
+
+RidBitmap& RidBitmap::intersectWith(const RidBitmap& other) {
+  std::map<PageId, SlotSet>::iterator it = pages_.begin();
+  std::map<PageId, SlotSet>::const_iterator other_it = other.pages_.begin();
+  cardinality_ = 0;
+  while (it != pages_.end()) {
+    while (other_it != other.pages_.end() && other_it->first < it->first) {
+      ++other_it;
+    }
+    if (other_it != other.pages_.end() && other_it->first == it->first) {
+      it->second.intersectWith(other_it->second);
+    } else {
+      it->second.count = 0;
+    }
+    if (it->second.count == 0) {
+      pages_.erase(it++);
+    } else {
+      cardinality_ += it->second.count;
+      ++it;
+    }
+  }
+  return *this;
+}
+
+RidBitmap& RidBitmap::unionWith(const RidBitmap& other) {
+  for (std::map<PageId, SlotSet>::const_iterator other_it = other.pages_.begin();
+       other_it != other.pages_.end(); ++other_it) {
+    std::map<PageId, SlotSet>::iterator hint =
+        pages_.lower_bound(other_it->first);
+    if (hint == pages_.end() || hint->first != other_it->first) {
+      hint = pages_.insert(hint, *other_it);
+      cardinality_ += other_it->second.count;
+    } else {
+      cardinality_ -= hint->second.count;
+      hint->second.unionWith(other_it->second);
+      cardinality_ += hint->second.count;
+    }
+  }
+  return *this;
+}
+
+void RidBitmap::toRids(std::vector<RecordId>& rids) const {
+  rids.reserve(rids.size() + cardinality_);
+  for (std::map<PageId, SlotSet>::const_iterator it = pages_.begin();
+       it != pages_.end(); ++it) {
+    it->second.appendTo(it->first, rids);
+  }
+}
+
+void RidBitmap::SlotSet::add(const SlotId slot) {
+  if (dense) {
+    const std::size_t word = slot / WORD_BITS;
+    if (word >= words.size()) {
+      words.resize(word + 1, 0);
+    }
+    const std::uint64_t bit = std::uint64_t(1) << (slot % WORD_BITS);
+    if ((words[word] & bit) == 0) {
+      words[word] |= bit;
+      ++count;
+    }
+    return;
+  }
+  const std::vector<SlotId>::iterator pos =
+      std::lower_bound(array.begin(), array.end(), slot);
+  if (pos != array.end() && *pos == slot) {
+    return;
+  }
+  array.insert(pos, slot);
+  ++count;
+  compact();
+}
+
+bool RidBitmap::SlotSet::contains(const SlotId slot) const {
+  if (dense) {
+    const std::size_t word = slot / WORD_BITS;
+    return word < words.size() &&
+           (words[word] >> (slot % WORD_BITS) & 1) != 0;
+  }
+  return std::binary_search(array.begin(), array.end(), slot);
+}
+
+void RidBitmap::SlotSet::intersectWith(const SlotSet& other) {
+  if (dense && other.dense) {
+    if (words.size() > other.words.size()) {
+      words.resize(other.words.size());
+    }
+    count = 0;
+    for (std::size_t i = 0; i < words.size(); ++i) {
+      words[i] &= other.words[i];
+      count += popcount(words[i]);
+    }
+  } else if (!dense) {
+    // Keep the slots of the array the other set contains.
+    std::size_t kept = 0;
+    if (other.dense) {
+      for (std::size_t i = 0; i < array.size(); ++i) {
+        if (other.contains(array[i])) {
+          array[kept++] = array[i];
+        }
+      }
+    } else {
+      std::size_t j = 0;
+      for (std::size_t i = 0; i < array.size(); ++i) {
+        while (j < other.array.size() && other.array[j] < array[i]) {
+          ++j;
+        }
+        if (j < other.array.size() && other.array[j] == array[i]) {
+          array[kept++] = array[i];
+        }
+      }
+    }
+    array.resize(kept);
+    count = kept;
+  } else {
+    // The result is no larger than the other array.
+    std::vector<SlotId> result;
+    result.reserve(other.array.size());
+    for (std::size_t i = 0; i < other.array.size(); ++i) {
+      if (contains(other.array[i])) {
+        result.push_back(other.array[i]);
+      }
+    }
+    array.swap(result);
+    words.clear();
+    dense = false;
+    count = array.size();
+  }
+  compact();
+}
+
+void RidBitmap::SlotSet::unionWith(const SlotSet& other) {
+  if (!dense && !other.dense) {
+    std::vector<SlotId> result;
+    result.reserve(array.size() + other.array.size());
+    std::set_union(array.begin(), array.end(), other.array.begin(),
+                   other.array.end(), std::back_inserter(result));
+    array.swap(result);
+    count = array.size();
+  } else if (other.dense) {
+    if (!dense) {
+      std::vector<SlotId> slots;
+      slots.swap(array);
+      words = other.words;
+      dense = true;
+      count = other.count;
+      for (std::size_t i = 0; i < slots.size(); ++i) {
+        add(slots[i]);
+      }
+    } else {
+      if (words.size() < other.words.size()) {
+        words.resize(other.words.size(), 0);
+      }
+      count = 0;
+      for (std::size_t i = 0; i < words.size(); ++i) {
+        if (i < other.words.size()) {
+          words[i] |= other.words[i];
+        }
+        count += popcount(words[i]);
+      }
+    }
+  } else {
+    for (std::size_t i = 0; i < other.array.size(); ++i) {
+      add(other.array[i]);
+    }
+  }
+  compact();
+}
+
+void RidBitmap::SlotSet::appendTo(const PageId page_number,
+                                  std::vector<RecordId>& rids) const {
+  RecordId rid;
+  rid.page_number = page_number;
+  if (!dense) {
+    for (std::size_t i = 0; i < array.size(); ++i) {
+      rid.slot_number = array[i];
+      rids.push_back(rid);
+    }
+    return;
+  }
+  for (std::size_t i = 0; i < words.size(); ++i) {
+    std::uint64_t word = words[i];
+    while (word != 0) {
+      rid.slot_number = static_cast<SlotId>(i * WORD_BITS + __builtin_ctzll(word));
+      rids.push_back(rid);
+      word &= word - 1;
+    }
+  }
+}
+
+void RidBitmap::SlotSet::compact() {
+  if (dense) {
+    while (!words.empty() && words.back() == 0) {
+      words.pop_back();
+    }
+    if (count * sizeof(SlotId) < words.size() * sizeof(std::uint64_t)) {
+      std::vector<SlotId> slots;
+      slots.reserve(count);
+      array.swap(slots);
+      dense = false;
+      for (std::size_t i = 0; i < words.size(); ++i) {
+        std::uint64_t word = words[i];
+        while (word != 0) {
+          array.push_back(static_cast<SlotId>(i * WORD_BITS + __builtin_ctzll(word)));
+          word &= word - 1;
+        }
+      }
+      words.clear();
+    }
+    return;
+  }
+  if (array.empty()) {
+    return;
+  }
+  const std::size_t num_words = array.back() / WORD_BITS + 1;
+  if (array.size() * sizeof(SlotId) > num_words * sizeof(std::uint64_t)) {
+    words.assign(num_words, 0);
+    for (std::size_t i = 0; i < array.size(); ++i) {
+      words[array[i] / WORD_BITS] |= std::uint64_t(1) << (array[i] % WORD_BITS);
+    }
+    std::vector<SlotId>().swap(array);
+    dense = true;
+  }
+}
+
+}
@@ -0,0 +1,146 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "types.h"
+
+namespace badgerdb {
+
+class BTreeIndex;
+
+/**
+ * @brief Compressed set of RecordIds of one relation.
+ *
+ * As in a Roaring bitmap, RecordIds are grouped by their high part, the page
+ * number, and the slots of each page are kept in a container that is either
+ * a sorted array or, once that would be larger, a bitset.  Sets built from
+ * range scans of several indexes on the relation can be intersected or
+ * united before any heap page is read; BitmapHeapScan then fetches the
+ * records of the result in page order.
+ *
+ * @warning This class is not threadsafe.
+ */
+class RidBitmap {
+ public:
+  /**
+   * Constructs an empty set.
+   */
+  RidBitmap() : cardinality_(0) {}
+
+  /**
+   * Collects the RecordIds a started index scan returns, until it completes.
+   * The caller ends the scan afterwards.
+   *
+   * @param index   Index with a started scan.
+   * @return  Set of the RecordIds returned.
+   */
+  static RidBitmap fromIndexScan(BTreeIndex* index);
+
+  /**
+   * Adds a RecordId to the set.
+   */
+  void add(const RecordId& rid);
+
+  /**
+   * Returns true if the set contains the RecordId.
+   */
+  bool contains(const RecordId& rid) const;
+
+  /**
+   * Returns the number of RecordIds in the set.
+   */
+  std::size_t cardinality() const { return cardinality_; }
+
+  /**
+   * Returns the number of distinct pages of the RecordIds in the set.
+   */
+  std::size_t numPages() const { return pages_.size(); }
+
+  /**
+   * Returns true if the set is empty.
+   */
+  bool empty() const { return cardinality_ == 0; }
+
+  /**
+   * Removes all RecordIds.
+   */
+  void clear();
+
+  /**
+   * Keeps only the RecordIds also in <other>.
+   *
+   * @return  This set.
+   */
+  RidBitmap& intersectWith(const RidBitmap& other);
+
+  /**
+   * Adds all RecordIds of <other>.
+   *
+   * @return  This set.
+   */
+  RidBitmap& unionWith(const RidBitmap& other);
+
+  RidBitmap& operator&=(const RidBitmap& other) { return intersectWith(other); }
+  RidBitmap& operator|=(const RidBitmap& other) { return unionWith(other); }
+
+  /**
+   * Appends the RecordIds of the set to <rids>, ordered by page and slot.
+   */
+  void toRids(std::vector<RecordId>& rids) const;
+
+ private:
+  /**
+   * @brief Slots of one page, as a sorted array or as a bitset.
+   */
+  struct SlotSet {
+    SlotSet() : dense(false), count(0) {}
+
+    /**
+     * Sorted slot numbers, if not <dense>.
+     */
+    std::vector<SlotId> array;
+
+    /**
+     * Bit s % 64 of word s / 64 is set for slot s, if <dense>.
+     */
+    std::vector<std::uint64_t> words;
+
+    bool dense;
+
+    /**
+     * Number of slots in the set.
+     */
+    std::size_t count;
+
+    void add(const SlotId slot);
+    bool contains(const SlotId slot) const;
+    void intersectWith(const SlotSet& other);
+    void unionWith(const SlotSet& other);
+    void appendTo(const PageId page_number, std::vector<RecordId>& rids) const;
+
+    /**
+     * Switches to whichever form takes less space.
+     */
+    void compact();
+  };
+
+  /**
+   * Slots in the set of every page with any, by page number.
+   */
+  std::map<PageId, SlotSet> pages_;
+
+  /**
+   * Number of RecordIds in the set.
+   */
+  std::size_t cardinality_;
+};
+
+}
@@ -0,0 +1,91 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "tuple_layout.h"
+
+#include "exceptions/bad_schema_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Returns the width of an attribute of type <type>.
+ */
+std::uint16_t widthOf(const Datatype type, const std::uint16_t width) {
+  switch (type) {
+    case INTEGER:
+      return sizeof(int);
+    case DOUBLE:
+      return sizeof(double);
+    case STRING:
+      return width;
+  }
+  return width;
+}
+
+/**
+ * Returns the alignment C gives a member of type <type>.
+ */
+std::uint16_t alignmentOf(const Datatype type) {
+  switch (type) {
+    case INTEGER:
+      return alignof(int);
+    case DOUBLE:
+      return alignof(double);
+    case STRING:
+      return 1;
+  }
+  return 1;
+}
+
+std::uint16_t alignUp(const std::uint16_t n, const std::uint16_t alignment) {
+  return (n + alignment - 1) / alignment * alignment;
+}
+
+}
+
+Schema& Schema::addField(const std::string& name, const Datatype type,
+                         const std::uint16_t width) {
+  return addFieldAt(name, type, alignUp(record_size_, alignmentOf(type)),
+                    width);
+}
+
+Schema& Schema::addFieldAt(const std::string& name, const Datatype type,
+                           const std::uint16_t offset,
+                           const std::uint16_t width) {
+  const FieldInfo info = {name, type, offset, widthOf(type, width)};
+  fields_.push_back(info);
+  if (info.offset + info.width > record_size_) {
+    record_size_ = info.offset + info.width;
+  }
+  if (alignmentOf(type) > alignment_) {
+    alignment_ = alignmentOf(type);
+  }
+  return *this;
+}
+
+const FieldInfo& Schema::field(const std::string& name) const {
+  for (std::size_t i = 0; i < fields_.size(); ++i) {
+    if (fields_[i].name == name) {
+      return fields_[i];
+    }
+  }
+  throw BadSchemaException("no attribute " + name);
+}
+
+std::uint16_t Schema::recordSize() const {
+  return alignUp(record_size_, alignment_);
+}
+
+void Schema::checkType(const FieldInfo& info, const Datatype type) {
+  if (info.type != type) {
+    throw BadSchemaException("attribute " + info.name + " is of another type");
+  }
+}
+
+}
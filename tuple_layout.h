@@ -0,0 +1,391 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "types.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Maps the C++ type of an attribute's values to its Datatype.
+ */
+template <typename T>
+struct DatatypeOf;
+
+template <>
+struct DatatypeOf<int> {
+  static const Datatype value = INTEGER;
+};
+
+template <>
+struct DatatypeOf<double> {
+  static const Datatype value = DOUBLE;
+};
+
+template <>
+struct DatatypeOf<std::string> {
+  static const Datatype value = STRING;
+};
+
+template <std::size_t N>
+struct DatatypeOf<char[N]> {
+  static const Datatype value = STRING;
+};
+
+/**
+ * @brief Reads an INTEGER or DOUBLE attribute at an offset fixed at run time.
+ *
+ * Values are copied out with memcpy, so records need not be aligned.  The
+ * caller checks once per record that it is long enough (see
+ * Schema::fits()); get() itself does not branch.
+ */
+template <typename T>
+class FieldAccessor {
+ public:
+  explicit FieldAccessor(const std::uint16_t offset) : offset_(offset) {}
+
+  /**
+   * Returns the attribute's value in <record>.
+   */
+  T get(const char* record) const {
+    T value;
+    memcpy(&value, record + offset_, sizeof(value));
+    return value;
+  }
+
+  /**
+   * Stores <value> as the attribute of <record>.
+   */
+  void set(char* record, const T& value) const {
+    memcpy(record + offset_, &value, sizeof(value));
+  }
+
+  /**
+   * Returns the byte offset of the attribute in records.
+   */
+  std::uint16_t offset() const { return offset_; }
+
+ private:
+  std::uint16_t offset_;
+};
+
+/**
+ * @brief Reads a fixed-width STRING attribute at an offset fixed at run time.
+ */
+template <>
+class FieldAccessor<std::string> {
+ public:
+  FieldAccessor(const std::uint16_t offset, const std::uint16_t width)
+      : offset_(offset), width_(width) {}
+
+  /**
+   * Returns a pointer to the attribute's width() bytes in <record>.
+   */
+  const char* data(const char* record) const { return record + offset_; }
+
+  /**
+   * Returns a copy of the attribute's bytes in <record>.
+   */
+  std::string get(const char* record) const {
+    return std::string(record + offset_, width_);
+  }
+
+  /**
+   * Stores <value> as the attribute of <record>, cut or padded with zeros
+   * to width().
+   */
+  void set(char* record, const std::string& value) const {
+    const std::size_t length = value.length() < width_ ? value.length() : width_;
+    memcpy(record + offset_, value.data(), length);
+    memset(record + offset_ + length, 0, width_ - length);
+  }
+
+  std::uint16_t offset() const { return offset_; }
+  std::uint16_t width() const { return width_; }
+
+ private:
+  std::uint16_t offset_;
+  std::uint16_t width_;
+};
+
+/**
+ * @brief Description of one attribute of a Schema.
+ */
+struct FieldInfo {
+  /**
+   * Name of the attribute.
+   */
+  std::string name;
+
+  /**
+   * Datatype of the attribute.
+   */
+  Datatype type;
+
+  /**
+   * Byte offset of the attribute in records.
+   */
+  std::uint16_t offset;
+
+  /**
+   * Width of the attribute in bytes.
+   */
+  std::uint16_t width;
+};
+
+/**
+ * @brief Layout of the records of a relation, described at run time.
+ *
+ * A schema lists the name, type, offset and width of every attribute, so
+ * consumers look attributes up by name once and then read them through
+ * typed accessors instead of casting record bytes themselves.  Fields added
+ * without an offset are placed like the members of a C struct, each aligned
+ * to its own size, so a schema built in member order matches the struct.
+ */
+class Schema {
+ public:
+  Schema() : record_size_(0), alignment_(1) {}
+
+  /**
+   * Appends an attribute after the last one, aligned to its size.
+   *
+   * @param name    Name of the attribute.
+   * @param type    Datatype of the attribute.
+   * @param width   Width of a STRING attribute in bytes; ignored otherwise.
+   * @return  This schema.
+   */
+  Schema& addField(const std::string& name, const Datatype type,
+                   const std::uint16_t width = 0);
+
+  /**
+   * Adds an attribute at a given offset, e.g. offsetof() a member.
+   *
+   * @param name    Name of the attribute.
+   * @param type    Datatype of the attribute.
+   * @param offset  Byte offset of the attribute in records.
+   * @param width   Width of a STRING attribute in bytes; ignored otherwise.
+   * @return  This schema.
+   */
+  Schema& addFieldAt(const std::string& name, const Datatype type,
+                     const std::uint16_t offset, const std::uint16_t width = 0);
+
+  /**
+   * Returns the number of attributes.
+   */
+  std::size_t numFields() const { return fields_.size(); }
+
+  /**
+   * Returns an attribute.
+   *
+   * @param field   Number of the attribute, in the order added.
+   */
+  const FieldInfo& field(const std::size_t field) const { return fields_[field]; }
+
+  /**
+   * Returns the attribute with the given name.
+   *
+   * @throws  BadSchemaException  If there is no such attribute.
+   */
+  const FieldInfo& field(const std::string& name) const;
+
+  /**
+   * Returns an accessor for the INTEGER or DOUBLE attribute with the given
+   * name.
+   *
+   * @throws  BadSchemaException  If there is no such attribute, or it is not
+   *                              of type T.
+   */
+  template <typename T>
+  FieldAccessor<T> accessor(const std::string& name) const {
+    checkType(field(name), DatatypeOf<T>::value);
+    return FieldAccessor<T>(field(name).offset);
+  }
+
+  /**
+   * Returns the size of a record holding all attributes, padded like a C
+   * struct.
+   */
+  std::uint16_t recordSize() const;
+
+  /**
+   * Returns true if <record> is long enough to hold every attribute.
+   */
+  bool fits(const RecordView& record) const {
+    return record.len >= record_size_;
+  }
+
+ private:
+  /**
+   * Throws if <info> is not of type <type>.
+   */
+  static void checkType(const FieldInfo& info, const Datatype type);
+
+  /**
+   * Attributes, in the order added.
+   */
+  std::vector<FieldInfo> fields_;
+
+  /**
+   * End of the attribute ending last.
+   */
+  std::uint16_t record_size_;
+
+  /**
+   * Largest alignment of any attribute.
+   */
+  std::uint16_t alignment_;
+};
+
+template <>
+inline FieldAccessor<std::string> Schema::accessor<std::string>(
+    const std::string& name) const {
+  const FieldInfo& info = field(name);
+  checkType(info, STRING);
+  return FieldAccessor<std::string>(info.offset, info.width);
+}
+
+/**
+ * @brief Attribute of type T at byte offset Offset of a layout known at
+ *        compile time.
+ *
+ * Offsets are usually taken with offsetof() from the struct records are
+ * built from, so the compiler turns get() into a single load.
+ */
+template <typename T, std::size_t Offset>
+struct StaticField {
+  typedef T value_type;
+  static const std::uint16_t offset = Offset;
+  static const std::uint16_t width = sizeof(T);
+  static const Datatype type = DatatypeOf<T>::value;
+
+  static T get(const char* record) {
+    T value;
+    memcpy(&value, record + Offset, sizeof(value));
+    return value;
+  }
+
+  static void set(char* record, const T& value) {
+    memcpy(record + Offset, &value, sizeof(value));
+  }
+};
+
+/**
+ * @brief Fixed-width STRING attribute of a layout known at compile time;
+ *        get() returns a pointer to its N bytes in the record.
+ */
+template <std::size_t N, std::size_t Offset>
+struct StaticField<char[N], Offset> {
+  typedef const char* value_type;
+  static const std::uint16_t offset = Offset;
+  static const std::uint16_t width = N;
+  static const Datatype type = STRING;
+
+  static const char* get(const char* record) { return record + Offset; }
+
+  static void set(char* record, const std::string& value) {
+    const std::size_t length = value.length() < N ? value.length() : N;
+    memcpy(record + Offset, value.data(), length);
+    memset(record + Offset + length, 0, N - length);
+  }
+};
+
+/**
+ * @brief End of the attribute ending last among Fields.
+ */
+template <typename... Fields>
+struct LayoutEnd;
+
+template <>
+struct LayoutEnd<> {
+  static const std::size_t value = 0;
+};
+
+template <typename Field, typename... Rest>
+struct LayoutEnd<Field, Rest...> {
+  static const std::size_t value =
+      Field::offset + Field::width > LayoutEnd<Rest...>::value ?
+      Field::offset + Field::width : LayoutEnd<Rest...>::value;
+};
+
+/**
+ * @brief Layout of records whose attributes are known at compile time.
+ *
+ * For instance, for records built from
+ *
+ *   struct Record { int i; double d; char s[64]; };
+ *
+ * the layout
+ *
+ *   typedef TupleLayout<StaticField<int, offsetof(Record, i)>,
+ *                       StaticField<double, offsetof(Record, d)>,
+ *                       StaticField<char[64], offsetof(Record, s)> > Layout;
+ *
+ * reads attribute 1 of a record with Layout::get<1>(record), inlined to a
+ * load at offset 8, and describes itself at run time with
+ * Layout::schema({"i", "d", "s"}).
+ */
+template <typename... Fields>
+class TupleLayout {
+ public:
+  /**
+   * Number of attributes.
+   */
+  static const std::size_t NUM_FIELDS = sizeof...(Fields);
+
+  /**
+   * Bytes a record needs to hold every attribute.
+   */
+  static const std::size_t MIN_RECORD_SIZE = LayoutEnd<Fields...>::value;
+
+  /**
+   * Type of attribute I.
+   */
+  template <std::size_t I>
+  struct field {
+    typedef typename std::tuple_element<I, std::tuple<Fields...> >::type type;
+  };
+
+  /**
+   * Returns the value of attribute I in <record>.
+   */
+  template <std::size_t I>
+  static typename field<I>::type::value_type get(const char* record) {
+    return field<I>::type::get(record);
+  }
+
+  /**
+   * Returns true if <record> is long enough to hold every attribute.
+   */
+  static bool fits(const RecordView& record) {
+    return record.len >= MIN_RECORD_SIZE;
+  }
+
+  /**
+   * Returns the run time description of this layout.
+   *
+   * @param names   Names of the attributes, in order.
+   */
+  static Schema schema(const std::vector<std::string>& names) {
+    Schema result;
+    const FieldInfo infos[] = {
+        {std::string(), Fields::type, Fields::offset, Fields::width}...};
+    for (std::size_t i = 0; i < NUM_FIELDS; ++i) {
+      result.addFieldAt(i < names.size() ? names[i] : std::string(),
+                        infos[i].type, infos[i].offset, infos[i].width);
+    }
+    return result;
+  }
+};
+
+}